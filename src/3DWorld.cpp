@@ -74,7 +74,7 @@ bool enable_model3d_custom_mipmaps(1), flatten_tt_mesh_under_models(0), show_map
 bool enable_dpart_shadows(0), enable_tt_model_reflect(1), enable_tt_model_indir(0), auto_calc_tt_model_zvals(0), use_model_lod_blocks(0), enable_translocator(0), enable_grass_fire(0);
 bool disable_model_textures(0), start_in_inf_terrain(0), allow_shader_invariants(1), config_unlimited_weapons(0), disable_tt_water_reflect(0), allow_model3d_quads(1);
 bool enable_timing_profiler(0), fast_transparent_spheres(0), force_ref_cmap_update(0), use_instanced_pine_trees(0), enable_postproc_recolor(0), draw_building_interiors(0);
-bool toggle_room_light(0), merge_model_objects(0), display_frame_time(0);
+bool toggle_room_light(0), merge_model_objects(0), display_frame_time(0), gen_model_lod_chains(0);
 int xoff(0), yoff(0), xoff2(0), yoff2(0), rand_gen_index(0), mesh_rgen_index(0), camera_change(1), camera_in_air(0), auto_time_adv(0);
 int animate(1), animate2(1), draw_model(0), init_x(STARTING_INIT_X), fire_key(0), do_run(0), init_num_balls(-1), change_wmode_frame(0);
 int game_mode(0), map_mode(0), load_hmv(0), load_coll_objs(1), read_landscape(0), screen_reset(0), mesh_seed(0), rgen_seed(1);
@@ -92,7 +92,9 @@ int enable_fsource(0), run_forward(0), advanced(0), dynamic_mesh_scroll(0);
 int read_snow_file(0), write_snow_file(0), mesh_detail_tex(NOISE_TEX);
 int read_light_files[NUM_LIGHTING_TYPES] = {0}, write_light_files[NUM_LIGHTING_TYPES] = {0};
 unsigned num_snowflakes(0), create_voxel_landscape(0), hmap_filter_width(0), num_dynam_parts(100), snow_coverage_resolution(2), num_birds_per_tile(2), num_fish_per_tile(15);
-unsigned erosion_iters(0), erosion_iters_tt(0), video_framerate(60), num_video_threads(0), skybox_tid(0);
+unsigned erosion_iters(0), erosion_iters_tt(0), video_framerate(60), num_video_threads(0), skybox_tid(0), tile_cache_max_mb(256), erosion_tile_size(0);
+unsigned erode_terrain_size[2] = {0}, erode_terrain_iters(0);
+int erode_terrain_start[2] = {0};
 float NEAR_CLIP(DEF_NEAR_CLIP), FAR_CLIP(DEF_FAR_CLIP), system_max_orbit(1.0), sky_occlude_scale(0.0), tree_slope_thresh(5.0), mouse_sensitivity(1.0), tt_grass_scale_factor(1.0);
 float water_plane_z(0.0), base_gravity(1.0), crater_depth(1.0), crater_radius(1.0), disabled_mesh_z(FAR_CLIP), vegetation(1.0), atmosphere(1.0), biome_x_offset(0.0);
 float mesh_file_scale(1.0), mesh_file_tz(0.0), speed_mult(1.0), mesh_z_cutoff(-FAR_CLIP), relh_adj_tex(0.0), dodgeball_metalness(1.0), ray_step_size_mult(1.0);
@@ -102,11 +104,11 @@ float CAMERA_RADIUS(DEF_CAMERA_RADIUS), C_STEP_HEIGHT(0.6), waypoint_sz_thresh(1
 float ocean_wave_height(DEF_OCEAN_WAVE_HEIGHT), tree_density_thresh(0.55), model_auto_tc_scale(0.0), model_triplanar_tc_scale(0.0), shadow_map_pcf_offset(0.0);
 float custom_glaciate_exp(0.0), tree_type_rand_zone(0.0), jump_height(1.0), force_czmin(0.0), force_czmax(0.0), smap_thresh_scale(1.0), dlight_intensity_scale(1.0);
 float model_mat_lod_thresh(5.0), clouds_per_tile(0.5), def_atmosphere(1.0), def_vegetation(1.0), ocean_depth_opacity_mult(1.0), erode_amount(1.0), ambient_scale(1.0);
-float model_hemi_lighting_scale(0.5);
+float model_hemi_lighting_scale(0.5), model_lod_pixel_error(1.0), tile_gen_time_budget(0.0);
 float light_int_scale[NUM_LIGHTING_TYPES] = {1.0, 1.0, 1.0, 1.0, 1.0}, first_ray_weight[NUM_LIGHTING_TYPES] = {1.0, 1.0, 1.0, 1.0, 1.0};
 double camera_zh(0.0);
 point mesh_origin(all_zeros), camera_pos(all_zeros), cube_map_center(all_zeros);
-string user_text, cobjs_out_fn, sphere_materials_fn, hmap_out_fn, skybox_cube_map_name, coll_damage_name;
+string user_text, cobjs_out_fn, sphere_materials_fn, hmap_out_fn, skybox_cube_map_name, coll_damage_name, texture_cache_dir, tile_cache_dir, gen_benchmark_fn, erode_terrain_fn;
 colorRGB ambient_lighting_scale(1,1,1), mesh_color_scale(1,1,1);
 colorRGBA bkg_color, flower_color(ALPHA0);
 set<unsigned char> keys, keyset;
@@ -1667,6 +1669,7 @@ int load_config(string const &config_file) {
 	kwmb.add("auto_calc_tt_model_zvals", auto_calc_tt_model_zvals);
 	kwmb.add("disable_tt_water_reflect", disable_tt_water_reflect);
 	kwmb.add("use_model_lod_blocks", use_model_lod_blocks);
+	kwmb.add("gen_model_lod_chains", gen_model_lod_chains);
 	kwmb.add("flatten_tt_mesh_under_models", flatten_tt_mesh_under_models);
 	kwmb.add("show_map_view_mandelbrot", show_map_view_mandelbrot);
 	kwmb.add("def_texture_compress", def_tex_compress);
@@ -1729,6 +1732,8 @@ int load_config(string const &config_file) {
 	kwmu.add("hmap_filter_width", hmap_filter_width);
 	kwmu.add("erosion_iters", erosion_iters);
 	kwmu.add("erosion_iters_tt", erosion_iters_tt);
+	kwmu.add("erosion_tile_size", erosion_tile_size);
+	kwmu.add("tile_cache_max_mb", tile_cache_max_mb);
 	kwmu.add("num_dynam_parts", num_dynam_parts);
 	kwmu.add("num_birds_per_tile", num_birds_per_tile);
 	kwmu.add("num_fish_per_tile", num_fish_per_tile);
@@ -1800,6 +1805,8 @@ int load_config(string const &config_file) {
 	kwmf.add("force_czmax", force_czmax);
 	kwmf.add("dlight_intensity_scale", dlight_intensity_scale);
 	kwmf.add("model_mat_lod_thresh", model_mat_lod_thresh);
+	kwmf.add("model_lod_pixel_error", model_lod_pixel_error);
+	kwmf.add("tile_gen_time_budget", tile_gen_time_budget);
 	kwmf.add("def_texture_aniso", def_tex_aniso);
 	kwmf.add("clouds_per_tile", clouds_per_tile);
 	kwmf.add("atmosphere", def_atmosphere);
@@ -1840,6 +1847,9 @@ int load_config(string const &config_file) {
 	kwms.add("sphere_materials_fn", sphere_materials_fn);
 	kwms.add("write_heightmap_png", hmap_out_fn);
 	kwms.add("skybox_cube_map", skybox_cube_map_name);
+	kwms.add("texture_cache_dir", texture_cache_dir);
+	kwms.add("tile_cache_dir", tile_cache_dir);
+	kwms.add("gen_benchmark_filename", gen_benchmark_fn);
 
 	while (read_str(fp, strc)) { // slow but should be OK: these ones require special handling
 		string const str(strc);
@@ -2015,6 +2025,11 @@ int load_config(string const &config_file) {
 			alloc_if_req(mh_filename, NULL);
 			if (fscanf(fp, "%255s%f%f%i", mh_filename, &mesh_file_scale, &mesh_file_tz, &invert_mh_image) < 1) cfg_err("mh_filename command", error);
 		}
+		else if (str == "erode_terrain_to_file") { // filename x0 y0 xsize ysize num_droplets, in mesh grid units
+			if (fscanf(fp, "%255s%i%i%u%u%u", strc, &erode_terrain_start[0], &erode_terrain_start[1], &erode_terrain_size[0], &erode_terrain_size[1], &erode_terrain_iters) != 6 ||
+				erode_terrain_size[0] == 0 || erode_terrain_size[1] == 0) {cfg_err("erode_terrain_to_file command", error);}
+			erode_terrain_fn = strc;
+		}
 		else if (str == "mh_filename_tiled_terrain") {
 			alloc_if_req(mh_filename_tt, NULL);
 			if (fscanf(fp, "%255s", mh_filename_tt) != 1) cfg_err("mh_filename_tiled_terrain command", error);
@@ -2194,6 +2209,7 @@ int main(int argc, char** argv) {
 	load_texture_names(); // needs to be before config file load
 	load_top_level_config(defaults_file);
 	gen_gauss_rand_arr(); // after reading seed from config file
+	if (!gen_benchmark_fn.empty()) {run_gen_benchmark_headless(gen_benchmark_fn);} // exits without creating a window or GL context
 	cout << "Loading."; cout.flush();
 	
  	// Initialize GLUT
@@ -2261,6 +2277,11 @@ int main(int argc, char** argv) {
 		}
 		get_landscape_texture_color(0, 0); // hack to force creation of the cached_ls_colors vector in the master thread (before build_lightmap())
 		build_lightmap(1);
+
+		if (!erode_terrain_fn.empty()) {
+			erode_terrain_to_file(erode_terrain_fn, erode_terrain_start[0], erode_terrain_start[1], erode_terrain_size[0], erode_terrain_size[1],
+				erode_terrain_iters, (erosion_tile_size ? erosion_tile_size : 1024)); // default to 1024x1024 tiles
+		}
 	}
 	check_gl_error(7777);
 	glutMainLoop(); // Switch to main loop
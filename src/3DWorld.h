@@ -1022,6 +1022,8 @@ public:
 	void load_tiff(int index, bool allow_diff_width_height, bool allow_two_byte_grayscale);
 	void load_dds(int index);
 	void load_ppm(int index, bool allow_diff_width_height);
+	bool read_from_cache(std::string const &cache_fn, std::string const &key);
+	bool write_to_cache (std::string const &cache_fn, std::string const &key) const;
 	void auto_insert_alpha_channel(int index);
 	void fill_transparent_with_avg_color();
 	void do_invert_y();
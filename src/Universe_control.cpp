@@ -63,8 +63,16 @@ void add_player_ship_engine_light();
 
 #ifdef _OPENMP
 int omp_get_thread_num_3dw() {return omp_get_thread_num();} // where does this belong?
+int omp_get_max_threads_3dw() {return omp_get_max_threads();}
+bool omp_in_parallel_3dw() {return (omp_in_parallel() != 0);}
+void omp_set_nested_3dw(bool nested) {omp_set_nested(nested);}
+void omp_set_num_threads_3dw(int num) {omp_set_num_threads(num);}
 #else
 int omp_get_thread_num_3dw() {return 0;}
+int omp_get_max_threads_3dw() {return 1;}
+bool omp_in_parallel_3dw() {return 0;}
+void omp_set_nested_3dw(bool nested) {}
+void omp_set_num_threads_3dw(int num) {}
 #endif
 
 void init_universe_display() {
@@ -803,7 +803,7 @@ void building_t::split_in_xy(cube_t const &seed_cube, rand_gen_t &rgen) {
 	// generate L, T, U, H, +, O shape
 	point const llc(seed_cube.get_llc()), sz(seed_cube.get_size());
 	bool const allow_courtyard(seed_cube.dx() < 1.6*seed_cube.dy() && seed_cube.dy() < 1.6*seed_cube.dx()); // AR < 1.6:1
-	int const shape(rand()%(allow_courtyard ? 10 : 9)); // 0-9
+	int const shape(rgen.rand()%(allow_courtyard ? 10 : 9)); // 0-9
 	has_courtyard = (shape == 9);
 	bool const is_hpo(shape >= 7);
 	bool const dim(rgen.rand_bool()); // {x,y}
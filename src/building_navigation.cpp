@@ -5,7 +5,7 @@
 #include "function_registry.h"
 #include "buildings.h"
 #include "city.h" // for pedestrian_t
-#include <queue>
+#include <cfloat>
 #pragma warning(disable : 26812) // prefer enum class over enum
 
 
@@ -41,10 +41,20 @@ class building_nav_graph_t {
 		float g_score, h_score, f_score;
 		a_star_node_state_t() : came_from_ix(-1), g_score(0), h_score(0), f_score(0) {}
 	};
+	struct stairs_tree_t { // shortest path tree from every room to one stairwell, using the stairs entrance for one direction (up or down)
+		vector<float> dist; // path cost to the stairs; FLT_MAX if unreachable
+		vector<int> parent; // next node toward the stairs; -1 for the stairs and unreachable nodes
+		vector<vector2d> conn_pt; // doorway/entrance point between each node and its parent
+	};
 
 	unsigned num_rooms, num_stairs;
 	float stairs_extend;
 	vector<node_t> nodes;
+	mutable vector<stairs_tree_t> stairs_trees; // {up, down} per stairwell, built on demand; rooms span all floors, so these are valid for every floor
+	// A* search state, reused across queries; Note: not thread safe
+	mutable vector<a_star_node_state_t> astar_state;
+	mutable vector<uint8_t> astar_open, astar_closed; // tentative/already evaluated nodes
+	mutable vector<pair<float, unsigned>> astar_queue; // max heap of {-f_score, node}
 	node_t       &get_node(unsigned room)       {assert(room < nodes.size()); return nodes[room];}
 	node_t const &get_node(unsigned room) const {assert(room < nodes.size()); return nodes[room];}
 
@@ -81,6 +91,13 @@ public:
 		get_node(room).add_conn_room(node_ix2, entry_u, entry_d);
 		n2.add_conn_room(room, entry_u, entry_d);
 	}
+	void push_queue(float score, unsigned node) const {astar_queue.emplace_back(-score, node); push_heap(astar_queue.begin(), astar_queue.end());}
+	unsigned pop_queue() const {
+		pop_heap(astar_queue.begin(), astar_queue.end());
+		unsigned const node(astar_queue.back().second);
+		astar_queue.pop_back();
+		return node;
+	}
 	void connect_rooms(unsigned room1, unsigned room2, cube_t const &conn_bcube) { // graph is bidirectional
 		assert(room1 < num_rooms && room2 < num_rooms);
 		get_node(room1).add_conn_room(room2, conn_bcube, conn_bcube);
@@ -337,23 +354,25 @@ public:
 		assert(room1 < nodes.size() && room2 < nodes.size());
 		assert(room1 != room2); // or just return an empty path?
 		path.clear();
-		vector<a_star_node_state_t> state(nodes.size());
-		vector<uint8_t> open(nodes.size(), 0), closed(nodes.size(), 0); // tentative/already evaluated nodes
-		std::priority_queue<pair<float, unsigned> > open_queue;
+		vector<a_star_node_state_t> &state(astar_state);
+		vector<uint8_t> &open(astar_open), &closed(astar_closed);
+		state.assign(nodes.size(), a_star_node_state_t());
+		open  .assign(nodes.size(), 0);
+		closed.assign(nodes.size(), 0);
+		astar_queue.clear();
 		point const dest_pos(get_node(room2).get_center(cur_pt.z)); // Note: approximate, actual dest may be different
 		a_star_node_state_t &start(state[room1]);
 		start.g_score = 0.0;
 		start.h_score = start.f_score = p2p_dist_xy(get_node(room1).get_center(cur_pt.z), dest_pos); // estimated total cost from start to goal through current
 		open[room1]   = 1;
-		open_queue.push(make_pair(-start.f_score, room1));
+		push_queue(start.f_score, room1);
 
-		while (!open_queue.empty()) {
-			unsigned const cur(open_queue.top().second);
-			open_queue.pop();
-			assert(!closed[cur]);
+		while (!astar_queue.empty()) {
+			unsigned const cur(pop_queue());
+			if (closed[cur]) continue; // duplicate entry from a node whose score was improved
 			node_t const &cur_node(get_node(cur));
 			point const center(cur_node.get_center(cur_pt.z));
-			assert(!closed[cur]);
+			float const cur_g_score(state[cur].g_score);
 			closed[cur] = 1;
 			open[cur]   = 0;
 
@@ -365,7 +384,7 @@ public:
 				point const conn_center(conn_node.get_center(cur_pt.z));
 				a_star_node_state_t &sn(state[i->ix]);
 				vector2d const &pt(i->pt[up_or_down]);
-				float const new_g_score(sn.g_score + p2p_dist_xy(center, pt) + p2p_dist_xy(pt, conn_center));
+				float const new_g_score(cur_g_score + p2p_dist_xy(center, pt) + p2p_dist_xy(pt, conn_center));
 				if (!open[i->ix]) {open[i->ix] = 1;}
 				else if (new_g_score >= sn.g_score) continue; // not better
 				sn.came_from_ix = cur;
@@ -374,11 +393,94 @@ public:
 				sn.g_score = new_g_score;
 				sn.h_score = p2p_dist_xy(conn_center, dest_pos);
 				sn.f_score = sn.g_score + sn.h_score;
-				open_queue.push(make_pair(-sn.f_score, i->ix));
+				push_queue(sn.f_score, i->ix);
 			} // for i
 		} // end while()
 		return 0; // failed - no path from room1 to room2
 	}
+
+	// Dijkstra's algorithm from the stairs outward; edge costs are symmetric, so this gives the shortest path from each room to the stairs
+	stairs_tree_t const &get_stairs_tree(unsigned stairs, bool up_or_down) const {
+		assert(stairs < num_stairs);
+		if (stairs_trees.empty()) {stairs_trees.resize(2*num_stairs);}
+		stairs_tree_t &tree(stairs_trees[2*stairs + up_or_down]);
+		if (!tree.dist.empty()) return tree; // already built
+		unsigned const root(num_rooms + stairs);
+		tree.dist.resize(nodes.size(), FLT_MAX);
+		tree.parent.resize(nodes.size(), -1);
+		tree.conn_pt.resize(nodes.size());
+		astar_closed.assign(nodes.size(), 0);
+		astar_queue.clear();
+		tree.dist[root] = 0.0;
+		push_queue(0.0, root);
+
+		while (!astar_queue.empty()) {
+			unsigned const cur(pop_queue());
+			if (astar_closed[cur]) continue; // duplicate entry
+			astar_closed[cur] = 1;
+			node_t const &cur_node(get_node(cur));
+			if (cur != root && cur_node.is_stairs) continue; // can't walk through other stairs; same as use_stairs=0 in find_path_points()
+			point const center(cur_node.get_center(0.0));
+
+			for (auto i = cur_node.conn_rooms.begin(); i != cur_node.conn_rooms.end(); ++i) {
+				assert(i->ix < nodes.size());
+				if (astar_closed[i->ix]) continue;
+				vector2d const &pt(i->pt[up_or_down]);
+				float const dist(tree.dist[cur] + p2p_dist_xy(center, pt) + p2p_dist_xy(pt, get_node(i->ix).get_center(0.0)));
+				if (dist >= tree.dist[i->ix]) continue; // not better
+				tree.dist   [i->ix] = dist;
+				tree.parent [i->ix] = cur;
+				tree.conn_pt[i->ix] = pt;
+				push_queue(dist, i->ix);
+			} // for i
+		} // end while()
+		return tree;
+	}
+	// sorts candidate stairs by the total room graph path cost of {room1 => stairs => room2}, and removes stairs that can't be reached from either room
+	void sort_stairs_by_path_cost(unsigned room1, unsigned room2, bool up_or_down, vector<unsigned> &stairs) const {
+		vector<pair<float, unsigned>> sorted;
+
+		for (auto s = stairs.begin(); s != stairs.end(); ++s) {
+			float const dist1(get_stairs_tree(*s, up_or_down).dist[room1]), dist2(get_stairs_tree(*s, !up_or_down).dist[room2]);
+			if (dist1 < FLT_MAX && dist2 < FLT_MAX) {sorted.emplace_back((dist1 + dist2), *s);}
+		}
+		sort(sorted.begin(), sorted.end()); // sort by path cost, min first
+		stairs.clear();
+		for (auto s = sorted.begin(); s != sorted.end(); ++s) {stairs.push_back(s->second);}
+	}
+	// same as find_path_points() between room and stairs, in the direction given by to_stairs, but uses the cached stairs tree rather than running A*
+	bool find_stairs_path_points(unsigned stairs, unsigned room, bool to_stairs, float radius, float height,
+		bool is_first_path, bool up_or_down, vect_cube_t const &avoid, point const &cur_pt, vector<point> &path) const
+	{
+		assert(room < num_rooms);
+		path.clear();
+		stairs_tree_t const &tree(get_stairs_tree(stairs, up_or_down));
+		if (tree.dist[room] == FLT_MAX) return 0; // no path
+		unsigned const root(num_rooms + stairs);
+		vector<a_star_node_state_t> &state(astar_state);
+		state.resize(nodes.size()); // only nodes along the path are used, so there's no need to reset the others
+
+		if (to_stairs) { // room => stairs: reverse the tree's parent links so that came_from points back toward room
+			state[room].came_from_ix = -1;
+
+			for (unsigned n = room; n != root; n = tree.parent[n]) {
+				assert(tree.parent[n] >= 0);
+				a_star_node_state_t &sn(state[tree.parent[n]]);
+				sn.came_from_ix = n;
+				sn.path_pt.assign(tree.conn_pt[n].x, tree.conn_pt[n].y, cur_pt.z);
+			}
+			return reconstruct_path(state, avoid, cur_pt, radius, height, root, room, is_first_path, up_or_down, path);
+		}
+		// stairs => room: the tree's parent links already point back toward the stairs
+		state[root].came_from_ix = -1;
+
+		for (unsigned n = room; n != root; n = tree.parent[n]) {
+			assert(tree.parent[n] >= 0);
+			state[n].came_from_ix = tree.parent[n];
+			state[n].path_pt.assign(tree.conn_pt[n].x, tree.conn_pt[n].y, cur_pt.z);
+		}
+		return reconstruct_path(state, avoid, cur_pt, radius, height, room, root, is_first_path, up_or_down, path);
+	}
 }; // end building_nav_graph_t
 
 cube_t building_t::get_walkable_room_bounds(room_t const &room) const {
@@ -564,18 +666,21 @@ bool building_t::find_route_to_point(point const &from, point const &to, float r
 		vector<unsigned> nearest_stairs;
 		find_nearest_stairs(from, to, nearest_stairs, 1); // straight_only=1; pass in loc1.part_ix if both loc part_ix values are equal?
 		bool const up_or_down(loc1.floor > loc2.floor); // 0=up, 1=down
+		// reorder by actual path cost using the cached per-stairs shortest path trees, and drop stairs that can't be reached so that we don't try them
+		interior->nav_graph->sort_stairs_by_path_cost(loc1.room_ix, loc2.room_ix, up_or_down, nearest_stairs);
 
-		for (auto s = nearest_stairs.begin(); s != nearest_stairs.end(); ++s) { // try using stairs, closest to furthest
+		for (auto s = nearest_stairs.begin(); s != nearest_stairs.end(); ++s) { // try using stairs, lowest cost to highest
 			assert(*s < interior->stairwells.size());
 			stairwell_t const &stairs(interior->stairwells[*s]);
 			unsigned const stairs_room_ix(*s + interior->rooms.size()); // map to graph space
 			path.clear();
 			vector<point> from_path;
-			// Note: passing use_stairs=0 here because it's unclear if we want to go through stairs nodes in our A* algorithm
-			if (!interior->nav_graph->find_path_points(loc1.room_ix, stairs_room_ix, radius, height, 0, is_first_path, up_or_down, avoid, from, from_path)) continue; // from => stairs
+			if (s != nearest_stairs.begin()) {interior->get_avoid_cubes(avoid, (from.z - radius), (from.z + z2_add));} // restore avoid cubes for the starting floor
+			// Note: stairs nodes other than the target stairs are not used here because it's unclear if we want to go through them
+			if (!interior->nav_graph->find_stairs_path_points(*s, loc1.room_ix, 1, radius, height, is_first_path, up_or_down, avoid, from, from_path)) continue; // from => stairs
 			point const seg2_start(interior->nav_graph->get_stairs_entrance_pt(to.z, stairs_room_ix, !up_or_down)); // other end
 			interior->get_avoid_cubes(avoid, (seg2_start.z - radius), (seg2_start.z + z2_add)); // new floor, new zval, new avoid cubes
-			if (!interior->nav_graph->find_path_points(stairs_room_ix, loc2.room_ix, radius, height, 0, is_first_path, !up_or_down, avoid, seg2_start, path)) continue; // stairs => to
+			if (!interior->nav_graph->find_stairs_path_points(*s, loc2.room_ix, 0, radius, height, is_first_path, !up_or_down, avoid, seg2_start, path)) continue; // stairs => to
 			assert(!path.empty() && !from_path.empty());
 			path.push_back(seg2_start); // other end of the stairs
 			// add two more points to straighten the entrance and exit paths; this segment doesn't check for intersection with stairs
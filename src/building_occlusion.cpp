@@ -0,0 +1,137 @@
+// 3D World - Building Occlusion Culling using a Low Resolution CPU Depth Buffer
+// by Frank Gennari
+// 10/18/26
+
+#include "3DWorld.h"
+#include "function_registry.h"
+#include "buildings.h"
+#include <cfloat>
+
+unsigned const OCC_ZBUF_XSIZE = 256;
+unsigned const OCC_ZBUF_YSIZE = 128;
+unsigned const OCC_ZBUF_TILE  = 8; // in pixels; must evenly divide both xsize and ysize
+
+
+void occlusion_zbuffer_t::init(pos_dir_up const &pdu_) {
+	bool const same_fov(!view_tx.empty() && pdu_.A == pdu.A && pdu_.tterm == pdu.tterm);
+	bool const same_rot(same_fov && pdu_.dir == pdu.dir && pdu_.upv_ == pdu.upv_ && pdu_.cp == pdu.cp);
+	pdu   = pdu_;
+	xsize = OCC_ZBUF_XSIZE;
+	ysize = OCC_ZBUF_YSIZE;
+	num_occluders = 0;
+	depth.assign(xsize*ysize, FLT_MAX);
+	if (same_rot) return; // camera has only moved, so the rays through the pixel corners are unchanged
+	unsigned const ncx(xsize+1), ncy(ysize+1);
+
+	if (!same_fov) { // the view space rays through the pixel corners only depend on FOV and aspect ratio
+		xscale = pdu.A*pdu.tterm;
+		yscale = pdu.tterm;
+		view_tx.resize(ncx);
+		view_ty.resize(ncy);
+		for (unsigned x = 0; x < ncx; ++x) {view_tx[x] = xscale*(2.0f*x/xsize - 1.0f);}
+		for (unsigned y = 0; y < ncy; ++y) {view_ty[y] = yscale*(2.0f*y/ysize - 1.0f);}
+		for (unsigned d = 0; d < 3; ++d) {rinv[d].resize(ncx*ncy);}
+	}
+	for (unsigned y = 0; y < ncy; ++y) { // rotate the rays into world space, scaled so that the ray t value is the view space depth, and invert them
+		vector3d const row_dir(pdu.dir + view_ty[y]*pdu.upv_);
+
+		for (unsigned d = 0; d < 3; ++d) {
+			float *const ri(rinv[d].data() + y*ncx);
+			float const rd(row_dir[d]), cpd(pdu.cp[d]);
+
+			for (unsigned x = 0; x < ncx; ++x) {
+				float const v(rd + view_tx[x]*cpd);
+				ri[x] = 1.0f/((fabs(v) < 1.0E-6f) ? ((v < 0.0f) ? -1.0E-6f : 1.0E-6f) : v); // avoid inf*0=NaN in the slab test
+			}
+		}
+	} // for y
+}
+
+bool occlusion_zbuffer_t::project(point const &p, float &x, float &y, float &z) const { // returns false if behind the near plane
+	vector3d const v(p - pdu.pos);
+	z = dot_product(v, pdu.dir);
+	if (z < max(pdu.near_, 1.0E-6f)) return 0;
+	x = xsize*(0.5f*dot_product(v, pdu.cp  )/(z*xscale) + 0.5f);
+	y = ysize*(0.5f*dot_product(v, pdu.upv_)/(z*yscale) + 0.5f);
+	return 1;
+}
+
+// Note: c is in camera space; only pixels entirely covered by the cube are written, with the max depth of the cube's front faces over that pixel,
+// so the result is conservative; the front depth of a convex shape is maximized at one of the pixel corners, so only corners need to be evaluated
+void occlusion_zbuffer_t::add_occluder(cube_t const &c) {
+	if (depth.empty() || c.contains_pt(pdu.pos)) return; // not initialized, or camera inside this cube
+	float x1(FLT_MAX), y1(FLT_MAX), x2(-FLT_MAX), y2(-FLT_MAX), px, py, pz;
+	point const pts[2] = {c.get_llc(), c.get_urc()};
+
+	for (unsigned i = 0; i < 8; ++i) {
+		if (!project(point(pts[i&1].x, pts[(i>>1)&1].y, pts[i>>2].z), px, py, pz)) return; // crosses the near plane, skip
+		x1 = min(x1, px); x2 = max(x2, px); y1 = min(y1, py); y2 = max(y2, py);
+	}
+	int const cx1(max(0, (int)ceil(x1))), cx2(min((int)xsize, (int)floor(x2))), cy1(max(0, (int)ceil(y1))), cy2(min((int)ysize, (int)floor(y2)));
+	if (cx1 >= cx2 || cy1 >= cy2) return; // doesn't fully cover any pixels
+	unsigned const nx(cx2 - cx1 + 1), ncx(xsize+1);
+	vector3d const lo(pts[0] - pdu.pos), hi(pts[1] - pdu.pos);
+	for (unsigned n = 0; n < 2; ++n) {row_depth[n].resize(nx);}
+
+	for (int y = cy1; y <= cy2; ++y) {
+		float *const cur(row_depth[y&1].data()), *const prev(row_depth[(y+1)&1].data());
+		unsigned const off(y*ncx + cx1);
+		float const *const rx(rinv[0].data() + off), *const ry(rinv[1].data() + off), *const rz(rinv[2].data() + off);
+
+		for (unsigned x = 0; x < nx; ++x) { // ray-cube slab test; branch free so that the compiler can vectorize it
+			float const tx1(lo.x*rx[x]), tx2(hi.x*rx[x]), ty1(lo.y*ry[x]), ty2(hi.y*ry[x]), tz1(lo.z*rz[x]), tz2(hi.z*rz[x]);
+			float const tmin(max(max(min(tx1, tx2), min(ty1, ty2)), min(tz1, tz2))), tmax(min(min(max(tx1, tx2), max(ty1, ty2)), max(tz1, tz2)));
+			cur[x] = ((tmin <= tmax) ? tmin : FLT_MAX); // FLT_MAX if the corner is outside the cube
+		}
+		if (y == cy1) continue; // need two rows of corners
+		float *const zrow(depth.data() + (y-1)*xsize + cx1);
+
+		for (unsigned x = 0; x+1 < nx; ++x) {
+			zrow[x] = min(zrow[x], max(max(prev[x], prev[x+1]), max(cur[x], cur[x+1])));
+		}
+	} // for y
+	++num_occluders;
+}
+
+void occlusion_zbuffer_t::finalize() { // build the per-tile max depth used to quickly accept or reject queries
+	if (empty()) return;
+	unsigned const tx(xsize/OCC_ZBUF_TILE), ty(ysize/OCC_ZBUF_TILE);
+	tile_max.assign(tx*ty, 0.0);
+
+	for (unsigned y = 0; y < ysize; ++y) {
+		float *const trow(tile_max.data() + (y/OCC_ZBUF_TILE)*tx);
+		float const *const zrow(depth.data() + y*xsize);
+		for (unsigned x = 0; x < xsize; ++x) {trow[x/OCC_ZBUF_TILE] = max(trow[x/OCC_ZBUF_TILE], zrow[x]);}
+	}
+}
+
+// returns true if the screen space bounds of pts are entirely covered by occluders that are closer than the closest point;
+// points that are off the screen are assumed to be handled by view frustum culling
+bool occlusion_zbuffer_t::pts_occluded(point const *const pts, unsigned npts) const {
+	if (empty() || npts == 0) return 0;
+	float x1(FLT_MAX), y1(FLT_MAX), x2(-FLT_MAX), y2(-FLT_MAX), zmin(FLT_MAX), px, py, pz;
+
+	for (unsigned i = 0; i < npts; ++i) {
+		if (!project(pts[i], px, py, pz)) return 0; // behind the near plane, assume visible
+		x1 = min(x1, px); x2 = max(x2, px); y1 = min(y1, py); y2 = max(y2, py); zmin = min(zmin, pz);
+	}
+	if (x2 < 0.0 || y2 < 0.0 || x1 >= xsize || y1 >= ysize) return 0; // off screen
+	int const px1(max(0, (int)floor(x1))), px2(min((int)xsize-1, (int)floor(x2))), py1(max(0, (int)floor(y1))), py2(min((int)ysize-1, (int)floor(y2)));
+	int const tsz(OCC_ZBUF_TILE), num_tx(xsize/OCC_ZBUF_TILE);
+
+	for (int ty = py1/tsz; ty <= py2/tsz; ++ty) {
+		for (int tx = px1/tsz; tx <= px2/tsz; ++tx) {
+			if (tile_max[ty*num_tx + tx] < zmin) continue; // entire tile is in front
+			// check individual pixels in the overlap of the tile and the query rect
+			int const xa(max(px1, tx*tsz)), xb(min(px2, (tx+1)*tsz-1)), ya(max(py1, ty*tsz)), yb(min(py2, (ty+1)*tsz-1));
+
+			for (int y = ya; y <= yb; ++y) {
+				for (int x = xa; x <= xb; ++x) {
+					if (depth[y*xsize + x] >= zmin) return 0; // visible through this pixel
+				}
+			}
+		} // for tx
+	} // for ty
+	return 1;
+}
+
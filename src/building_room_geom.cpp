@@ -27,6 +27,9 @@ void gen_text_verts(vector<vert_tc_t> &verts, point const &pos, string const &te
 string const &gen_book_title(unsigned rand_id, string *author, unsigned split_len);
 
 
+// model loading isn't thread safe, so this must be called before generating room geom in parallel
+void ensure_building_obj_models_loaded() {building_obj_model_loader.ensure_models_loaded();}
+
 unsigned get_face_mask(unsigned dim, bool dir) {return ~(1 << (2*(2-dim) + dir));} // skip_faces: 1=Z1, 2=Z2, 4=Y1, 8=Y2, 16=X1, 32=X2
 unsigned get_skip_mask_for_xy(bool dim) {return (dim ? EF_Y12 : EF_X12);}
 tid_nm_pair_t get_tex_auto_nm(int tid, float tscale) {return tid_nm_pair_t(tid, get_normal_map_for_bldg_tid(tid), tscale, tscale);}
@@ -271,6 +274,11 @@ unsigned building_materials_t::count_all_verts() const {
 	for (const_iterator m = begin(); m != end(); ++m) {num_verts += m->get_tot_vert_count();}
 	return num_verts;
 }
+size_t building_materials_t::get_gpu_mem() const {
+	size_t mem(0);
+	for (const_iterator m = begin(); m != end(); ++m) {mem += m->get_tot_vert_count()*sizeof(rgeom_mat_t::vertex_t) + m->num_ixs*sizeof(unsigned);}
+	return mem;
+}
 rgeom_mat_t &building_materials_t::get_material(tid_nm_pair_t const &tex, bool inc_shadows) {
 	// for now we do a simple linear search because there shouldn't be too many unique materials
 	for (iterator m = begin(); m != end(); ++m) {
@@ -1256,6 +1264,13 @@ void building_room_geom_t::clear_static_vbos() { // used to clear pictures
 	mats_static.clear();
 	obj_model_insts.clear(); // these are associated with static VBOs
 }
+size_t building_room_geom_t::get_vert_mem_usage() const { // approximate; vertex data is freed on the CPU side once the VBOs are created
+	return (mats_static.get_gpu_mem() + mats_small.get_gpu_mem() + mats_dynamic.get_gpu_mem() + mats_lights.get_gpu_mem());
+}
+size_t building_room_geom_t::get_mem_usage() const {
+	size_t mem(objs.capacity()*sizeof(room_object_t) + obj_model_insts.capacity()*sizeof(obj_model_inst_t) + light_bcubes.capacity()*sizeof(cube_t));
+	return (mem + get_vert_mem_usage());
+}
 
 rgeom_mat_t &building_room_geom_t::get_material(tid_nm_pair_t const &tex, bool inc_shadows, bool dynamic, bool small) {
 	return (dynamic ? mats_dynamic : (small ? mats_small : mats_static)).get_material(tex, inc_shadows);
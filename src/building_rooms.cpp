@@ -739,7 +739,7 @@ bool building_t::add_kitchen_objs(rand_gen_t &rgen, room_t const &room, float zv
 		c.z2() = zval + height;
 		cabinet_area.z1() = zval;
 		cabinet_area.z2() = zval + vspace - get_floor_thickness();
-		static vect_cube_t blockers;
+		vect_cube_t blockers; // not static so that room geom can be generated in parallel
 		gather_room_placement_blockers(cabinet_area, objs_start, blockers, 1, 1); // inc_open_doors=1, ignore_chairs=1
 		bool is_sink(1);
 
@@ -1482,8 +1482,7 @@ void building_t::add_wall_and_door_trim() {
 	// Note: depth must be small to avoid object intersections; this applies to the windowsill as well
 	float const window_trim_width(0.75*wall_thickness), window_trim_depth(0.1*wall_thickness), windowsill_depth(0.1*wall_thickness);
 	float const window_offset(0.01*window_vspacing); // must match building_draw_t::add_section()
-	static vect_vnctcc_t wall_quad_verts;
-	wall_quad_verts.clear();
+	vect_vnctcc_t wall_quad_verts; // not static so that room geom can be generated in parallel
 	get_all_drawn_window_verts_as_quads(wall_quad_verts);
 	assert((wall_quad_verts.size() & 3) == 0); // must be a multiple of 4
 
@@ -1678,18 +1677,21 @@ void building_t::gen_and_draw_room_geom(shader_t &s, vector3d const &xlate, vect
 {
 	if (!interior) return;
 	if (is_rotated()) return; // no room geom for rotated buildings
-
-	if (!has_room_geom()) {
-		rand_gen_t rgen;
-		rgen.set_state(building_ix, parts.size()); // set to something canonical per building
-		ped_bcubes.clear();
-		if (ped_ix >= 0) {get_ped_bcubes_for_building(ped_ix, building_ix, ped_bcubes);}
-		gen_room_details(rgen, ped_bcubes); // generate so that we can draw it
-		assert(has_room_geom());
-	}
+	gen_room_geom_if_needed(ped_bcubes, building_ix, ped_ix); // generate so that we can draw it
 	draw_room_geom(s, xlate, shadow_only, inc_small, player_in_building);
 }
 
+// Note: thread safe for different buildings, and deterministic since the rand seed only depends on the building
+void building_t::gen_room_geom_if_needed(vect_cube_t &ped_bcubes, unsigned building_ix, int ped_ix) {
+	if (!interior || is_rotated() || has_room_geom()) return;
+	rand_gen_t rgen;
+	rgen.set_state(building_ix, parts.size()); // set to something canonical per building
+	ped_bcubes.clear();
+	if (ped_ix >= 0) {get_ped_bcubes_for_building(ped_ix, building_ix, ped_bcubes);}
+	gen_room_details(rgen, ped_bcubes);
+	assert(has_room_geom());
+}
+
 void building_t::clear_room_geom() {
 	if (!has_room_geom()) return;
 	interior->room_geom->clear(); // free VBO data before deleting the room_geom object
@@ -22,17 +22,41 @@ class building_nav_graph_t;
 struct pedestrian_t;
 typedef vector<vert_norm_comp_tc_color> vect_vnctcc_t;
 
+class occlusion_zbuffer_t { // low resolution conservative CPU depth buffer of building exteriors, for occlusion culling
+	pos_dir_up pdu;
+	unsigned xsize, ysize, num_occluders;
+	float xscale, yscale; // view space tangents at the screen edges
+	vector<float> depth, tile_max; // per-pixel and per-tile max depth (two level hierarchical Z)
+	vector<float> view_tx, view_ty; // view space ray offsets through the pixel corner columns and rows; cached until the FOV or aspect ratio changes
+	vector<float> rinv[3]; // inverse world space ray dirs through each pixel corner, per dim; recomputed only when the camera rotates
+	vector<float> row_depth[2]; // temporary
+	bool project(point const &p, float &x, float &y, float &z) const;
+public:
+	occlusion_zbuffer_t() : xsize(0), ysize(0), num_occluders(0), xscale(1.0), yscale(1.0) {}
+	void init(pos_dir_up const &pdu_);
+	void clear() {num_occluders = 0;}
+	bool empty() const {return (num_occluders == 0);}
+	void add_occluder(cube_t const &c);
+	void finalize();
+	bool pts_occluded(point const *const pts, unsigned npts) const;
+	bool cube_occluded(cube_t const &c) const {point pts[8]; c.get_points(pts); return pts_occluded(pts, 8);}
+};
+
 struct building_occlusion_state_t {
 	point pos;
 	vector3d xlate;
-	vector<unsigned> building_ids;
+	vector<unsigned> building_ids; // buildings that can't be drawn into zbuf and are tested with lines instead
 	vector<point> temp_points;
+	occlusion_zbuffer_t zbuf;
 
-	void init(point const &pos_, vector3d const &xlate_) {
-		pos   = pos_;
+	void init(pos_dir_up const &pdu, vector3d const &xlate_) {
+		pos   = pdu.pos;
 		xlate = xlate_;
 		building_ids.clear();
+		zbuf.init(pdu);
 	}
+	void clear() {building_ids.clear(); zbuf.clear();}
+	bool empty() const {return (building_ids.empty() && zbuf.empty());}
 };
 
 struct cube_with_zval_t : public cube_t {
@@ -120,7 +144,7 @@ struct building_mat_t : public building_tex_params_t {
 struct building_params_t {
 
 	bool flatten_mesh, has_normal_map, tex_mirror, tex_inv_y, tt_only, infinite_buildings, dome_roof, onion_roof, enable_people_ai, add_city_interiors;
-	unsigned num_place, num_tries, cur_prob, max_shadow_maps;
+	unsigned num_place, num_tries, cur_prob, max_shadow_maps, max_room_geom_mem_mb;
 	float ao_factor, sec_extra_spacing, player_coll_radius_scale;
 	float window_width, window_height, window_xspace, window_yspace; // windows
 	float wall_split_thresh, max_fp_wind_xscale, max_fp_wind_yscale; // interiors
@@ -131,7 +155,7 @@ struct building_params_t {
 	vector<unsigned> rug_tids, picture_tids, sheet_tids;
 
 	building_params_t(unsigned num=0) : flatten_mesh(0), has_normal_map(0), tex_mirror(0), tex_inv_y(0), tt_only(0), infinite_buildings(0), dome_roof(0),
-		onion_roof(0), enable_people_ai(0), add_city_interiors(0), num_place(num), num_tries(10), cur_prob(1), max_shadow_maps(32), ao_factor(0.0),
+		onion_roof(0), enable_people_ai(0), add_city_interiors(0), num_place(num), num_tries(10), cur_prob(1), max_shadow_maps(32), max_room_geom_mem_mb(1024), ao_factor(0.0),
 		sec_extra_spacing(0.0), player_coll_radius_scale(1.0), window_width(0.0), window_height(0.0), window_xspace(0.0), window_yspace(0.0),
 		wall_split_thresh(4.0), max_fp_wind_xscale(0.0), max_fp_wind_yscale(0.0), range_translate(zero_vector) {}
 	int get_wrap_mir() const {return (tex_mirror ? 2 : 1);}
@@ -300,6 +324,7 @@ public:
 struct building_materials_t : public vector<rgeom_mat_t> {
 	void clear();
 	unsigned count_all_verts() const;
+	size_t get_gpu_mem() const;
 	rgeom_mat_t &get_material(tid_nm_pair_t const &tex, bool inc_shadows);
 	void create_vbos();
 	void draw(shader_t &s, bool shadow_only);
@@ -318,19 +343,22 @@ struct building_room_geom_t {
 	unsigned char num_pic_tids;
 	float obj_scale;
 	unsigned stairs_start; // index of first object of TYPE_STAIR
+	unsigned last_near_frame; // last frame the camera was within room geom draw distance; used to evict the least recently visited vertex data
 	vector3d tex_origin;
 	vector<room_object_t> objs; // for drawing and collision detection
 	vector<obj_model_inst_t> obj_model_insts;
 	building_materials_t mats_static, mats_small, mats_dynamic, mats_lights; // {large static, small static, dynamic, lights} materials
 	vect_cube_t light_bcubes;
 
-	building_room_geom_t(vector3d const &tex_origin_) : has_elevators(0), has_pictures(0), lights_changed(0), num_pic_tids(0), obj_scale(1.0), stairs_start(0), tex_origin(tex_origin_) {}
+	building_room_geom_t(vector3d const &tex_origin_) : has_elevators(0), has_pictures(0), lights_changed(0), num_pic_tids(0), obj_scale(1.0), stairs_start(0), last_near_frame(0), tex_origin(tex_origin_) {}
 	bool empty() const {return objs.empty();}
 	void clear();
 	void clear_materials();
 	void clear_static_vbos();
 	void clear_and_recreate_lights() {lights_changed = 1;} // cache the state and apply the change later in case this is called from a different thread
 	unsigned get_num_verts() const {return (mats_static.count_all_verts() + mats_small.count_all_verts() + mats_dynamic.count_all_verts() + mats_lights.count_all_verts());}
+	size_t get_vert_mem_usage() const;
+	size_t get_mem_usage() const;
 	rgeom_mat_t &get_material(tid_nm_pair_t const &tex, bool inc_shadows=0, bool dynamic=0, bool small=0);
 	rgeom_mat_t &get_wood_material(float tscale);
 	// Note: these functions are all for drawing objects / adding them to the vertex list
@@ -579,6 +607,7 @@ struct building_t : public building_geom_t {
 	bool toggle_room_light(point const &closest_to);
 	bool set_room_light_state_to(room_t const &room, float zval, bool make_on);
 	void draw_room_geom(shader_t &s, vector3d const &xlate, bool shadow_only, bool inc_small, bool player_in_building);
+	void gen_room_geom_if_needed(vect_cube_t &ped_bcubes, unsigned building_ix, int ped_ix);
 	void gen_and_draw_room_geom(shader_t &s, vector3d const &xlate, vect_cube_t &ped_bcubes, unsigned building_ix, int ped_ix, bool shadow_only, bool inc_small, bool player_in_building);
 	void add_split_roof_shadow_quads(building_draw_t &bdraw) const;
 	void clear_room_geom();
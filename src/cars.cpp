@@ -9,6 +9,7 @@
 #include <cfloat> // for FLT_MAX
 
 float const MIN_CAR_STOP_SEP = 0.25; // in units of car lengths
+unsigned const MIN_CARS_FOR_THREADS = 1024; // fewer cars are updated serially
 
 extern bool tt_fire_button_down;
 extern int display_mode, game_mode, map_mode, animate2;
@@ -113,7 +114,9 @@ bool car_t::front_intersects_car(car_t const &c) const {
 
 void car_t::honk_horn_if_close() const {
 	point const pos(get_center());
-	if (dist_less_than((pos + get_tiled_terrain_model_xlate()), get_camera_pos(), 1.0)) {gen_sound(SOUND_HORN, pos);}
+	if (!dist_less_than((pos + get_tiled_terrain_model_xlate()), get_camera_pos(), 1.0)) return;
+#pragma omp critical(car_horn_sound) // may be called from the parallel collision detection in car_manager_t::next_frame()
+	gen_sound(SOUND_HORN, pos);
 }
 
 void car_t::honk_horn_if_close_and_fast() const {
@@ -235,15 +238,15 @@ void ao_draw_state_t::draw_ao_qbd() {
 }
 
 void ao_draw_state_t::occlusion_checker_t::set_camera(pos_dir_up const &pdu) {
-	if ((display_mode & 0x08) == 0) {state.building_ids.clear(); return;} // testing
+	if ((display_mode & 0x08) == 0) {state.clear(); return;} // testing
 	pos_dir_up near_pdu(pdu);
 	near_pdu.far_ = 2.0*city_params.road_spacing; // set far clipping plane to one city block
 	get_building_occluders(near_pdu, state);
-	//cout << "occluders: " << state.building_ids.size() << endl;
+	//cout << "line occluders: " << state.building_ids.size() << endl;
 }
 
 bool ao_draw_state_t::occlusion_checker_t::is_occluded(cube_t const &c) {
-	if (state.building_ids.empty()) return 0;
+	if (state.empty()) return 0;
 	float const z(c.z2()); // top edge
 	point const corners[4] = {point(c.x1(), c.y1(), z), point(c.x2(), c.y1(), z), point(c.x2(), c.y2(), z), point(c.x1(), c.y2(), z)};
 	return check_pts_occluded(corners, 4, state);
@@ -733,67 +736,100 @@ bool car_manager_t::choose_dest_parked_car(unsigned city_id, unsigned &plot_id,
 
 void car_manager_t::next_frame(ped_manager_t const &ped_manager, float car_speed) {
 	if (cars.empty() || !animate2) return;
-	// Warning: not really thread safe, but should be okay; the ped state should valid at all points (thought maybe inconsistent) and we don't need it to be exact every frame
+	// peds are updated after cars, so this is the ped state from the end of the previous frame
 	ped_manager.get_peds_crossing_roads(peds_crossing_roads);
 	//timer_t timer("Update Cars"); // 4K cars = 0.7ms / 2.1ms with destinations + navigation
 #pragma omp critical(modify_car_data)
 	{
 		if (car_destroyed) {remove_destroyed_cars();} // at least one car was destroyed in the previous frame - remove it/them
-		sort(cars.begin(), cars.end(), comp_car_road_then_pos(camera_pdu.pos - dstate.xlate)); // sort by city/road/position for intersection tests and tile shadow map binds
+		// sort by city/road/position for intersection tests and tile shadow map binds; cars are still mostly sorted from the previous frame
+		resort_mostly_sorted(cars, 0, cars.size(), comp_car_road_then_pos(camera_pdu.pos - dstate.xlate), resort_temp);
 	}
 	entering_city.clear();
 	car_blocks.clear();
+	road_run_starts.clear();
 	float const speed(CAR_SPEED_SCALE*car_speed*fticks);
+	int const num_cars(cars.size());
+	bool const use_threads(cars.size() >= MIN_CARS_FOR_THREADS);
 	bool saw_parked(0);
 	//unsigned num_on_conn_road(0);
 
-	for (auto i = cars.begin(); i != cars.end(); ++i) { // move cars
+	// Note: the car state isn't double buffered; instead, each parallel phase below is separated from the next by the implicit barrier and only writes
+	// state that no other car reads during that phase (own position, own road run, own car_in_front), so every read sees a consistent snapshot
+	// and the results don't depend on thread count; a second copy of cars would cost a full copy per frame, and car_in_front pointers into it
+	// would need to be remapped after every swap and resort
+#pragma omp parallel for schedule(static,256) if (use_threads)
+	for (int cix = 0; cix < num_cars; ++cix) { // move cars; only modifies the car's own state
+		car_t &car(cars[cix]);
+		car.car_in_front = nullptr; // reset for this frame
+		if (!car.is_parked()) {car.move(speed);} // no update for parked cars
+	}
+	for (auto i = cars.begin(); i != cars.end(); ++i) { // build city blocks and road runs, and register cars with shared city/intersection state
 		unsigned const cix(i - cars.begin());
-		i->car_in_front = nullptr; // reset for this frame
 
 		if (car_blocks.empty() || i->cur_city != car_blocks.back().cur_city) {
 			if (!saw_parked && !car_blocks.empty()) {car_blocks.back().first_parked = cix;} // no parked cars in prev city
 			saw_parked = 0; // reset for next city
 			car_blocks.emplace_back(cix, i->cur_city);
 		}
+		if (cix == 0 || i->cur_city != (i-1)->cur_city || i->cur_road != (i-1)->cur_road) {road_run_starts.push_back(cix);} // new city/road
+
 		if (i->is_parked()) {
 			if (!saw_parked) {car_blocks.back().first_parked = cix; saw_parked = 1;}
-			continue; // no update for parked cars
+			continue;
 		}
-		i->move(speed);
 		if (i->entering_city) {entering_city.push_back(cix);} // record for use in collision detection
 		if (!i->stopped_at_light && i->is_almost_stopped() && i->in_isect()) {get_car_isec(*i).stoplight.mark_blocked(i->dim, i->dir);} // blocking intersection
 		register_car_at_city(*i);
 	} // for i
 	if (!saw_parked && !car_blocks.empty()) {car_blocks.back().first_parked = cars.size();} // no parked cars in final city
 	car_blocks.emplace_back(cars.size(), 0); // add terminator
-
-	for (auto i = cars.begin(); i != cars.end(); ++i) { // collision detection
+	road_run_starts.push_back(cars.size()); // add terminator
+	int const num_runs(road_run_starts.size() - 1);
+
+	// collision detection between cars on the same road; the inner loop stops at the end of the city/road run,
+	// so each run only modifies its own cars and runs can be processed in parallel
+#pragma omp parallel for schedule(dynamic,16) if (use_threads)
+	for (int r = 0; r < num_runs; ++r) {
+		auto const run_end(cars.begin() + road_run_starts[r+1]);
+
+		for (auto i = cars.begin() + road_run_starts[r]; i != run_end; ++i) {
+			if (i->is_parked()) continue; // no collisions for parked cars
+			bool const on_conn_road(i->cur_city == CONN_CITY_IX);
+			float const length(i->get_length()), max_check_dist(max(3.0f*length, (length + i->get_max_lookahead_dist()))); // max of collision dist and car-in-front dist
+
+			for (auto j = i+1; j != run_end; ++j) { // check for collisions with cars on the same road (can't test seg because they can be on diff segs but still collide)
+				if (!on_conn_road && i->cur_road_type == j->cur_road_type && abs((int)i->cur_seg - (int)j->cur_seg) > (on_conn_road ? 1 : 0)) break; // diff road segs or diff isects
+				check_collision(*i, *j);
+				i->register_adj_car(*j);
+				j->register_adj_car(*i);
+				if (!dist_xy_less_than(i->get_center(), j->get_center(), max_check_dist)) break;
+			}
+		} // for i
+	} // for r
+	// cars in intersections find the car in front on their destination road; car positions aren't modified here,
+	// so every car sees the same post-collision state of the other cars regardless of processing order
+	next_car_after_turn.resize(cars.size());
+
+#pragma omp parallel for schedule(static,256) if (use_threads)
+	for (int cix = 0; cix < num_cars; ++cix) {
+		car_t &car(cars[cix]);
+		next_car_after_turn[cix] = ((!car.is_parked() && car.in_isect()) ? find_next_car_after_turn(car) : -1); // Note: calculates in car.car_in_front
+	}
+	for (auto i = cars.begin(); i != cars.end(); ++i) { // collisions that cross city/road runs are applied serially
 		if (i->is_parked()) continue; // no collisions for parked cars
-		bool const on_conn_road(i->cur_city == CONN_CITY_IX);
-		float const length(i->get_length()), max_check_dist(max(3.0f*length, (length + i->get_max_lookahead_dist()))); // max of collision dist and car-in-front dist
-
-		for (auto j = i+1; j != cars.end(); ++j) { // check for collisions with cars on the same road (can't test seg because they can be on diff segs but still collide)
-			if (i->cur_city != j->cur_city || i->cur_road != j->cur_road) break; // different cities or roads
-			if (!on_conn_road && i->cur_road_type == j->cur_road_type && abs((int)i->cur_seg - (int)j->cur_seg) > (on_conn_road ? 1 : 0)) break; // diff road segs or diff isects
-			check_collision(*i, *j);
-			i->register_adj_car(*j);
-			j->register_adj_car(*i);
-			if (!dist_xy_less_than(i->get_center(), j->get_center(), max_check_dist)) break;
-		}
-		if (on_conn_road) { // on connector road, check before entering intersection to a city
+		unsigned const cix(i - cars.begin());
+
+		if (i->cur_city == CONN_CITY_IX) { // on connector road, check before entering intersection to a city
 			for (auto ix = entering_city.begin(); ix != entering_city.end(); ++ix) {
-				if (*ix != unsigned(i - cars.begin())) {check_collision(*i, cars[*ix]);}
+				if (*ix != cix) {check_collision(*i, cars[*ix]);}
 			}
 			//++num_on_conn_road;
 		}
-		if (i->in_isect()) {
-			int const next_car(find_next_car_after_turn(*i)); // Note: calculates in i->car_in_front
-			if (next_car >= 0) {check_collision(*i, cars[next_car]);} // make sure we collide with the correct car
-		}
+		if (next_car_after_turn[cix] >= 0) {check_collision(*i, cars[next_car_after_turn[cix]]);} // make sure we collide with the correct car
 		if (!peds_crossing_roads.peds.empty()) {check_car_for_ped_colls(*i);}
 	} // for i
-	update_cars(); // run update logic
+	update_cars(); // run update logic; serial because it modifies shared intersection state and uses a shared random number generator
 
 	if (map_mode) { // create cars_by_road
 		// cars have moved since the last sort and may no longer be in city/road order, but this algorithm doesn't require that;
@@ -191,6 +191,43 @@ struct comp_car_road_then_pos {
 	bool operator()(car_t const &c1, car_t const &c2) const;
 };
 
+// re-sorts [start, end) of v when only a few elements have moved since it was last sorted, such as cars or pedestrians between frames;
+// out-of-order elements are pulled out in one pass, sorted, and merged back in from the end, which is O(n + k*log(k)) for k moved elements;
+// falls back to a full sort if too many elements moved; moved is a reused temporary
+template<typename T, typename C> void resort_mostly_sorted(vector<T> &v, unsigned start, unsigned end, C const &comp, vector<T> &moved) {
+	assert(start <= end && end <= v.size());
+	unsigned const num(end - start), max_moved(max(32U, num/8));
+	if (num < 2) return;
+	unsigned num_kept(start+1); // elements [start, num_kept) are kept and sorted
+	moved.clear();
+
+	for (unsigned i = start+1; i < end; ++i) {
+		if (num_kept == start || !comp(v[i], v[num_kept-1])) { // in order with the last kept element
+			if (i != num_kept) {v[num_kept] = std::move(v[i]);}
+			++num_kept;
+			continue;
+		}
+		// out of order: remove both this element and the last kept element, since we don't know which one moved
+		moved.push_back(std::move(v[num_kept-1]));
+		moved.push_back(std::move(v[i]));
+		--num_kept;
+		if (moved.size() > max_moved) break; // too many
+	}
+	if (moved.size() > max_moved) { // put the removed elements back into the gap after the kept elements and do a full sort
+		std::move(moved.begin(), moved.end(), (v.begin() + num_kept));
+		sort((v.begin() + start), (v.begin() + end), comp);
+		return;
+	}
+	if (moved.empty()) return; // already sorted
+	sort(moved.begin(), moved.end(), comp);
+	int src(num_kept - 1), mix(moved.size() - 1), dest(end - 1);
+
+	while (mix >= 0) { // merge from the back into the space vacated by the moved elements
+		if (src >= int(start) && comp(moved[mix], v[src])) {v[dest--] = std::move(v[src--]);}
+		else {v[dest--] = std::move(moved[mix--]);}
+	}
+}
+
 
 class road_mat_mgr_t {
 
@@ -491,6 +528,31 @@ struct tunnel_t : public road_connector_t {
 	bool line_intersect(point const &p1, point const &p2, float &t) const;
 };
 
+class car_router_t { // traffic-aware shortest paths between the intersections of a city road network, for choosing car turn directions
+	struct edge_t {
+		unsigned src, dest, seg_start, seg_end; // src/dest nodes and range in seg_ixs of the road segments along this edge
+		float len, cost;
+		edge_t(unsigned src_, unsigned seg_start_) : src(src_), dest(0), seg_start(seg_start_), seg_end(seg_start_), len(0.0), cost(0.0) {}
+	};
+	unsigned num_nodes, isec_offset[3]; // nodes are intersections, in the same order as global intersection indices {2-way, 3-way, 4-way}
+	vector<edge_t> edges;
+	vector<int> node_edges; // 4 per node, indexed by exit orient; -1 = no edge
+	vector<unsigned> seg_ixs, rev_start, rev_edges; // rev_*: incoming edges per node
+	mutable vector<vector<float>> cost_to_dest; // per dest node, computed on demand and cleared when edge costs change
+	mutable vector<pair<float, unsigned>> open; // reused temporary
+
+	static float calc_edge_cost(float len, unsigned num_cars);
+	void calc_costs_to_dest(unsigned dest) const;
+public:
+	car_router_t() : num_nodes(0) {isec_offset[0] = isec_offset[1] = isec_offset[2] = 0;}
+	bool empty() const {return edges.empty();}
+	void clear();
+	void build(vector<road_seg_t> const &segs, vector<road_isec_t> const isecs[3]);
+	void update_edge_costs(vector<road_seg_t> const &segs);
+	unsigned get_node(unsigned isec_type, unsigned isec_ix) const {assert(isec_type < 3); return (isec_offset[isec_type] + isec_ix);}
+	float get_cost_via(unsigned node, unsigned orient, unsigned dest) const;
+};
+
 struct range_pair_t {
 	unsigned s, e; // Note: e is one past the end
 	range_pair_t(unsigned s_=0, unsigned e_=0) : s(s_), e(e_) {}
@@ -591,7 +653,9 @@ class car_manager_t {
 	ped_city_vect_t peds_crossing_roads;
 	car_draw_state_t dstate;
 	rand_gen_t rgen;
-	vector<unsigned> entering_city;
+	vector<unsigned> entering_city, road_run_starts; // road_run_starts: index of the first car of each city/road run in sorted cars
+	vector<int> next_car_after_turn; // per car, for cars in intersections
+	vector<car_t> resort_temp;
 	cube_t garages_bcube;
 	unsigned first_parked_car, first_garage_car;
 	bool car_destroyed;
@@ -630,6 +694,9 @@ public:
 }; // car_manager_t
 
 
+struct ped_coll_state_t;
+class path_finder_t;
+
 struct pedestrian_t : public waiting_obj_t {
 
 	point target_pos, dest_car_center; // since cars are sorted each frame, we can't find their positions by index so we need to cache them here
@@ -637,12 +704,13 @@ struct pedestrian_t : public waiting_obj_t {
 	point pos;
 	float radius, speed, anim_time;
 	unsigned plot, next_plot, dest_plot, dest_bldg; // Note: can probably be made unsigned short later, though these are global plot and building indices
-	unsigned short city, model_id, ssn, colliding_ped;
+	unsigned colliding_ped; // index of the other ped; can exceed 64K
+	unsigned short city, model_id, ssn;
 	unsigned char stuck_count;
 	bool collided, ped_coll, is_stopped, in_the_road, at_crosswalk, at_dest, has_dest_bldg, has_dest_car, destroyed, in_building;
 
 	pedestrian_t(float radius_) : target_pos(all_zeros), dir(zero_vector), vel(zero_vector), pos(all_zeros), radius(radius_), speed(0.0), anim_time(0.0), plot(0), next_plot(0), dest_plot(0),
-		dest_bldg(0), city(0), model_id(0), ssn(0), colliding_ped(0), stuck_count(0), collided(0), ped_coll(0), is_stopped(0), in_the_road(0), at_crosswalk(0), at_dest(0), has_dest_bldg(0),
+		dest_bldg(0), colliding_ped(0), city(0), model_id(0), ssn(0), stuck_count(0), collided(0), ped_coll(0), is_stopped(0), in_the_road(0), at_crosswalk(0), at_dest(0), has_dest_bldg(0),
 		has_dest_car(0), destroyed(0), in_building(0) {}
 	bool operator<(pedestrian_t const &ped) const {return ((city == ped.city) ? (plot < ped.plot) : (city < ped.city));} // currently only compares city + plot
 	string get_name() const;
@@ -655,25 +723,50 @@ struct pedestrian_t : public waiting_obj_t {
 	void stop();
 	void go();
 	bool check_for_safe_road_crossing(ped_manager_t const &ped_mgr, cube_t const &plot_bcube, cube_t const &next_plot_bcube, vect_cube_t *dbg_cubes=nullptr) const;
-	bool check_ped_ped_coll_range(vector<pedestrian_t> &peds, unsigned pid, unsigned ped_start, unsigned target_plot, float prox_radius, vector3d &force);
-	bool check_ped_ped_coll(ped_manager_t const &ped_mgr, vector<pedestrian_t> &peds, unsigned pid, float delta_dir);
-	bool check_ped_ped_coll_stopped(vector<pedestrian_t> &peds, unsigned pid);
-	bool check_inside_plot(ped_manager_t &ped_mgr, point const &prev_pos, cube_t const &plot_bcube, cube_t const &next_plot_bcube);
+	bool check_ped_ped_coll_range(vector<ped_coll_state_t> const &prev_state, unsigned pid, unsigned ped_start, unsigned target_plot, float prox_radius, vector3d &force);
+	bool check_ped_ped_coll(ped_manager_t const &ped_mgr, vector<ped_coll_state_t> const &prev_state, unsigned pid, float delta_dir);
+	bool check_inside_plot(ped_manager_t const &ped_mgr, point const &prev_pos, cube_t const &plot_bcube, cube_t const &next_plot_bcube);
 	bool check_road_coll(ped_manager_t const &ped_mgr, cube_t const &plot_bcube, cube_t const &next_plot_bcube) const;
 	bool is_valid_pos(vect_cube_t const &colliders, bool &ped_at_dest, ped_manager_t const *const ped_mgr) const;
 	bool try_place_in_plot(cube_t const &plot_cube, vect_cube_t const &colliders, unsigned plot_id, rand_gen_t &rgen);
 	point get_dest_pos(cube_t const &plot_bcube, cube_t const &next_plot_bcube, ped_manager_t const &ped_mgr) const;
 	bool choose_alt_next_plot(ped_manager_t const &ped_mgr);
 	void get_avoid_cubes(ped_manager_t const &ped_mgr, vect_cube_t const &colliders, point const &dest_pos, vect_cube_t &avoid) const;
-	void next_frame(ped_manager_t &ped_mgr, vector<pedestrian_t> &peds, unsigned pid, rand_gen_t &rgen, float delta_dir);
+	bool needs_update() const {return (!destroyed && speed != 0.0 && !in_building);} // building update/movement logic handled elsewhere
+	void next_frame(ped_manager_t const &ped_mgr, vector<ped_coll_state_t> const &prev_state, path_finder_t &path_finder, unsigned pid, rand_gen_t &rgen, float delta_dir);
 	void register_at_dest();
 	void destroy() {destroyed = 1;} // that's it, no other effects
 	bool is_close_to_player() const;
 	void debug_draw(ped_manager_t &ped_mgr) const;
 };
 
+struct ped_coll_state_t { // the part of a ped that other peds read during the parallel update, captured before the update so that it doesn't depend on update order
+	point pos;
+	vector3d vel;
+	float radius;
+	unsigned plot;
+	ped_coll_state_t(pedestrian_t const &ped) : pos(ped.pos), vel(ped.vel), radius(ped.radius), plot(ped.plot) {}
+};
+
 unsigned const MAX_PATH_DEPTH = 32;
 
+class ped_nav_graph_t { // visibility graph over the expanded avoid cubes of one plot, shared by all peds of the same radius in that plot
+	struct edge_t {
+		unsigned node;
+		float len;
+		edge_t(unsigned node_, float len_) : node(node_), len(len_) {}
+	};
+	vect_cube_t cubes;
+	vector<point> nodes; // expanded cube corners that aren't inside another cube; zval is unused
+	vector<unsigned> edge_start; // first edge index for each node + terminator
+	vector<edge_t> edges;
+	friend class path_finder_t;
+public:
+	void build(vect_cube_t const &cubes_, float gap);
+	unsigned num_nodes() const {return nodes.size();}
+	unsigned num_edges() const {return edges.size();}
+};
+
 class path_finder_t {
 	struct path_t : public vector<point> {
 		float length;
@@ -692,11 +785,24 @@ class path_finder_t {
 	cube_t plot_bcube;
 	path_t cur_path, best_path, partial_path;
 	bool debug;
+	// A* state for nav graph queries, reused across calls
+	struct open_node_t {
+		float cost; // dist + heuristic
+		unsigned node;
+		open_node_t(float cost_, unsigned node_) : cost(cost_), node(node_) {}
+		bool operator<(open_node_t const &n) const {return (cost > n.cost);} // min heap
+	};
+	vector<open_node_t> open;
+	vector<float> node_dist;
+	vector<unsigned> node_prev;
+	vector<uint8_t> node_closed;
 
 	bool add_pt_to_path(point const &p, path_t &path) const;
 	bool add_pts_around_cube_xy(path_t &path, path_t const &cur_path, path_t::const_iterator p, cube_t const &c, bool dir);
 	void find_best_path_recur(path_t const &cur_path, unsigned depth);
 	bool shorten_path(path_t &path) const;
+	void extract_graph_path(ped_nav_graph_t const &graph, unsigned end_node, path_t &path) const;
+	bool find_best_path_graph(ped_nav_graph_t const &graph);
 public:
 	path_finder_t(bool debug_=0) : gap(0.0f), debug(debug_) {}
 	vect_cube_t &get_avoid_vector() {return avoid;}
@@ -704,7 +810,7 @@ public:
 	bool found_complete_path() const {return (!best_path.empty());}
 	bool found_path() const {return (found_complete_path() || !partial_path.empty());}
 	bool find_best_path();
-	unsigned run(point const &pos_, point const &dest_, cube_t const &plot_bcube_, float gap_, point &new_dest);
+	unsigned run(point const &pos_, point const &dest_, cube_t const &plot_bcube_, float gap_, point &new_dest, ped_nav_graph_t const *const graph=nullptr);
 };
 
 class ped_manager_t { // pedestrians
@@ -718,11 +824,13 @@ class ped_manager_t { // pedestrians
 	car_manager_t const &car_manager; // used for ped road crossing safety and dest car selection
 	ped_model_loader_t ped_model_loader;
 	vector<pedestrian_t> peds, peds_b; // dynamic city, static building
+	vector<pedestrian_t> resort_temp;
 	vector<city_ixs_t> by_city; // first ped/plot index for each city
 	vector<unsigned> by_plot;
 	vector<unsigned char> need_to_sort_city;
 	vector<car_city_vect_t> cars_by_city;
 	vector<point> bldg_ppl_pos;
+	mutable map<uint64_t, ped_nav_graph_t> nav_graphs; // keyed by plot and ped radius; built on demand
 	rand_gen_t rgen;
 	ao_draw_state_t dstate;
 	int selected_ped_ssn;
@@ -741,7 +849,8 @@ class ped_manager_t { // pedestrians
 		bool &in_sphere_draw, bool shadow_only, bool is_dlight_shadows, bool enable_animations);
 public:
 	// for use in pedestrian_t, mostly for collisions and path finding
-	path_finder_t path_finder;
+	vector<path_finder_t> path_finders; // one per thread
+	vector<ped_coll_state_t> prev_state; // one per ped, reused across frames
 	vect_cube_t const &get_colliders_for_plot(unsigned city_ix, unsigned plot_ix) const;
 	cube_t const &get_city_plot_bcube_for_peds(unsigned city_ix, unsigned plot_ix) const;
 	cube_t get_expanded_city_bcube_for_peds(unsigned city_ix) const;
@@ -753,7 +862,8 @@ public:
 	bool mark_crosswalk_in_use(pedestrian_t const &ped);
 	bool choose_dest_building_or_parked_car(pedestrian_t &ped);
 	unsigned get_next_plot(pedestrian_t &ped, int exclude_plot=-1) const;
-	void move_ped_to_next_plot(pedestrian_t &ped);
+	ped_nav_graph_t const &get_nav_graph(pedestrian_t const &ped) const;
+	void clear_nav_graphs() {nav_graphs.clear();} // must be called if plot colliders or buildings change
 	bool has_nearby_car(pedestrian_t const &ped, bool road_dim, float delta_time, vect_cube_t *dbg_cubes=nullptr) const;
 	bool has_nearby_car_on_road(pedestrian_t const &ped, bool dim, unsigned road_ix, float delta_time, vect_cube_t *dbg_cubes) const;
 	bool has_car_at_pt(point const &pos, unsigned city, bool is_parked) const;
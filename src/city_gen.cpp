@@ -17,6 +17,7 @@ bool const CHECK_HEIGHT_BORDER_ONLY = 1; // choose building site to minimize edg
 float const OUTSIDE_TERRAIN_HEIGHT  = 0.0;
 float const CAR_LANE_OFFSET         = 0.15; // in units of road width
 float const CITY_LIGHT_FALLOFF      = 0.2;
+unsigned const ROUTE_UPDATE_FRAMES   = 60; // car routing costs are updated from road traffic this often
 
 
 float city_dlight_pcf_offset_scale(1.0);
@@ -24,7 +25,7 @@ city_params_t city_params;
 point pre_smap_player_pos(all_zeros);
 
 extern bool enable_dlight_shadows, dl_smap_enabled, draw_building_interiors, flashlight_on, camera_in_building, have_indir_smoke_tex;
-extern int rand_gen_index, display_mode, animate2, draw_model;
+extern int rand_gen_index, display_mode, animate2, draw_model, frame_counter;
 extern unsigned shadow_map_sz, cur_display_iter;
 extern float water_plane_z, shadow_map_pcf_offset, cobj_z_bias, fticks;
 extern vector<light_source> dl_sources;
@@ -1147,6 +1148,7 @@ class city_road_gen_t : public road_gen_base_t {
 		set<unsigned> connected_to; // vector?
 		map<uint64_t, unsigned> tile_to_block_map;
 		map<unsigned, road_isec_t const *> cix_to_isec; // maps city_ix to intersection
+		car_router_t router; // unused for the global road network
 		vector<vect_cube_t> plot_colliders;
 		plot_xy_t plot_xy;
 		unsigned city_id, cluster_id, plot_id_offset;
@@ -1231,6 +1233,7 @@ class city_road_gen_t : public road_gen_base_t {
 			city_obj_placer.clear();
 			tile_blocks.clear();
 			plot_colliders.clear();
+			router.clear();
 		}
 		bool gen_road_grid(float road_width, float road_spacing) {
 			if (city_params.road_width > 0.5*city_params.road_spacing) {
@@ -1538,6 +1541,7 @@ class city_road_gen_t : public road_gen_base_t {
 				} // for i
 			} // for n
 			for (auto r = roads.begin(); r != roads.end(); ++r) {tot_road_len += r->get_length();} // calculate tot_road_len
+			if (!is_global_rn) {router.build(segs, isecs);} // no turn choices on connector roads
 		}
 		bool check_valid_conn_intersection(cube_t const &c, bool dim, bool dir, bool is_4_way) const {
 			return (is_4_way ? (find_3way_int_at(c, dim, dir) >= 0) : (find_conn_int_seg(c, dim, dir) >= 0));
@@ -2279,8 +2283,21 @@ class city_road_gen_t : public road_gen_base_t {
 					orients[TURN_LEFT ] = stoplight_ns::conn_left [orient_in];
 					orients[TURN_RIGHT] = stoplight_ns::conn_right[orient_in];
 
-					// TODO: use dest_seg.car_count to estimate traffic and route around
-					if (car.dest_valid && car.cur_city != CONN_CITY_IX) { // Note: don't need to update dest logic on connector roads since there are no choices to make
+					bool const use_dest(car.dest_valid && car.cur_city != CONN_CITY_IX); // Note: don't need to update dest logic on connector roads since there are no choices to make
+
+					if (!use_dest) { // use random turn direction
+						while (1) {
+							unsigned new_turn_dir(0); // force turn on global conn road 75% of the time to get more cars traveling between cities
+							bool const force_turn(isec.is_global_conn_int() && (rgen.rand()&3) != 0);
+							int const rval(rgen.rand()%(force_turn ? 2 : 4));
+							if      (rval == 0) {new_turn_dir = TURN_LEFT ;} // 25%
+							else if (rval == 1) {new_turn_dir = TURN_RIGHT;} // 25%
+							else                {new_turn_dir = TURN_NONE ;} // 50%
+							if (new_turn_dir == car.front_car_turn_dir && (rgen.rand()%4) != 0) continue; // car in front is too slow, don't turn the same way as it
+							if (isec.is_orient_currently_valid(orients[new_turn_dir], new_turn_dir)) {car.turn_dir = new_turn_dir; break;} // success
+						} // end while
+					}
+					else if (!car_rn.choose_turn_dir_by_route(car, isec, orients, road_networks, global_rn)) { // not routed around traffic; head toward the dest
 						point const dest_pos(car_rn.get_car_dest_isec_center(car, road_networks, global_rn));
 						vector3d const dest_dir(dest_pos - car.get_center());
 						bool const pri_dim(fabs(dest_dir.x) < fabs(dest_dir.y)), pri_dir(dest_dir[pri_dim] > 0), sec_dir(dest_dir[!pri_dim] > 0);
@@ -2304,18 +2321,6 @@ class city_road_gen_t : public road_gen_base_t {
 						} // for d
 						assert(best_score > 0); // no dead end roads
 					}
-					else { // use random turn direction
-						while (1) {
-							unsigned new_turn_dir(0); // force turn on global conn road 75% of the time to get more cars traveling between cities
-							bool const force_turn(isec.is_global_conn_int() && (rgen.rand()&3) != 0);
-							int const rval(rgen.rand()%(force_turn ? 2 : 4));
-							if      (rval == 0) {new_turn_dir = TURN_LEFT ;} // 25%
-							else if (rval == 1) {new_turn_dir = TURN_RIGHT;} // 25%
-							else                {new_turn_dir = TURN_NONE ;} // 50%
-							if (new_turn_dir == car.front_car_turn_dir && (rgen.rand()%4) != 0) continue; // car in front is too slow, don't turn the same way as it
-							if (isec.is_orient_currently_valid(orients[new_turn_dir], new_turn_dir)) {car.turn_dir = new_turn_dir; break;} // success
-						} // end while
-					}
 					assert(isec.conn & (1<<orients[car.turn_dir]));
 					car.front_car_turn_dir = TURN_UNSPEC; // reset state now that it's been used
 					car.stopped_at_light   = (isec.red_or_yellow_light(car) || !car_rn.car_can_go_now(car, global_rn));
@@ -2326,6 +2331,31 @@ class city_road_gen_t : public road_gen_base_t {
 			assert(get_car_rn(car, road_networks, global_rn).get_road_bcube_for_car(car, global_rn).intersects_xy(car.bcube)); // sanity check
 		}
 	private:
+		bool choose_turn_dir_by_route(car_t &car, road_isec_t const &isec, unsigned const orients[3], vector<road_network_t> const &road_networks, road_network_t const &global_rn) const {
+			if (router.empty()) return 0;
+			int const dest_node(get_car_dest_node(car, road_networks, global_rn));
+			unsigned const cur_node(router.get_node(car.get_isec_type(), car.cur_seg));
+			if (dest_node < 0 || (unsigned)dest_node == cur_node) return 0; // at the destination, or at the connector to the dest city; handled by the caller
+			float best_cost(FLT_MAX);
+
+			for (unsigned tdir = 0; tdir < 3; ++tdir) { // choose the lowest cost of all valid turn dirs from {none/straight, left, right}
+				if (!isec.is_orient_currently_valid(orients[tdir], tdir)) continue; // can't turn in this dir
+				float const cost(router.get_cost_via(cur_node, orients[tdir], dest_node));
+				if (cost < best_cost) {best_cost = cost; car.turn_dir = tdir;}
+			}
+			return (best_cost < FLT_MAX);
+		}
+		int get_car_dest_node(car_t &car, vector<road_network_t> const &road_networks, road_network_t const &global_rn) const { // returns -1 if not found
+			if (car.dest_city == city_id) {return car.dest_isec;} // local destination within the current city; dest_isec uses the same ordering as the router
+			assert(car.dest_city < road_networks.size());
+			road_isec_t const *const isec(find_isec_to_dest_city(car, road_networks[car.dest_city], global_rn)); // destination in another city
+			if (isec == nullptr) return -1;
+
+			for (unsigned n = 0; n < 3; ++n) {
+				if (!isecs[n].empty() && isec >= &isecs[n].front() && isec <= &isecs[n].back()) {return router.get_node(n, (isec - &isecs[n].front()));}
+			}
+			return -1;
+		}
 		point get_car_dest_isec_center(car_t &car, vector<road_network_t> const &road_networks, road_network_t const &global_rn) const {
 			if (car.dest_city == city_id) {return get_isec_by_ix(car.dest_isec).get_cube_center();} // local destination within the current city
 			assert(car.dest_city < road_networks.size());
@@ -2365,6 +2395,7 @@ class city_road_gen_t : public road_gen_base_t {
 			for (unsigned n = 1; n < 3; ++n) { // {2-way, 3-way, 4-way} - Note: 2-way can be skipped
 				for (auto i = isecs[n].begin(); i != isecs[n].end(); ++i) {i->next_frame();} // update stoplight state
 			}
+			if (!router.empty() && (frame_counter % ROUTE_UPDATE_FRAMES) == 0) {router.update_edge_costs(segs);} // must be before resetting car counts
 			for (auto i = segs.begin(); i != segs.end(); ++i) {i->next_frame();}
 			//cout << TXT(city_id) << TXT(tot_road_len) << TXT(num_cars) << TXT(get_traffic_density()) << endl;
 			num_cars = 0;
@@ -2814,7 +2845,7 @@ public:
 	
 	void update_car(car_t &car, rand_gen_t &rgen) const {
 		if (car.cur_city == NO_CITY_IX) return; // not in a city (in a garage), nothing to update
-		//update_car_seg_stats(car); // not needed - stats not yet used
+		update_car_seg_stats(car); // used for traffic-aware routing
 		get_car_rn(car).update_car(car, rgen, road_networks, global_rn);
 		if (city_params.enable_car_path_finding) {update_car_dest(car);}
 	}
@@ -3102,14 +3133,11 @@ public:
 		car_manager.get_color_at_xy(pos, color, int_ret); // check cars next, but override the color
 		return 1;
 	}
-	void next_frame(bool use_threads_2_3) { // Note: threads: 0=draw, 1=roads and cars, 2=pedestrians
+	void next_frame() { // Note: may run on a thread other than the draw thread; cars and peds are updated in sequence, and each uses all available threads
 		if (!city_params.enabled()) return;
-
-		if (!use_threads_2_3 || omp_get_thread_num_3dw() == 1) { // thread 1
-			road_gen.next_frame(); // update stoplights; must be before car_manager next_frame() call
-			car_manager.next_frame(ped_manager, city_params.car_speed);
-		}
-		if (!use_threads_2_3 || omp_get_thread_num_3dw() == 2) {ped_manager.next_frame();} // thread=2
+		road_gen.next_frame(); // update stoplights; must be before car_manager next_frame() call
+		car_manager.next_frame(ped_manager, city_params.car_speed);
+		ped_manager.next_frame();
 	}
 	void draw(int shadow_only, int reflection_pass, int trans_op_mask, vector3d const &xlate) { // shadow_only: 0=non-shadow pass, 1=sun/moon shadow, 2=dynamic shadow
 		if (!shadow_only && !reflection_pass && (trans_op_mask & 1)) {setup_city_lights(xlate);} // setup lights on first (opaque) non-shadow pass
@@ -3154,6 +3182,10 @@ city_gen_t city_gen;
 
 bool parse_city_option(FILE *fp) {return city_params.read_option(fp);}
 bool have_cities() {return city_params.enabled();}
+bool city_fits_in_heightmap(unsigned xsize, unsigned ysize) { // see find_best_city_location()
+	unsigned const max_sz(city_params.city_size_max + 2*city_params.city_border);
+	return (max_sz < xsize && max_sz < ysize);
+}
 // Note: this is used for parallel car/pedestrian updates and does not include city_params.num_building_peds
 bool have_city_models() {
 	return ((have_cities() && (city_params.num_cars > 0 || city_params.num_peds > 0)) || (enable_building_people_ai() && city_params.num_building_peds > 0));
@@ -3171,7 +3203,7 @@ void gen_city_details() {city_gen.gen_details();} // called after gen_buildings(
 void get_city_bcubes(vect_cube_t &bcubes) {city_gen.get_city_bcubes(bcubes);}
 void get_city_road_bcubes(vect_cube_t &bcubes, bool connector_only) {city_gen.get_all_road_bcubes(bcubes, connector_only);}
 void get_city_plot_bcubes(vector<cube_with_zval_t> &bcubes) {city_gen.get_all_plot_bcubes(bcubes);}
-void next_city_frame(bool use_threads_2_3) {city_gen.next_frame(use_threads_2_3);}
+void next_city_frame() {city_gen.next_frame();}
 void draw_cities(int shadow_only, int reflection_pass, int trans_op_mask, vector3d const &xlate) {city_gen.draw(shadow_only, reflection_pass, trans_op_mask, xlate);}
 void setup_city_lights(vector3d const &xlate) {city_gen.setup_city_lights(xlate);}
 
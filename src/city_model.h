@@ -27,8 +27,8 @@ struct city_model_t {
 class city_model_loader_t : public model3ds {
 protected:
 	vector<int> models_valid;
-	void ensure_models_loaded() {if (empty()) {load_models();}}
 public:
+	void ensure_models_loaded() {if (empty()) {load_models();}}
 	virtual ~city_model_loader_t() {}
 	virtual unsigned num_models() const = 0;
 	virtual city_model_t const &get_model(unsigned id) const = 0;
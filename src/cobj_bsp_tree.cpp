@@ -245,6 +245,33 @@ template<typename T> void cobj_tree_simple_type_t<T>::build_tree_top(bool verbos
 struct colored_cube_t;
 template class cobj_tree_simple_type_t<sphere_with_id_t>;
 template class cobj_tree_simple_type_t<colored_cube_t>;
+template class cobj_tree_simple_type_t<cube_with_ix_t>;
+
+
+// *** cobj_tree_cube_ix_t ***
+
+
+void cobj_tree_cube_ix_t::calc_node_bbox(tree_node &n) const {
+
+	assert(n.start < n.end);
+	for (unsigned i = n.start; i < n.end; ++i) {n.assign_or_union_with_cube(objects[i]);} // bcube union
+}
+
+void cobj_tree_cube_ix_t::get_line_isect_ixs(point const &p1, point const &p2, vector<unsigned> &ixs) const {
+
+	if (nodes.empty()) return;
+	node_ix_mgr nixm(nodes, p1, p2);
+	unsigned const num_nodes((unsigned)nodes.size());
+
+	for (unsigned nix = 0; nix < num_nodes;) {
+		tree_node const &n(nodes[nix]);
+		if (!nixm.check_node(nix)) continue; // Note: modifies nix
+
+		for (unsigned i = n.start; i < n.end; ++i) { // check leaves
+			if (check_line_clip(p1, p2, objects[i].d)) {ixs.push_back(objects[i].ix);}
+		}
+	}
+}
 
 
 // *** cobj_tree_tquads_t ***
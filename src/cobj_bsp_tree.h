@@ -104,6 +104,17 @@ public:
 };
 
 
+// top level tree of a two-level BVH: bcubes with external object/instance indices
+class cobj_tree_cube_ix_t : public cobj_tree_simple_type_t<cube_with_ix_t> {
+
+	virtual void calc_node_bbox(tree_node &n) const;
+
+public:
+	vector<cube_with_ix_t> &get_objs_ref() {return objects;}
+	void get_line_isect_ixs(point const &p1, point const &p2, vector<unsigned> &ixs) const;
+};
+
+
 class cobj_bvh_tree : public cobj_tree_base {
 
 	coll_obj_group const *cobjs;
@@ -1559,6 +1559,50 @@ void vert_coll_detector::check_cobj_intersect(int index, bool enable_cfs, bool p
 }
 
 
+// collision with the voxel terrain field, which replaces the voxel cobjs when voxel field_coll is enabled; the response is the same as for a static
+// voxel polygon cobj, which has no coll_func, except that there's no cobj for decals, and no deformation
+void vert_coll_detector::check_voxel_field_coll() {
+
+	vector3d norm;
+	float elastic(0.0);
+	if (!check_voxel_sphere_coll_field(obj.pos, o_radius, norm, elastic)) return; // updates obj.pos
+	assert(!is_nan(norm));
+	lcoll = ((norm.z > 0.99) ? 2 : 1); // top collision if normal is nearly vertical
+	obj_type const &otype(object_types[type]);
+	float const friction(otype.friction_factor*((obj.flags & FROZEN_FLAG) ? 0.5 : 1.0)); // frozen objects have half friction
+	if (animate2 && !player && obj.health <= 0.1) {obj.disable();}
+
+	if (friction < STICK_THRESHOLD) {
+		vector3d const v_old(obj.velocity);
+
+		if (otype.elasticity == 0.0 || elastic == 0.0 || (obj.flags & IS_CUBE_FLAG) || !obj.object_bounce(3, norm, elastic, 0.0)) {
+			if (lcoll == 2) {
+				obj.flags |= STATIC_COBJ_COLL; // collision with top
+				if (otype.flags & OBJ_IS_DROP) {obj.velocity = zero_vector;}
+			}
+			if (type != DYNAM_PART && obj.velocity != zero_vector) {
+				if (friction > 0.0) {obj.velocity *= (1.0 - min(1.0f, (tstep/TIMESTEP)*friction));} // apply kinetic friction
+				orthogonalize_dir(obj.velocity, norm, obj.velocity, 0); // rolling friction model
+			}
+		}
+		else if (already_bounced) {obj.velocity = v_old;} // can only bounce once
+		else {already_bounced = 1;}
+	}
+	else { // sticks
+		if (!obj.proc_stuck(lcoll == 2) && lcoll == 2) {obj.flags |= STATIC_COBJ_COLL;} // coll with top
+		obj.pos -= norm*(0.1*o_radius); // make sure it still intersects
+		obj.velocity = zero_vector;
+	}
+	obj.verify_data();
+	if (!obj.disabled() && (otype.flags & EXPL_ON_COLL)) {obj.disable();}
+	if (cnorm != NULL) *cnorm = norm;
+	obj.flags |= OBJ_COLLIDED;
+	coll      |= lcoll;
+	lcoll      = 0; // reset local collision
+	init_reset_pos(); // reset local state
+}
+
+
 void vert_coll_detector::init_reset_pos() {
 
 	temp = obj; // backup copy
@@ -1585,6 +1629,7 @@ int vert_coll_detector::check_coll() {
 	for (int d = 0; d < 1+!skip_dynamic; ++d) { // using v_collision_matrix doesn't seem to help
 		get_coll_sphere_cobjs_tree(obj.pos, o_radius, -1, *this, (d != 0));
 	}
+	check_voxel_field_coll();
 	return coll;
 }
 
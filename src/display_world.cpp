@@ -792,7 +792,7 @@ void display() {
 			update_cpos();
 			apply_camera_offsets(get_camera_pos());
 			check_xy_offsets();
-			next_city_frame(0); // make sure the cars animate
+			next_city_frame(); // make sure the cars animate
 		}
 		else if (world_mode == WMODE_GROUND) {
 			process_groups();
@@ -1220,16 +1220,22 @@ void display_inf_terrain() { // infinite terrain mode (Note: uses light params f
 	if (TIMETEST) PRINT_TIME("3.26");
 	render_tt_models(0, 0); // opaque pass; draws city buildings, cars, etc.
 
-	// threads: 0=draw, 1=roads and cars, 2=pedestrians
+	// threads: 0=draw, 1=roads, cars, and pedestrians; thread 1 enables nested parallelism for itself only so that the parallel car and pedestrian
+	// loops get a team of the remaining threads, while parallel loops started by the draw thread stay serial as before
 	// Note: it's questionable to update (move) cars between the opaque and transparent pass because the parts will be out of sync;
 	// however, only the headlight flares are drawn in the transparent pass, and it doesn't seem to be a problem, so we allow it
 	if (have_city_models() && frame_counter > 200) { // same frame_counter hack to avoid perf problem as in water color calculation
-	#pragma omp parallel num_threads(3)
+		int const num_threads(omp_get_max_threads_3dw());
+	#pragma omp parallel num_threads(2)
 		if (omp_get_thread_num_3dw() == 0) {draw_tiled_terrain(0);} // drawing must be on thread 0
-		else {next_city_frame(1);} // other threads (if threads enabled, else serial)
+		else {
+			omp_set_nested_3dw(1);
+			omp_set_num_threads_3dw(max(1, num_threads-1)); // leave one thread for drawing
+			next_city_frame();
+		}
 	}
 	else { // serial version
-		next_city_frame(0);
+		next_city_frame();
 		draw_tiled_terrain(0);
 	}
 	render_tt_models(0, 1); // transparent pass
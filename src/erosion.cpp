@@ -4,14 +4,91 @@
 
 #include "3DWorld.h"
 #include "mesh.h"
+#include "function_registry.h"
 #include <cfloat> // for FLT_EPSILON
+#include <fstream>
 
 
 extern float erode_amount, water_plane_z;
 
 
+// per-droplet sparse modified heights: open addressing hash map, with insertion ordered entries so that they can be applied in order
+class droplet_heights_t {
+	struct entry_t {
+		unsigned ix, slot;
+		float val;
+		entry_t(unsigned ix_, unsigned slot_, float val_) : ix(ix_), slot(slot_), val(val_) {}
+	};
+	vector<int> table; // index into entries, -1 = empty
+	vector<entry_t> entries;
+
+	unsigned find_slot(unsigned ix) const {
+		unsigned const mask(table.size() - 1);
+		unsigned slot((ix*2654435761U) & mask);
+		while (table[slot] >= 0 && entries[table[slot]].ix != ix) {slot = (slot + 1) & mask;}
+		return slot;
+	}
+	void grow() {
+		table.clear();
+		table.resize(max((size_t)256, 4*entries.size()), -1); // always a power of 2
+
+		for (unsigned i = 0; i < entries.size(); ++i) {
+			entries[i].slot = find_slot(entries[i].ix);
+			table[entries[i].slot] = i;
+		}
+	}
+public:
+	vector<entry_t> const &get_entries() const {return entries;}
+
+	void clear() {
+		for (auto const &e : entries) {table[e.slot] = -1;}
+		entries.clear();
+	}
+	float get(unsigned ix) const { // ix must have been added
+		int const eix(table[find_slot(ix)]);
+		assert(eix >= 0);
+		return entries[eix].val;
+	}
+	float &get_or_add(unsigned ix, float init_val) {
+		if (2*(entries.size() + 1) > table.size()) {grow();}
+		unsigned const slot(find_slot(ix));
+		if (table[slot] < 0) {table[slot] = entries.size(); entries.emplace_back(ix, slot, init_val);}
+		return entries[table[slot]].val;
+	}
+};
+
+struct erosion_droplet_t {
+	droplet_heights_t heights; // heights of the cells written by this droplet
+	vector<unsigned> touched;  // all cells read or written by this droplet, without duplicates
+};
+
+class erosion_cell_mask_t { // per-thread bit flags for the cells touched and written by the current droplet
+	vector<uint64_t> touched_bits, written_bits;
+
+	static bool test(vector<uint64_t> const &bits, unsigned ix) {return ((bits[ix >> 6] >> (ix & 63)) & 1);}
+	static void set (vector<uint64_t>       &bits, unsigned ix) {bits[ix >> 6] |= (1ULL << (ix & 63));}
+public:
+	void init(unsigned num) {touched_bits.assign((num + 63)/64, 0); written_bits.assign((num + 63)/64, 0);}
+	bool is_written(unsigned ix) const {return test(written_bits, ix);}
+	void set_written(unsigned ix) {set(written_bits, ix);}
+	bool touch(unsigned ix) { // returns true if not previously touched
+		if (test(touched_bits, ix)) return 0;
+		set(touched_bits, ix);
+		return 1;
+	}
+	void reset(vector<unsigned> const &touched) {
+		for (unsigned ix : touched) {touched_bits[ix >> 6] = written_bits[ix >> 6] = 0;} // clear all bits in these words
+	}
+};
+
+
 // see http://ranmantaru.com/blog/2011/10/08/water-erosion-on-heightmap-terrain/
-void apply_erosion(float *heightmap, int xsize, int ysize, float min_zval, unsigned num_iters) {
+// Droplets are simulated speculatively in parallel batches against the heightmap as of the start of the batch, recording the cells they touch and
+// the heights they write. The results are then committed serially in droplet order. A droplet that touched a cell written by an earlier droplet
+// in the same batch is simulated again against the updated heightmap before it's committed. The output is therefore identical to simulating
+// every droplet serially in order, for any number of threads.
+// rseed is added to the droplet index, so that disjoint ranges of droplets can be simulated in separate calls
+void apply_erosion(float *heightmap, int xsize, int ysize, float min_zval, unsigned num_iters, unsigned rseed, bool print_time) {
 
 	if (num_iters == 0 || erode_amount <= 0.0) return; // erosion disabled
 	RESET_TIME;
@@ -24,8 +101,14 @@ void apply_erosion(float *heightmap, int xsize, int ysize, float min_zval, unsig
 	float const Kq=10, Kw=0.001f, Kr=0.9f, Kd=0.02f, Ki=0.1f, minSlope=0.05f, g=20, Kg=g*2;
 	int const PAD(4), NX(xsize+2*PAD), NY(ysize+2*PAD);
 	unsigned const MAX_PATH_LEN(4*NX*NY);
-	vector<vector2d> erosion(NX*NY, vector2d(0.0, 0.0));
+	// more droplets per batch = more parallelism, but more droplets that overlap and must be simulated again; scale with area so that batches are sparse
+	unsigned const batch_size(max(1U, min(512U, unsigned(NX*NY/256))));
 	vector<float> mh_padded(NX*NY);
+	vector<unsigned> batch_written(NX*NY, 0); // batch index + 1 of the last batch that wrote each cell
+	vector<erosion_droplet_t> droplets(batch_size);
+	vector<erosion_cell_mask_t> masks(omp_get_max_threads_3dw());
+	unsigned num_resim(0);
+	for (auto &m : masks) {m.init(NX*NY);}
 
 	// pad mesh by 1 unit on each side to create a buffer of trash around the edges that can be discarded
 	for (int y = 0; y < NY; ++y) {
@@ -36,14 +119,27 @@ void apply_erosion(float *heightmap, int xsize, int ysize, float min_zval, unsig
 		}
 	}
 
+	// simulates one droplet against mh_padded plus the droplet's own changes; mh_padded is not modified
+	auto simulate_droplet = [&](int iter, erosion_droplet_t &dr, erosion_cell_mask_t &mask) {
+		dr.heights.clear();
+		dr.touched.clear();
+
+		auto read_height = [&](unsigned ix) -> float {
+			if (mask.touch(ix)) {dr.touched.push_back(ix); return mh_padded[ix];} // first touch, can't have been written
+			return (mask.is_written(ix) ? dr.heights.get(ix) : mh_padded[ix]);
+		};
+		auto add_height = [&](unsigned ix, float delta) {
+			if (mask.touch(ix)) {dr.touched.push_back(ix);}
+			mask.set_written(ix);
+			dr.heights.get_or_add(ix, mh_padded[ix]) += delta; // same sequence of float ops as modifying the heightmap in place
+		};
+
 #define HMAP_INDEX(x, y) (NX*max(min(y, NY-1), 0) + max(min(x, NX-1), 0))
-#define HMAP(x, y) mh_padded[HMAP_INDEX(x, y)]
+#define HMAP(x, y) read_height(HMAP_INDEX(x, y))
 
 #define DEPOSIT_AT(X, Z, W) { \
 	float const delta = ds*erode_amount*(W); \
-	unsigned const ix(HMAP_INDEX((X), (Z))); \
-	erosion[ix].y += delta; \
-	if (!(X < 0 || Z < 0 || X >= NX || Z >= NY)) {mh_padded[ix] += delta;} \
+	if (!(X < 0 || Z < 0 || X >= NX || Z >= NY)) {add_height(HMAP_INDEX((X), (Z)), delta);} \
 }
 
 #define DEPOSIT(H) \
@@ -55,18 +151,10 @@ void apply_erosion(float *heightmap, int xsize, int ysize, float min_zval, unsig
 
 #define ERODE(X, Z, W) { \
 	float const delta=ds*erode_amount*(W); \
-	unsigned const ix(HMAP_INDEX((X), (Z))); \
-	mh_padded[ix]-=delta; \
-	vector2d &e=erosion[ix]; \
-	float r=e.x, d=e.y; \
-	if (delta<=d) {d-=delta;} else {r+=delta-d; d=0;} \
-	e.x=r; e.y=d; \
+	add_height(HMAP_INDEX((X), (Z)), -delta); \
 }
-
-#pragma omp parallel for schedule(dynamic,1)
-	for (int iter=0; iter < (int)num_iters; ++iter) {
 		rand_gen_t rgen;
-		rgen.set_state(iter+11, 79*iter+121);
+		rgen.set_state(iter+rseed+11, 79*(iter+rseed)+121);
 		int xi = PAD + (rgen.rand()%xsize);
 		int zi = PAD + (rgen.rand()%ysize);
 		float xp=xi, zp=zi, xf=0, zf=0, s=0, v=0, w=1, dx=0, dz=0;
@@ -152,7 +240,36 @@ void apply_erosion(float *heightmap, int xsize, int ysize, float min_zval, unsig
 			h=nh; h00=nh00; h10=nh10; h01=nh01; h11=nh11;
 		} // for numMoves
 		if (numMoves>=MAX_PATH_LEN) {cout << "droplet path is too long: " << iter << endl;}
-	} // for iter
+		mask.reset(dr.touched);
+#undef HMAP_INDEX
+#undef HMAP
+#undef DEPOSIT_AT
+#undef DEPOSIT
+#undef ERODE
+	};
+	for (unsigned batch_start = 0, batch_tag = 1; batch_start < num_iters; batch_start += batch_size, ++batch_tag) {
+		unsigned const batch_end(min(num_iters, batch_start + batch_size)), num_droplets(batch_end - batch_start);
+
+#pragma omp parallel for schedule(dynamic,1) if (num_droplets > 1)
+		for (int iter = batch_start; iter < (int)batch_end; ++iter) {
+			erosion_cell_mask_t &mask(masks[omp_get_thread_num_3dw()]);
+			simulate_droplet(iter, droplets[iter - batch_start], mask);
+		}
+		for (unsigned d = 0; d < num_droplets; ++d) { // commit in droplet order
+			erosion_droplet_t &dr(droplets[d]);
+			bool conflict(0);
+
+			for (unsigned ix : dr.touched) {
+				if (batch_written[ix] == batch_tag) {conflict = 1; break;} // written by an earlier droplet in this batch
+			}
+			if (conflict) {simulate_droplet((batch_start + d), dr, masks[0]); ++num_resim;} // redo against the current heights
+
+			for (auto const &e : dr.heights.get_entries()) {
+				mh_padded[e.ix]    = e.val;
+				batch_written[e.ix] = batch_tag;
+			}
+		} // for d
+	} // for batch_start
 
 	// remove padding and clamp to min_zval
 	for (int y = 0; y < ysize; ++y) {
@@ -160,6 +277,99 @@ void apply_erosion(float *heightmap, int xsize, int ysize, float min_zval, unsig
 			heightmap[y*xsize + x] = max(min_zval, mh_padded[(y+PAD)*NX + x+PAD]);
 		}
 	}
-	PRINT_TIME("Erosion");
+	if (print_time) {
+		PRINT_TIME("Erosion");
+		cout << "Erosion droplets: " << num_iters << ", simulated again due to overlap: " << num_resim << endl;
+	}
 }
 
+
+// erodes a heightmap that can be streamed in tiles so that only one tile plus its margin needs to be in float form at a time;
+// droplets are simulated over the tile + margin so that they can flow across tile boundaries, but only the tile interior is written back;
+// tiles are processed in raster order, and each tile reads the already eroded margins of the previous tiles;
+// each tile gets the droplets for its interior area only, so the total droplet count is num_iters
+void apply_erosion_tiled(erosion_tile_source_t &src, int xsize, int ysize, float min_zval, unsigned num_iters, unsigned tile_size, unsigned margin, bool print_time) {
+
+	if (num_iters == 0 || erode_amount <= 0.0) return; // erosion disabled
+	assert(tile_size > 0 && xsize > 0 && ysize > 0);
+	RESET_TIME;
+	double const iters_per_pixel(double(num_iters)/(double(xsize)*double(ysize))); // keep the same droplet density as a single pass
+	unsigned iter_offset(0), num_tiles(0);
+	vector<float> vals, interior;
+
+	for (int ty = 0; ty < ysize; ty += tile_size) {
+		for (int tx = 0; tx < xsize; tx += tile_size) {
+			int const x1(max(0, tx-(int)margin)), y1(max(0, ty-(int)margin)), x2(min(xsize, tx+int(tile_size+margin))), y2(min(ysize, ty+int(tile_size+margin)));
+			int const ix2(min(xsize, tx+(int)tile_size)), iy2(min(ysize, ty+(int)tile_size)), w(x2 - x1);
+			// round the running total rather than each tile so that the sum over all tiles is exactly num_iters
+			unsigned const iter_end(round_fp(iters_per_pixel*(double(ty)*xsize + double(iy2 - ty)*ix2))), tile_iters(iter_end - iter_offset);
+			vals.resize(w*(y2 - y1));
+			src.read_tile(x1, y1, x2, y2, vals.data());
+			apply_erosion(vals.data(), w, (y2 - y1), min_zval, tile_iters, iter_offset, 0); // print_time=0
+			iter_offset += tile_iters;
+			interior.clear();
+
+			for (int y = ty; y < iy2; ++y) {
+				float const *const row(vals.data() + (y - y1)*w);
+				interior.insert(interior.end(), (row + (tx - x1)), (row + (ix2 - x1)));
+			}
+			src.write_tile(tx, ty, ix2, iy2, interior.data());
+			++num_tiles;
+		} // for tx
+	} // for ty
+	if (print_time) {
+		PRINT_TIME("Tiled Erosion");
+		cout << "Eroded " << num_tiles << " tiles with " << iter_offset << " droplets" << endl;
+	}
+}
+
+
+class erosion_file_source_t : public erosion_tile_source_t { // raw row major float heights on disk
+
+	std::fstream &fs;
+	int width;
+public:
+	erosion_file_source_t(std::fstream &fs_, int width_) : fs(fs_), width(width_) {}
+
+	virtual void read_tile(int x1, int y1, int x2, int y2, float *vals) {
+		for (int y = y1; y < y2; ++y) {
+			fs.seekg(sizeof(float)*((size_t)y*width + x1));
+			fs.read((char *)(vals + (y - y1)*(x2 - x1)), sizeof(float)*(x2 - x1));
+		}
+		if (!fs.good()) {std::cerr << "Error reading erosion tile data" << endl; exit(1);}
+	}
+	virtual void write_tile(int x1, int y1, int x2, int y2, float const *vals) {
+		for (int y = y1; y < y2; ++y) {
+			fs.seekp(sizeof(float)*((size_t)y*width + x1));
+			fs.write((char const *)(vals + (y - y1)*(x2 - x1)), sizeof(float)*(x2 - x1));
+		}
+		if (!fs.good()) {std::cerr << "Error writing erosion tile data" << endl; exit(1);}
+	}
+};
+
+// generates terrain heights for mesh grid region [x0,x0+xsize)x[y0,y0+ysize) from the terrain height function (procedural noise or tiled terrain heightmap),
+// streams them to fn one row at a time, then erodes the file in place with apply_erosion_tiled(); memory use is bounded by one row plus one tile,
+// so the region can be much larger than what fits in memory; the output file contains raw float32 heights in row major order
+void erode_terrain_to_file(std::string const &fn, int x0, int y0, unsigned xsize, unsigned ysize, unsigned num_iters, unsigned tile_size) {
+
+	assert(xsize > 0 && ysize > 0);
+	timer_t timer("Erode Terrain to File");
+	std::fstream fs(fn.c_str(), (std::ios::in | std::ios::out | std::ios::binary | std::ios::trunc));
+	if (!fs.good()) {std::cerr << "Error opening terrain erosion output file " << fn << endl; return;}
+	vector<float> row(xsize);
+	float min_zval(FLT_MAX);
+
+	for (unsigned y = 0; y < ysize; ++y) {
+		float const yval(get_yval(y0 + (int)y));
+#pragma omp parallel for schedule(static,64)
+		for (int x = 0; x < (int)xsize; ++x) {row[x] = get_exact_zval(get_xval(x0 + x), yval);}
+		for (float z : row) {min_eq(min_zval, z);}
+		fs.write((char const *)row.data(), sizeof(float)*xsize);
+	}
+	if (!fs.good()) {std::cerr << "Error writing terrain erosion output file " << fn << endl; return;}
+	erosion_file_source_t src(fs, xsize);
+	apply_erosion_tiled(src, xsize, ysize, min_zval, num_iters, tile_size, max(16U, tile_size/4)); // margin = 1/4 tile size
+	cout << "Wrote " << xsize << "x" << ysize << " eroded terrain heights to " << fn << endl;
+}
+
+
@@ -7,8 +7,13 @@
 
 struct xform_matrix;
 struct cube_with_zval_t;
+struct erosion_tile_source_t;
 
 int omp_get_thread_num_3dw();
+int omp_get_max_threads_3dw();
+bool omp_in_parallel_3dw();
+void omp_set_nested_3dw(bool nested); // Note: these two only affect parallel regions started by the calling thread
+void omp_set_num_threads_3dw(int num);
 
 // function prototypes - main (3DWorld.cpp, etc.)
 bool get_gl_error(unsigned loc_id=0);
@@ -77,6 +82,8 @@ bool check_player_proximity(point const &pos, float radius=0.0, bool use_bottom=
 void set_global_state();
 void process_groups();
 void gen_scene(int generate_mesh, int gen_trees, int keep_sin_table, int update_zvals, int rgt_only);
+bool run_gen_benchmark(std::string const &fn);
+void run_gen_benchmark_headless(std::string const &fn);
 void write_def_coll_objects_file();
 void init_models();
 void free_models();
@@ -334,15 +341,19 @@ bool read_mesh(const char *filename, float zmm=0.0);
 bool write_mesh(const char *filename);
 bool load_state(const char *filename);
 bool save_state(const char *filename);
+void write_mesh_gen_params_key(std::ostream &out);
 
 // function prototypes - erosion
-void apply_erosion(float *heightmap, int xsize, int ysize, float min_zval, unsigned num_iters);
+void apply_erosion(float *heightmap, int xsize, int ysize, float min_zval, unsigned num_iters, unsigned rseed=0, bool print_time=1);
+void apply_erosion_tiled(erosion_tile_source_t &src, int xsize, int ysize, float min_zval, unsigned num_iters, unsigned tile_size, unsigned margin, bool print_time=1);
+void erode_terrain_to_file(std::string const &fn, int x0, int y0, unsigned xsize, unsigned ysize, unsigned num_iters, unsigned tile_size);
 
 // function prototypes - city_gen
 template<typename T> bool check_bcubes_sphere_coll(vector<T> const &bcubes, point const &sc, float radius, bool xy_only);
 bool is_night(float adj=0.0);
 bool parse_city_option(FILE *fp);
 bool have_cities();
+bool city_fits_in_heightmap(unsigned xsize, unsigned ysize);
 bool have_city_models();
 float get_road_max_len();
 float get_road_max_width();
@@ -352,7 +363,7 @@ void gen_city_details();
 void get_city_bcubes(vect_cube_t &bcubes);
 void get_city_road_bcubes(vect_cube_t &bcubes, bool connector_only);
 void get_city_plot_bcubes(vector<cube_with_zval_t> &bcubes);
-void next_city_frame(bool use_threads_2_3);
+void next_city_frame();
 void draw_cities(int shadow_only, int reflection_pass, int trans_op_mask, vector3d const &xlate);
 unsigned check_city_sphere_coll(point const &pos, float radius, bool exclude_bridges_and_tunnels, bool ret_first_coll=1, unsigned check_mask=3);
 void get_city_sphere_coll_cubes(point const &pos, float radius, bool include_intersections, bool xy_only, vect_cube_t &out, vect_cube_t *out_bt=nullptr);
@@ -596,6 +607,8 @@ unsigned get_loaded_textures_gpu_mem();
 int texture_lookup(std::string const &name);
 int get_texture_by_name(std::string const &name, bool is_normal_map=0, bool invert_y=0, int wrap_mir=1, float aniso=0.0);
 unsigned load_cube_map_texture(std::string const &name);
+unsigned long long hash_string_fnv1a(std::string const &str);
+unsigned long long hash_bytes_fnv1a(void const *data, size_t len, unsigned long long hash=14695981039346656037ULL);
 bool select_texture(int id);
 void update_player_bbb_texture(float extra_blood, bool recreate);
 float get_tex_ar(int id);
@@ -885,6 +898,7 @@ void check_all_platform_cobj_lighting_update();
 
 // function prototypes - voxels
 void gen_voxel_landscape();
+unsigned long long get_voxel_landscape_checksum(unsigned &num_verts);
 bool gen_voxels_from_cobjs(coll_obj_group &cobjs);
 float gen_voxel_rock(voxel_model &model, point const &center, float radius, unsigned size, unsigned num_blocks=1, int rseed=456);
 bool parse_voxel_option(FILE *fp);
@@ -895,7 +909,9 @@ float get_voxel_terrain_ao_lighting_val(point const &pos);
 bool update_voxel_sphere_region(point const &center, float radius, float val_at_center, int shooter, unsigned num_fragments=0);
 void proc_voxel_updates();
 bool check_voxel_coll_line(point const &p1, point const &p2, point &cpos, vector3d &cnorm, int &cindex, int ignore_cobj, bool exact);
+bool check_voxel_coll_line_no_cobj(point const &p1, point const &p2, point &cpos, vector3d &cnorm);
 void get_voxel_coll_sphere_cobjs(point const &center, float radius, int ignore_cobj, vert_coll_detector &vcd);
+bool check_voxel_sphere_coll_field(point &pos, float radius, vector3d &cnorm, float &elastic);
 bool write_voxel_brushes();
 void change_voxel_editing_mode(int val);
 void undo_voxel_brush();
@@ -993,6 +1009,7 @@ void setup_shader_cube_map_params(shader_t &shader, cube_t const &bcube, unsigne
 // function prototypes - gen_buildings
 bool parse_buildings_option(FILE *fp);
 void gen_buildings();
+unsigned long long get_buildings_checksum(unsigned &num_buildings);
 void draw_buildings(int shadow_only, vector3d const &xlate);
 void draw_building_lights(vector3d const &xlate);
 void set_buildings_pos_range(cube_t const &pos_range);
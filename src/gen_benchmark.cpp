@@ -0,0 +1,220 @@
+// 3D World - Scene generation benchmark: times the procedural generation stages with fixed seeds and writes the results as JSON
+// by Frank Gennari
+// 10/18/26
+
+#include "mesh.h"
+#include "function_registry.h"
+#include "buildings.h" // for cube_with_zval_t
+#include <fstream>
+#include <iomanip>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#elif defined(__APPLE__)
+#include <sys/resource.h>
+#include <mach/mach.h>
+#else
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+unsigned const BENCH_RAND_SEED     = 12345;
+unsigned const BENCH_EROSION_ITERS = 5000; // used when erosion_iters is zero
+
+extern int world_mode, universe_only, mesh_gen_mode;
+extern unsigned create_voxel_landscape, erosion_iters;
+extern float zbottom;
+
+void reset_planet_defaults();
+
+
+unsigned long long get_peak_rss_bytes() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return 0;
+	return pmc.PeakWorkingSetSize;
+#else
+	struct rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+	return usage.ru_maxrss; // in bytes
+#else
+	return 1024ULL*usage.ru_maxrss; // in KB
+#endif
+#endif
+}
+
+unsigned long long get_cur_rss_bytes() {
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS pmc;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return 0;
+	return pmc.WorkingSetSize;
+#elif defined(__APPLE__)
+	mach_task_basic_info info;
+	mach_msg_type_number_t count(MACH_TASK_BASIC_INFO_COUNT);
+	if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS) return 0;
+	return info.resident_size;
+#else
+	std::ifstream in("/proc/self/statm"); // total program size followed by resident set size, in pages
+	unsigned long long size(0), resident(0);
+	if (!(in >> size >> resident)) return 0;
+	return resident*sysconf(_SC_PAGESIZE);
+#endif
+}
+
+struct bench_stage_t {
+	std::string name, note;
+	int time_ms;
+	unsigned count;
+	unsigned long long checksum, rss_before, rss_after;
+	bool ran;
+	bench_stage_t(std::string const &name_, std::string const &note_=std::string()) :
+		name(name_), note(note_), time_ms(0), count(0), checksum(0), rss_before(0), rss_after(0), ran(0) {}
+	long long get_rss_delta() const {return ((long long)rss_after - (long long)rss_before);} // may be negative if memory was freed
+};
+
+class gen_benchmark_t {
+	vector<bench_stage_t> stages;
+	int stage_start_time;
+	unsigned long long stage_start_rss;
+
+	void start_stage() {
+		srand(BENCH_RAND_SEED); // reset all random state so that each stage is reproducible on its own
+		set_rand2_state(BENCH_RAND_SEED, BENCH_RAND_SEED+1);
+		stage_start_rss  = get_cur_rss_bytes();
+		stage_start_time = GET_TIME_MS();
+	}
+	void end_stage(std::string const &name, unsigned count, unsigned long long checksum) {
+		int const time_ms(GET_TIME_MS() - stage_start_time);
+		stages.push_back(bench_stage_t(name));
+		bench_stage_t &s(stages.back());
+		s.time_ms    = time_ms;
+		s.count      = count;
+		s.checksum   = checksum;
+		s.rss_before = stage_start_rss;
+		s.rss_after  = get_cur_rss_bytes();
+		s.ran        = 1;
+		cout << "Benchmark stage " << name << ": " << s.time_ms << "ms, RSS delta " << s.get_rss_delta()/1024 << "KB, checksum "
+			 << std::hex << checksum << std::dec << endl;
+	}
+	void skip_stage(std::string const &name, std::string const &reason) {stages.push_back(bench_stage_t(name, reason));}
+
+	static unsigned long long get_mesh_checksum(float const *const heights, unsigned num) {return hash_bytes_fnv1a(heights, num*sizeof(float));}
+
+	static unsigned long long get_cities_checksum(unsigned long long hash, unsigned &num_roads) {
+		vect_cube_t city_bcubes, road_bcubes;
+		vect_cube_with_zval_t plot_bcubes;
+		get_city_bcubes(city_bcubes);
+		get_city_road_bcubes(road_bcubes, 0); // connector_only=0
+		get_city_plot_bcubes(plot_bcubes);
+		num_roads = road_bcubes.size();
+		if (!city_bcubes.empty()) {hash = hash_bytes_fnv1a(city_bcubes.data(), city_bcubes.size()*sizeof(cube_t), hash);}
+		if (!road_bcubes.empty()) {hash = hash_bytes_fnv1a(road_bcubes.data(), road_bcubes.size()*sizeof(cube_t), hash);}
+		if (!plot_bcubes.empty()) {hash = hash_bytes_fnv1a(plot_bcubes.data(), plot_bcubes.size()*sizeof(cube_with_zval_t), hash);}
+		return hash;
+	}
+public:
+	gen_benchmark_t() : stage_start_time(0), stage_start_rss(0) {}
+
+	void run() {
+		bool const inf_terrain(world_mode == WMODE_INF_TERRAIN);
+		unsigned const num_mesh(XY_MULT_SIZE);
+		start_stage();
+		gen_mesh(0, 0, 0); // includes erosion if erosion_iters is nonzero
+		end_stage("gen_mesh", num_mesh, get_mesh_checksum(mesh_height[0], num_mesh));
+		// erode a copy so that later stages see the same mesh as the interactive path
+		vector<float> heights(mesh_height[0], mesh_height[0]+num_mesh);
+		unsigned const num_iters(erosion_iters ? erosion_iters : BENCH_EROSION_ITERS);
+		start_stage();
+		apply_erosion(heights.data(), MESH_X_SIZE, MESH_Y_SIZE, zbottom, num_iters, BENCH_RAND_SEED, 0); // print_time=0
+		end_stage("erosion", num_iters, get_mesh_checksum(heights.data(), num_mesh));
+
+		if (inf_terrain) {skip_stage("voxel_landscape", "not used in tiled terrain mode");}
+		else if (create_voxel_landscape != 1) {skip_stage("voxel_landscape", "create_voxel_landscape is not enabled");}
+		else {
+			start_stage();
+			gen_voxel_landscape();
+			unsigned num_verts(0);
+			unsigned long long const checksum(get_voxel_landscape_checksum(num_verts));
+			end_stage("voxel_landscape", num_verts, checksum);
+		}
+		if (inf_terrain) {skip_stage("buildings", "generated per tile in tiled terrain mode");}
+		else {
+			start_stage();
+			gen_buildings();
+			unsigned num_buildings(0);
+			unsigned long long const checksum(get_buildings_checksum(num_buildings));
+			end_stage("buildings", num_buildings, checksum);
+		}
+		// cities are normally placed on the tiled terrain heightmap; here they're placed on a copy of the eroded mesh instead, which is always available;
+		// this runs after buildings because it clips the building placement range to the city bounds
+		if (!have_cities()) {skip_stage("cities", "cities are not enabled");}
+		else if (!city_fits_in_heightmap(MESH_X_SIZE, MESH_Y_SIZE)) {skip_stage("cities", "mesh is too small for city_size_max and city_border");}
+		else {
+			start_stage();
+			gen_cities(heights.data(), MESH_X_SIZE, MESH_Y_SIZE); // flattens the heightmap under cities and roads
+			unsigned num_roads(0);
+			unsigned long long const checksum(get_cities_checksum(get_mesh_checksum(heights.data(), num_mesh), num_roads));
+			end_stage("cities", num_roads, checksum);
+		}
+	}
+	bool write_json(std::string const &fn) const {
+		std::ofstream out(fn);
+
+		if (!out.good()) {
+			std::cerr << "Error: Failed to open generation benchmark output file " << fn << endl;
+			return 0;
+		}
+		int total_ms(0);
+		for (auto s = stages.begin(); s != stages.end(); ++s) {total_ms += s->time_ms;}
+		out << "{\n  \"seed\": " << BENCH_RAND_SEED << ",\n  \"mesh_size\": [" << MESH_X_SIZE << ", " << MESH_Y_SIZE << "],\n  \"mesh_gen_mode\": " << mesh_gen_mode << ",\n";
+		out << "  \"total_ms\": " << total_ms << ",\n  \"peak_rss_bytes\": " << get_peak_rss_bytes() << ",\n  \"stages\": [\n";
+
+		for (auto s = stages.begin(); s != stages.end(); ++s) {
+			out << "    {\"name\": \"" << s->name << "\", ";
+			if (!s->ran) {out << "\"skipped\": true, \"reason\": \"" << s->note << "\"}";}
+			else {
+				out << "\"time_ms\": " << s->time_ms << ", \"count\": " << s->count << ", \"checksum\": \"" << std::hex << std::setw(16) << std::setfill('0')
+					<< s->checksum << std::dec << std::setfill(' ') << "\", \"rss_before_bytes\": " << s->rss_before << ", \"rss_after_bytes\": " << s->rss_after
+					<< ", \"rss_delta_bytes\": " << s->get_rss_delta() << "}";
+			}
+			out << (((s+1) == stages.end()) ? "\n" : ",\n");
+		}
+		out << "  ]\n}\n";
+		return out.good();
+	}
+};
+
+
+// runs the main procedural generation stages with fixed random seeds and writes timing, memory, and checksums to fn;
+// checksums should match across runs and thread counts, so this can be used to detect both performance and determinism regressions
+bool run_gen_benchmark(std::string const &fn) {
+	cout << "Running scene generation benchmark" << endl;
+	gen_benchmark_t benchmark;
+	benchmark.run();
+	bool const ret(benchmark.write_json(fn));
+	if (ret) {cout << "Wrote generation benchmark results to " << fn << endl;}
+	return ret;
+}
+
+// called from main() after the config files are read and before GLUT is initialized; never creates a window or GL context, and doesn't return;
+// only the CPU state that the generation stages depend on is set up here, and textures are registered by name but never loaded
+void run_gen_benchmark_headless(std::string const &fn) {
+	if (universe_only) {
+		std::cerr << "Error: The generation benchmark isn't supported in universe_only mode" << endl;
+		exit(1);
+	}
+	if (mesh_gen_mode >= MGEN_SIMPLEX_GPU) { // no GL context for the compute shader, so checksums won't match GL runs
+		cout << "Using CPU simplex noise in place of GPU mesh_gen_mode " << mesh_gen_mode << " for the headless generation benchmark" << endl;
+		mesh_gen_mode = MGEN_SIMPLEX;
+	}
+	reset_planet_defaults();
+	init_objects();
+	alloc_matrices();
+	init_terrain_mesh();
+	bool const ret(run_gen_benchmark(fn));
+	delete_matrices();
+	exit(ret ? 0 : 1);
+}
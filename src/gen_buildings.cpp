@@ -20,12 +20,13 @@ bool const ADD_ROOM_LIGHTS       = 1;
 bool const DRAW_INTERIOR_DOORS   = 1;
 bool const LINEAR_ROOM_DLIGHT_ATTEN = 1;
 float const WIND_LIGHT_ON_RAND   = 0.08;
+unsigned const MIN_TILE_BUILDINGS_FOR_THREADS = 16; // generate tile building geometry in parallel when there are at least this many buildings
 
 bool camera_in_building(0), interior_shadow_maps(0);
 building_params_t global_building_params;
 
 extern bool start_in_inf_terrain, draw_building_interiors, flashlight_on, enable_use_temp_vbo, toggle_room_light;
-extern int rand_gen_index, display_mode, window_width, window_height, camera_surf_collide, animate2;
+extern int rand_gen_index, display_mode, window_width, window_height, camera_surf_collide, animate2, frame_counter;
 extern float CAMERA_RADIUS, city_dlight_pcf_offset_scale;
 extern double camera_zh;
 extern point sun_pos, pre_smap_player_pos;
@@ -34,6 +35,7 @@ extern tree_placer_t tree_placer;
 
 
 void get_all_model_bcubes(vector<cube_t> &bcubes); // from model3d.h
+void ensure_building_obj_models_loaded();
 
 float get_door_open_dist() {return 3.5*CAMERA_RADIUS;}
 
@@ -180,6 +182,9 @@ bool parse_buildings_option(FILE *fp) {
 	else if (str == "max_shadow_maps") {
 		if (!read_uint(fp, global_building_params.max_shadow_maps)) {buildings_file_err(str, error);}
 	}
+	else if (str == "max_room_geom_mem_mb") {
+		if (!read_uint(fp, global_building_params.max_room_geom_mem_mb)) {buildings_file_err(str, error);}
+	}
 	else if (str == "ao_factor") {
 		if (!read_zero_one_float(fp, global_building_params.ao_factor)) {buildings_file_err(str, error);}
 	}
@@ -1707,6 +1712,7 @@ class building_creator_t {
 	building_draw_t building_draw, building_draw_vbo, building_draw_windows, building_draw_wind_lights, building_draw_interior;
 	point_sprite_drawer_sized building_lights;
 	vector<point> points; // reused temporary
+	mutable vector<vector<point>> ped_coll_points; // per-thread reused temporaries for pedestrian queries, which may be run in parallel
 	bool use_smap_this_frame;
 
 	struct grid_elem_t {
@@ -1870,6 +1876,13 @@ public:
 		gpu_mem_usage = 0;
 	}
 	unsigned get_num_buildings() const {return buildings.size();}
+	unsigned long long get_checksum(unsigned long long hash) const { // hash of building placement and parts, for determinism checks
+		for (auto b = buildings.begin(); b != buildings.end(); ++b) {
+			hash = hash_bytes_fnv1a(&b->bcube, sizeof(cube_t), hash);
+			if (!b->parts.empty()) {hash = hash_bytes_fnv1a(b->parts.data(), b->parts.size()*sizeof(cube_t), hash);}
+		}
+		return hash;
+	}
 	unsigned get_gpu_mem_usage() const {return gpu_mem_usage;}
 	vector3d const &get_max_extent() const {return max_extent;}
 	building_t const &get_building(unsigned ix) const {assert(ix < buildings.size()); return buildings[ix];}
@@ -2019,6 +2032,7 @@ public:
 		if (buildings.capacity() > 2*buildings.size()) {buildings.shrink_to_fit();}
 		bix_by_x1 cmp_x1(buildings);
 		for (auto i = bix_by_plot.begin(); i != bix_by_plot.end(); ++i) {sort(i->begin(), i->end(), cmp_x1);}
+		ped_coll_points.resize(omp_get_max_threads_3dw()); // not resized later because queries may be run from parallel ped updates
 		if (!is_tile) {timer.end();} // use a single timer for tile mode
 
 		if (params.flatten_mesh && !use_city_plots) { // not needed for city plots, which are already flat
@@ -2066,7 +2080,8 @@ public:
 		} // if flatten_mesh
 		{ // open a scope
 			timer_t timer2("Gen Building Geometry", !is_tile);
-#pragma omp parallel for schedule(static,1) if (!is_tile)
+			// each building has its own rand seed, so the results don't depend on thread count or scheduling
+#pragma omp parallel for schedule(dynamic,1) if (!is_tile || buildings.size() >= MIN_TILE_BUILDINGS_FOR_THREADS)
 			for (int i = 0; i < (int)buildings.size(); ++i) {buildings[i].gen_geometry(i, 1337*i+rseed);}
 		} // close the scope
 		if (0 && non_city_only) { // perform room graph analysis
@@ -2321,6 +2336,113 @@ public:
 	static void enable_linear_dlights(shader_t &s) { // to be called before begin_shader()
 		if (LINEAR_ROOM_DLIGHT_ATTEN) {s.set_prefix("#define LINEAR_DLIGHT_ATTEN", 1);} // FS; improves room lighting (better light distribution vs. framerate trade-off)
 	}
+	// if there are no windows, we can wait until the player is very close to draw the interior
+	float get_interior_ddist_scale() const {return (building_draw_windows.empty() ? 0.05 : 1.0);}
+
+	// visibility tests shared by the room geom pre-pass and the interior draw loop in multi_draw(), so that they agree on which buildings are drawn
+	static bool is_tile_visible(cube_t const &tile_bcube, vector3d const &xlate, occlusion_zbuffer_t const *occluders) {
+		if (!camera_pdu.sphere_and_cube_visible_test((tile_bcube.get_cube_center() + xlate), tile_bcube.get_bsphere_radius(), (tile_bcube + xlate))) return 0; // VFC
+		return !(occluders && occluders->cube_occluded(tile_bcube + xlate)); // occlusion culling
+	}
+	// camera_near_building is only set if the building passes the distance and VFC tests
+	static bool should_draw_room_geom(building_t const &b, point const &camera_xlated, vector3d const &xlate, float room_geom_dist, float door_open_dist,
+		occlusion_zbuffer_t const *occluders, bool &camera_near_building)
+	{
+		if (!b.interior) return 0; // no interior, skip
+		if (!b.bcube.closest_dist_less_than(camera_xlated, room_geom_dist)) return 0; // too far away
+		if (!camera_pdu.cube_visible(b.bcube + xlate)) return 0; // VFC
+		camera_near_building = b.bcube.contains_pt_xy_exp(camera_xlated, door_open_dist);
+		return (camera_near_building || !occluders || !occluders->cube_occluded(b.bcube + xlate)); // occlusion culling
+	}
+	// generates room geom in parallel for buildings that will have their room geom drawn below in multi_draw() this frame
+	static void gen_room_geom_for_visible_buildings(vector<building_creator_t *> const &bcs, vector3d const &xlate, float room_geom_draw_dist,
+		occlusion_zbuffer_t const *occluders)
+	{
+		point const camera_xlated(get_camera_pos() - xlate);
+		float const door_open_dist(get_door_open_dist());
+		vector<pair<building_creator_t *, unsigned>> to_gen; // {creator, building index}
+
+		for (auto i = bcs.begin(); i != bcs.end(); ++i) {
+			float const room_geom_dist((*i)->get_interior_ddist_scale()*room_geom_draw_dist);
+
+			for (auto g = (*i)->grid_by_tile.begin(); g != (*i)->grid_by_tile.end(); ++g) {
+				if (!g->bcube.closest_dist_less_than(camera_xlated, room_geom_dist)) continue; // too far; room_geom_draw_dist < interior_draw_dist
+				if (!is_tile_visible(g->bcube, xlate, occluders)) continue;
+
+				for (auto bi = g->bc_ixs.begin(); bi != g->bc_ixs.end(); ++bi) {
+					building_t const &b((*i)->get_building(bi->ix));
+					if (b.is_rotated() || b.has_room_geom()) continue; // not supported or already generated
+					bool camera_near_building(0); // unused
+					if (should_draw_room_geom(b, camera_xlated, xlate, room_geom_dist, door_open_dist, occluders, camera_near_building)) {to_gen.emplace_back(*i, bi->ix);}
+				}
+			} // for g
+		} // for i
+		if (to_gen.empty()) return;
+		ensure_building_obj_models_loaded();
+
+#pragma omp parallel for schedule(dynamic,1) if (to_gen.size() > 1)
+		for (int n = 0; n < (int)to_gen.size(); ++n) {
+			building_creator_t &bc(*to_gen[n].first);
+			unsigned const bix(to_gen[n].second);
+			vect_cube_t ped_bcubes;
+			bc.get_building(bix).gen_room_geom_if_needed(ped_bcubes, bix, bc.get_ped_ix_for_bix(bix));
+		}
+	}
+	// frees the room geom vertex data of the least recently visited buildings until the total is under the memory limit, where a building counts as visited
+	// on any frame the camera is within room_geom_draw_dist of it, whether or not it's in view; buildings within that distance are never freed;
+	// room objects are kept so that interaction state such as toggled lights and moved or taken objects isn't lost, and the vertex data is recreated from them
+	// in building_room_geom_t::draw() when the building is drawn again; the objects themselves are only freed by the existing clear of grids beyond
+	// interior_draw_dist, which bounds their memory (and does lose that state, as it always has)
+	static void evict_lru_room_geom(vector<building_creator_t *> const &bcs, vector3d const &xlate, float room_geom_draw_dist) {
+		struct rgeom_use_t {
+			unsigned last_frame;
+			float dist_sq;
+			size_t mem;
+			building_room_geom_t *rgeom;
+			rgeom_use_t(unsigned f, float d, size_t m, building_room_geom_t *r) : last_frame(f), dist_sq(d), mem(m), rgeom(r) {}
+			bool operator<(rgeom_use_t const &u) const {return ((last_frame == u.last_frame) ? (dist_sq > u.dist_sq) : (last_frame < u.last_frame));} // LRU, then farthest
+		};
+		size_t const max_mem(size_t(global_building_params.max_room_geom_mem_mb) << 20);
+		if (max_mem == 0) return; // no limit
+		point const camera_xlated(get_camera_pos() - xlate);
+		size_t tot_mem(0);
+		vector<rgeom_use_t> cands;
+
+		for (auto i = bcs.begin(); i != bcs.end(); ++i) {
+			for (auto g = (*i)->grid_by_tile.begin(); g != (*i)->grid_by_tile.end(); ++g) {
+				if (!g->has_room_geom) continue; // Note: grids that are too far have already been cleared
+
+				for (auto bi = g->bc_ixs.begin(); bi != g->bc_ixs.end(); ++bi) {
+					building_t const &b((*i)->get_building(bi->ix));
+					if (!b.has_room_geom()) continue;
+					building_room_geom_t &rgeom(*b.interior->room_geom);
+					tot_mem += rgeom.get_mem_usage();
+					if (b.bcube.closest_dist_less_than(camera_xlated, room_geom_draw_dist)) {rgeom.last_near_frame = frame_counter; continue;} // nearby, keep
+					size_t const vert_mem(rgeom.get_vert_mem_usage());
+					if (vert_mem > 0) {cands.emplace_back(rgeom.last_near_frame, p2p_dist_sq(camera_xlated, b.bcube.get_cube_center()), vert_mem, &rgeom);}
+				}
+			} // for g
+		} // for i
+		if (tot_mem <= max_mem) return; // under the limit
+		sort(cands.begin(), cands.end()); // least recently visited first
+
+		for (auto c = cands.begin(); c != cands.end() && tot_mem > max_mem; ++c) {
+			c->rgeom->clear_materials();
+			tot_mem -= c->mem;
+		}
+	}
+	// returns a zbuffer of the simple building exteriors within dist of the camera for occlusion culling this frame's building draws, or null if not enabled;
+	// skipped when the player is in a building, since exteriors aren't opaque when seen from the inside through windows
+	static occlusion_zbuffer_t const *get_draw_occluders(vector<building_creator_t *> const &bcs, vector3d const &xlate, float dist) {
+		static building_occlusion_state_t state; // reused across frames so that the zbuffer's rays are only recomputed when the camera rotates
+		if (!(display_mode & 0x08) || camera_in_building) return nullptr;
+		pos_dir_up near_pdu(camera_pdu);
+		near_pdu.far_ = dist;
+		state.init(near_pdu, xlate);
+		for (auto i = bcs.begin(); i != bcs.end(); ++i) {(*i)->add_occluders(near_pdu, state, 0);} // add_line_test_ids=0; line tests are per-creator
+		state.zbuf.finalize();
+		return (state.zbuf.empty() ? nullptr : &state.zbuf);
+	}
 	static void multi_draw(int shadow_only, vector3d const &xlate, vector<building_creator_t *> const &bcs) {
 		if (bcs.empty()) return;
 
@@ -2368,6 +2490,8 @@ public:
 		vector<vertex_range_t> per_bcs_exclude;
 		cube_t const lights_bcube(building_lights_manager.get_lights_bcube());
 		int const interior_use_smaps((ADD_ROOM_SHADOWS && ADD_ROOM_LIGHTS) ? 2 : 1); // dynamic light smaps only
+		// Note: a tile or building bcube contains its own exterior, so it can never be occluded by itself
+		occlusion_zbuffer_t const *const occluders(get_draw_occluders(bcs, xlate, 0.4f*(X_SCENE_SIZE + Y_SCENE_SIZE)));
 
 		// draw building interiors with standard shader and no shadow maps; must be drawn first before windows depth pass
 		if (have_interior) {
@@ -2406,6 +2530,7 @@ public:
 			vector<point> points; // reused temporary
 			vect_cube_t ped_bcubes; // reused temporary
 			int indir_bcs_ix(-1), indir_bix(-1);
+			gen_room_geom_for_visible_buildings(bcs, xlate, room_geom_draw_dist, occluders);
 
 			if (draw_interior) {
 				per_bcs_exclude.resize(bcs.size());
@@ -2415,7 +2540,7 @@ public:
 			for (auto i = bcs.begin(); i != bcs.end(); ++i) { // draw only nearby interiors
 				unsigned const bcs_ix(i - bcs.begin());
 				float const door_open_dist(get_door_open_dist());
-				float const ddist_scale((*i)->building_draw_windows.empty() ? 0.05 : 1.0); // if there are no windows, we can wait until the player is very close to draw the interior
+				float const ddist_scale((*i)->get_interior_ddist_scale()), room_geom_dist(ddist_scale*room_geom_draw_dist);
 
 				for (auto g = (*i)->grid_by_tile.begin(); g != (*i)->grid_by_tile.end(); ++g) { // Note: all grids should be nonempty
 					if (!g->bcube.closest_dist_less_than(camera_xlated, ddist_scale*interior_draw_dist)) { // too far
@@ -2425,18 +2550,16 @@ public:
 						}
 						continue;
 					}
-					if (!camera_pdu.sphere_and_cube_visible_test((g->bcube.get_cube_center() + xlate), g->bcube.get_bsphere_radius(), (g->bcube + xlate))) continue; // VFC
+					if (!is_tile_visible(g->bcube, xlate, occluders)) continue; // room geom isn't cleared, since it may soon be visible
 					(*i)->building_draw_interior.draw_tile(s, (g - (*i)->grid_by_tile.begin()));
 					// iterate over nearby buildings in this tile and draw interior room geom, generating it if needed
-					if (!g->bcube.closest_dist_less_than(camera_xlated, ddist_scale*room_geom_draw_dist)) continue; // too far
+					if (!g->bcube.closest_dist_less_than(camera_xlated, room_geom_dist)) continue; // too far
 					
 					for (auto bi = g->bc_ixs.begin(); bi != g->bc_ixs.end(); ++bi) {
 						building_t &b((*i)->get_building(bi->ix));
-						if (!b.interior) continue; // no interior, skip
-						if (!b.bcube.closest_dist_less_than(camera_xlated, ddist_scale*room_geom_draw_dist)) continue; // too far away
-						if (!camera_pdu.cube_visible(b.bcube + xlate)) continue; // VFC
+						bool camera_near_building(0);
+						if (!should_draw_room_geom(b, camera_xlated, xlate, room_geom_dist, door_open_dist, occluders, camera_near_building)) continue;
 						int const ped_ix((*i)->get_ped_ix_for_bix(bi->ix)); // Note: assumes only one building_draw has people
-						bool const camera_near_building(b.bcube.contains_pt_xy_exp(camera_xlated, door_open_dist));
 						bool const inc_small(b.bcube.closest_dist_less_than(camera_xlated, ddist_scale*room_geom_sm_draw_dist));
 						b.gen_and_draw_room_geom(s, xlate, ped_bcubes, bi->ix, ped_ix, 0, inc_small, b.bcube.contains_pt_xy(camera_xlated)); // shadow_only=0
 						g->has_room_geom = 1;
@@ -2477,6 +2600,7 @@ public:
 					} // for bi
 				} // for g
 			} // for i
+			evict_lru_room_geom(bcs, xlate, room_geom_draw_dist);
 			if (ADD_ROOM_LIGHTS) {glDepthFunc(GL_LESS);} // restore
 			glDisable(GL_CULL_FACE);
 			camera_in_building = this_frame_camera_in_building; // update once; non-interior buildings (such as city buildings) won't update this
@@ -2628,6 +2752,7 @@ public:
 					if (!g->bcube.closest_dist_less_than(camera_xlated, draw_dist)) continue; // too far
 					point const pos(g->bcube.get_cube_center() + xlate);
 					if (!camera_pdu.sphere_and_cube_visible_test(pos, g->bcube.get_bsphere_radius(), (g->bcube + xlate))) continue; // VFC
+					if (occluders && occluders->cube_occluded(g->bcube + xlate)) continue; // occlusion culling
 					if (!try_bind_tile_smap_at_point(pos, s)) continue; // no shadow maps - not drawn in this pass
 					unsigned const tile_id(g - (*i)->grid_by_tile.begin());
 					(*i)->building_draw_vbo.draw_tile(s, tile_id);
@@ -2906,20 +3031,23 @@ public:
 		return coll; // 0=none, 1=side, 2=roof, 3=details
 	}
 
+	vector<point> &get_ped_coll_points() const { // for the calling thread; the team of a nested region is no larger than the max threads at gen() time
+		unsigned const tid(omp_get_thread_num_3dw());
+		assert(tid < ped_coll_points.size());
+		return ped_coll_points[tid];
+	}
 	// Note: we can get building_id by calling check_ped_coll() or get_building_bcube_at_pos()
-	bool check_line_coll_building(point const &p1, point const &p2, unsigned building_id) const { // Note: not thread safe due to static points
+	bool check_line_coll_building(point const &p1, point const &p2, unsigned building_id) const {
 		assert(building_id < buildings.size());
-		static vector<point> points; // reused across calls
 		float t_new(1.0);
-		return buildings[building_id].check_line_coll(p1, p2, zero_vector, t_new, points, 0, 1);
+		return buildings[building_id].check_line_coll(p1, p2, zero_vector, t_new, get_ped_coll_points(), 0, 1);
 	}
 
-	int get_building_bcube_contains_pos(point const &pos) { // Note: not thread safe due to static points
+	int get_building_bcube_contains_pos(point const &pos) {
 		if (empty()) return -1;
 		unsigned const gix(get_grid_ix(pos));
 		grid_elem_t const &ge(grid[gix]);
 		if (ge.bc_ixs.empty() || !ge.bcube.contains_pt(pos)) return -1; // skip empty or non-containing grid
-		static vector<point> points; // reused across calls
 
 		for (auto b = ge.bc_ixs.begin(); b != ge.bc_ixs.end(); ++b) {
 			if (b->contains_pt(pos)) {return b->ix;} // found
@@ -2927,13 +3055,13 @@ public:
 		return -1;
 	}
 
-	bool check_ped_coll(point const &pos, float radius, unsigned plot_id, unsigned &building_id) const { // Note: not thread safe due to static points
+	bool check_ped_coll(point const &pos, float radius, unsigned plot_id, unsigned &building_id) const {
 		if (empty()) return 0;
 		assert(plot_id < bix_by_plot.size());
 		vector<unsigned> const &bixes(bix_by_plot[plot_id]); // should be populated in gen()
 		if (bixes.empty()) return 0;
 		cube_t bcube; bcube.set_from_sphere(pos, radius);
-		static vector<point> points; // reused across calls
+		vector<point> &points(get_ped_coll_points());
 
 		// Note: assumes buildings are separated so that only one ped collision can occur
 		for (auto b = bixes.begin(); b != bixes.end(); ++b) {
@@ -2974,19 +3102,31 @@ public:
 	}
 
 	void get_occluders(pos_dir_up const &pdu, building_occlusion_state_t &state) const {
-		state.init(pdu.pos, get_camera_coord_space_xlate());
-		
+		state.init(pdu, get_camera_coord_space_xlate());
+		add_occluders(pdu, state, 1); // add_line_test_ids=1
+		state.zbuf.finalize();
+	}
+	// Note: building_ids index into this building_creator, so add_line_test_ids should only be set when the state is used with this creator's check_pts_occluded()
+	void add_occluders(pos_dir_up const &pdu, building_occlusion_state_t &state, bool add_line_test_ids) const {
 		for (auto g = grid.begin(); g != grid.end(); ++g) {
 			if (g->bc_ixs.empty()) continue;
 			point const pos(g->bcube.get_cube_center() + state.xlate);
 			if (!pdu.sphere_and_cube_visible_test(pos, g->bcube.get_bsphere_radius(), (g->bcube + state.xlate))) continue; // VFC
 			
 			for (auto b = g->bc_ixs.begin(); b != g->bc_ixs.end(); ++b) {
-				if (pdu.cube_visible(*b + state.xlate)) {state.building_ids.push_back(b->ix);}
+				if (!pdu.cube_visible(*b + state.xlate)) continue; // VFC
+				building_t const &building(get_building(b->ix));
+
+				if (building.is_simple_cube() && !building.is_rotated()) { // exterior is exactly the union of the parts, so they can be drawn into the zbuffer
+					for (auto p = building.parts.begin(); p != building.get_real_parts_end(); ++p) {state.zbuf.add_occluder(*p + state.xlate);}
+				}
+				else if (add_line_test_ids) {state.building_ids.push_back(b->ix);} // use line tests for other shapes
 			}
 		}
 	}
 	bool check_pts_occluded(point const *const pts, unsigned npts, building_occlusion_state_t &state) const {
+		if (state.zbuf.pts_occluded(pts, npts)) return 1;
+
 		for (vector<unsigned>::const_iterator b = state.building_ids.begin(); b != state.building_ids.end(); ++b) {
 			building_t const &building(get_building(*b));
 			bool occluded(1);
@@ -3007,6 +3147,52 @@ class building_tiles_t {
 	map<xy_pair, building_creator_t> tiles; // key is {x, y} pair
 	//set<xy_pair> generated; // only used in heightmap terrain mode, and generally limited to the size of the heightmap in tiles
 	vector3d max_extent;
+
+	static int get_tile_ix(float v, unsigned d) {return round_fp(0.5f*v/(d ? Y_SCENE_SIZE : X_SCENE_SIZE));} // v is in building space
+	static float get_tile_lo(int ix, unsigned d) {return (2*ix - 1)*(d ? Y_SCENE_SIZE : X_SCENE_SIZE);}
+
+	// calls f() on tiles whose buildings may overlap c (in building space) until f() returns true; the tile range is expanded by the max building size
+	// in case buildings extend outside their tile; tiles are looked up by index unless the range contains more tiles than are loaded
+	template<typename F> bool any_tile_in_range(cube_t const &c, F const &f) const {
+		int ixr[2][2];
+		for (unsigned d = 0; d < 2; ++d) {ixr[0][d] = get_tile_ix(c.d[d][0] - max_extent[d], d); ixr[1][d] = get_tile_ix(c.d[d][1] + max_extent[d], d);}
+		uint64_t const num((uint64_t)(ixr[1][0] - ixr[0][0] + 1)*(ixr[1][1] - ixr[0][1] + 1));
+
+		if (num > tiles.size()) { // large query, iterate over all tiles
+			for (auto i = tiles.begin(); i != tiles.end(); ++i) {
+				if (i->second.get_bcube().intersects_xy(c) && f(i->second)) return 1;
+			}
+			return 0;
+		}
+		for (int x = ixr[0][0]; x <= ixr[1][0]; ++x) { // same order as iteration over tiles
+			for (int y = ixr[0][1]; y <= ixr[1][1]; ++y) {
+				auto it(tiles.find(make_pair(x, y)));
+				if (it != tiles.end() && it->second.get_bcube().intersects_xy(c) && f(it->second)) return 1;
+			}
+		}
+		return 0;
+	}
+	// same as above, but only visits tiles near the line (p1, p2) so that the number of lookups is proportional to the line length
+	template<typename F> bool any_tile_on_line(point const &p1, point const &p2, F const &f) const {
+		cube_t const line_bcube(p1, p2);
+		int const x1(get_tile_ix(line_bcube.x1() - max_extent.x, 0)), x2(get_tile_ix(line_bcube.x2() + max_extent.x, 0));
+		int const ny(get_tile_ix(line_bcube.y2(), 1) - get_tile_ix(line_bcube.y1(), 1) + 1);
+		if (p1.x == p2.x || 3U*unsigned(x2 - x1 + 1 + ny) > tiles.size()) {return any_tile_in_range(line_bcube, f);} // vertical in x, or long line
+		float const dy_dx((p2.y - p1.y)/(p2.x - p1.x));
+
+		for (int x = x1; x <= x2; ++x) { // iterate over columns of tiles, and the range of tiles in y covered by the line in each column
+			float const xa(max(line_bcube.x1(), get_tile_lo(x, 0) - max_extent.x)), xb(min(line_bcube.x2(), get_tile_lo(x+1, 0) + max_extent.x));
+			if (xa > xb) continue; // line doesn't cross this column
+			float const ya(p1.y + (xa - p1.x)*dy_dx), yb(p1.y + (xb - p1.x)*dy_dx);
+			int const y1(get_tile_ix(min(ya, yb) - max_extent.y, 1)), y2(get_tile_ix(max(ya, yb) + max_extent.y, 1));
+
+			for (int y = y1; y <= y2; ++y) {
+				auto it(tiles.find(make_pair(x, y)));
+				if (it != tiles.end() && it->second.get_bcube().intersects(line_bcube) && f(it->second)) return 1;
+			}
+		} // for x
+		return 0;
+	}
 public:
 	building_tiles_t() : max_extent(zero_vector) {}
 	bool     empty() const {return tiles.empty();}
@@ -3057,10 +3243,8 @@ public:
 			if (it == tiles.end()) return 0;
 			return it->second.check_sphere_coll(pos, p_last, radius, xy_only, cnorm, check_interior);
 		}
-		for (auto i = tiles.begin(); i != tiles.end(); ++i) {
-			if (i->second.check_sphere_coll(pos, p_last, radius, xy_only, cnorm, check_interior)) return 1;
-		}
-		return 0;
+		cube_t query; query.set_from_sphere((pos - get_camera_coord_space_xlate()), radius);
+		return any_tile_in_range(query, [&](building_creator_t const &bc) {return bc.check_sphere_coll(pos, p_last, radius, xy_only, cnorm, check_interior);});
 	}
 	bool get_building_hit_color(point const &p1, point const &p2, colorRGBA &color) const {
 		vector3d const xlate(get_camera_coord_space_xlate());
@@ -3071,13 +3255,8 @@ public:
 			if (it == tiles.end()) return 0;
 			return it->second.get_building_hit_color(p1, p2, color);
 		}
-		cube_t const line_bcube((p1 - xlate), (p2 - xlate));
-
-		for (auto i = tiles.begin(); i != tiles.end(); ++i) {
-			if (!i->second.get_bcube().intersects(line_bcube)) continue; // optimization
-			if (i->second.get_building_hit_color(p1, p2, color)) return 1; // line is generally pointed down and can only intersect one building; return the first hit
-		}
-		return 0;
+		// line is generally pointed down and can only intersect one building; return the first hit
+		return any_tile_on_line((p1 - xlate), (p2 - xlate), [&](building_creator_t const &bc) {return bc.get_building_hit_color(p1, p2, color);});
 	}
 	void add_drawn(vector3d const &xlate, vector<building_creator_t *> &bcs) {
 		float const draw_dist(get_draw_tile_dist());
@@ -3187,6 +3366,10 @@ bool get_buildings_line_hit_color(point const &p1, point const &p2, colorRGBA &c
 }
 bool have_buildings() {return (!building_creator.empty() || !building_creator_city.empty() || !building_tiles.empty());} // for postproc effects
 bool no_grass_under_buildings() {return (world_mode == WMODE_INF_TERRAIN && !(building_creator.empty() && building_tiles.empty()) && global_building_params.flatten_mesh);}
+unsigned long long get_buildings_checksum(unsigned &num_buildings) {
+	num_buildings = building_creator.get_num_buildings() + building_creator_city.get_num_buildings();
+	return building_creator_city.get_checksum(building_creator.get_checksum(hash_string_fnv1a("buildings")));
+}
 unsigned get_buildings_gpu_mem_usage() {return (building_creator.get_gpu_mem_usage() + building_creator_city.get_gpu_mem_usage() + building_tiles.get_gpu_mem_usage());}
 
 vector3d get_buildings_max_extent() { // used for TT shadow bounds + map mode
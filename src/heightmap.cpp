@@ -3,6 +3,7 @@
 // 10/19/13
 
 #include "heightmap.h"
+#include "mesh.h" // for erosion_tile_source_t
 #include "function_registry.h"
 #include "inlines.h"
 #include "file_utils.h"
@@ -13,7 +14,7 @@ using namespace std;
 
 unsigned const TEX_EDGE_MODE = 2; // 0 = clamp, 1 = cliff/underwater, 2 = mirror
 
-extern unsigned hmap_filter_width, erosion_iters_tt;
+extern unsigned hmap_filter_width, erosion_iters_tt, erosion_tile_size;
 extern int display_mode;
 extern float mesh_scale, dxdy;
 extern string hmap_out_fn;
@@ -29,30 +30,84 @@ void adjust_brush_weight(float &delta, float dval, int shape) {
 }
 
 //enum {BSHAPE_CONST_SQ=0, BSHAPE_CNST_CIR, BSHAPE_LINEAR, BSHAPE_QUADRATIC, BSHAPE_COSINE, BSHAPE_SINE, BSHAPE_FLAT_SQ, BSHAPE_FLAT_CIR, NUM_BSHAPES};
+// returns true if this brush may modify any point within the inclusive rect {rx1,ry1}-{rx2,ry2}, in brush coordinate space
+bool tex_mod_map_manager_t::hmap_brush_t::overlaps_rect(int rx1, int ry1, int rx2, int ry2) const {
+
+	int const r(radius + 1); // add one to account for fractional sub-steps
+	if (x + r < rx1 || x - r > rx2 || y + r < ry1 || y - r > ry2) return 0; // bounding square doesn't overlap
+	if (!is_round()) return 1;
+	float const dx(x - max(rx1, min(rx2, x))), dy(y - max(ry1, min(ry2, y))); // distance to closest point in rect
+	return ((dx*dx + dy*dy) <= float(r*r));
+}
+
+// computes the brush height deltas for num samples with normalized distances dvals; same as adjust_brush_weight() + round_fp(), but vectorizable for common shapes
+void get_brush_row_deltas(float delta, int shape, float const *const dvals, tex_mod_map_manager_t::hmap_val_t *const vals, unsigned num) {
+
+	if (shape == BSHAPE_LINEAR) {
+		for (unsigned n = 0; n < num; ++n) {vals[n] = round_fp(delta*(1.0f - dvals[n]));}
+	}
+	else if (shape == BSHAPE_QUADRATIC) {
+		for (unsigned n = 0; n < num; ++n) {vals[n] = round_fp(delta*(1.0f - dvals[n]*dvals[n]));}
+	}
+	else if (shape == BSHAPE_COSINE || shape == BSHAPE_SINE) {
+		for (unsigned n = 0; n < num; ++n) {
+			float mod_delta(delta);
+			adjust_brush_weight(mod_delta, dvals[n], shape);
+			vals[n] = round_fp(mod_delta);
+		}
+	}
+	else { // constant
+		int const val(round_fp(delta));
+		for (unsigned n = 0; n < num; ++n) {vals[n] = val;}
+	}
+}
+
+// the brush is applied one row of samples at a time: distances and deltas are computed for the whole row, then the row is written with modify_height_row()
 void tex_mod_map_manager_t::hmap_brush_t::apply(tex_mod_map_manager_t *tmmm, int step_sz, unsigned num_steps) const {
 
-	assert(num_steps > 0);
+	assert(tmmm);
+	assert(num_steps > 0 && step_sz > 0);
 	float const step_delta(1.0/num_steps), r_inv(1.0/max(1U, radius));
-	bool const is_delta(!is_flatten_brush());
+	bool const is_delta(!is_flatten_brush()), round_brush(is_round());
+	int const x0(x - (int)radius);
+	unsigned const row_len((2*radius/step_sz + 1)*num_steps); // sample n is at xp = x0 + (n/num_steps)*step_sz, fract_x = (n%num_steps)*step_delta
+	vector<float> rx_vals(row_len); // x offset from the brush center; the same for every row
+
+	for (unsigned n = 0; n < row_len; ++n) {
+		int const xp(x0 + int(n/num_steps)*step_sz);
+		rx_vals[n] = (xp + (n%num_steps)*step_delta - x);
+	}
+	#pragma omp parallel
+	{
+		vector<float> dvals(row_len);
+		vector<hmap_val_t> vals(row_len);
 
-	#pragma omp parallel for schedule(dynamic,1) // only ~1.8x faster
-	for (int yp = y - (int)radius; yp <= y + (int)radius; yp += step_sz) {
-		for (int xp = x - (int)radius; xp <= x + (int)radius; xp += step_sz) {
+		#pragma omp for schedule(dynamic,1) // only ~1.8x faster
+		for (int yp = y - (int)radius; yp <= y + (int)radius; yp += step_sz) {
 			for (unsigned sy = 0; sy < num_steps; ++sy) {
-				for (unsigned sx = 0; sx < num_steps; ++sx) {
-					float const dx(sx*step_delta), dy(sy*step_delta);
-					float const dist(sqrt(float(yp + dy - y)*float(yp + dy - y) + float(xp + dx - x)*float(xp + dx - x))), dval(dist*r_inv);
-					if (shape != BSHAPE_CONST_SQ && shape != BSHAPE_FLAT_SQ && dval > 1.0) continue; // round (instead of square)
-					float mod_delta(delta); // constant
-					adjust_brush_weight(mod_delta, dval, shape);
-					assert(tmmm);
-					tmmm->modify_height_value(xp, yp, round_fp(mod_delta), is_delta, dx, dy);
+				float const dy(sy*step_delta), ry(yp + dy - y), ry_sq(ry*ry); // constant for this row
+				for (unsigned n = 0; n < row_len; ++n) {dvals[n] = sqrt(ry_sq + rx_vals[n]*rx_vals[n])*r_inv;}
+				unsigned n1(0), n2(row_len); // range of samples to modify
+
+				if (round_brush) { // round (instead of square); dval increases monotonically away from the center, so the samples inside are contiguous
+					while (n1 < n2 && dvals[n1  ] > 1.0) {++n1;}
+					while (n2 > n1 && dvals[n2-1] > 1.0) {--n2;}
+					if (n1 == n2) continue; // no samples in this row
 				}
+				get_brush_row_deltas(delta, shape, (dvals.data() + n1), (vals.data() + n1), (n2 - n1));
+				tmmm->modify_height_row(x0, yp, step_sz, num_steps, dy, n1, n2, vals.data(), is_delta);
 			}
 		}
 	}
 }
 
+// default row update: calls modify_height_value() for each sample in [n1, n2); see hmap_brush_t::apply() for the sample positions
+void tex_mod_map_manager_t::modify_height_row(int x0, int y, int step_sz, unsigned num_steps, float fract_y, unsigned n1, unsigned n2, hmap_val_t const *vals, bool is_delta) {
+
+	float const step_delta(1.0/num_steps);
+	for (unsigned n = n1; n < n2; ++n) {modify_height_value((x0 + int(n/num_steps)*step_sz), y, vals[n], is_delta, (n%num_steps)*step_delta, fract_y);}
+}
+
 
 unsigned heightmap_t::get_pixel_ix(unsigned x, unsigned y) const {
 
@@ -91,6 +146,26 @@ float heightmap_t::get_heightmap_value(unsigned x, unsigned y) const { // return
 }
 
 
+void heightmap_t::modify_heightmap_row(unsigned x, unsigned y, int const *const vals, unsigned num, bool val_is_delta) { // num pixels starting at {x, y}
+
+	assert(is_allocated());
+	assert(ncolors == 1 || ncolors == 2); // one or two byte grayscale
+	assert(x + num <= (unsigned)width && y < (unsigned)height);
+	unsigned const ix(width*y + x);
+
+	if (ncolors == 1) {
+		unsigned char *const ptr(data + ix);
+		if (val_is_delta) {for (unsigned n = 0; n < num; ++n) {ptr[n] = max(0, min(255, (vals[n] + ptr[n])));}} // clamp
+		else              {for (unsigned n = 0; n < num; ++n) {ptr[n] = max(0, min(255,  vals[n]          ));}}
+	}
+	else { // ncolors == 2
+		unsigned short *const ptr((unsigned short *)(data + (ix<<1)));
+		if (val_is_delta) {for (unsigned n = 0; n < num; ++n) {ptr[n] = max(0, min(65535, (vals[n] + ptr[n])));}} // clamp
+		else              {for (unsigned n = 0; n < num; ++n) {ptr[n] = max(0, min(65535,  vals[n]          ));}}
+	}
+}
+
+
 void heightmap_t::modify_heightmap_value(unsigned x, unsigned y, int val, bool val_is_delta) {
 
 	assert(is_allocated());
@@ -113,23 +188,91 @@ void heightmap_t::modify_heightmap_value(unsigned x, unsigned y, int val, bool v
 float get_mh_texture_mult();
 float get_mh_texture_add ();
 
+// convert num pixels starting at ix from pixel to heightmap value; max value is 255.0
+void heightmap_t::get_pixel_heights(unsigned ix, unsigned num, float val_mult, float val_add, float *const vals) const {
+	if (ncolors == 2) { // 16-bit
+		unsigned char const *const ptr(data + (ix<<1));
+		for (unsigned n = 0; n < num; ++n) {vals[n] = val_mult*float(ptr[n<<1]/256.0 + ptr[(n<<1)+1]) + val_add;}
+	}
+	else { // 8-bit
+		unsigned char const *const ptr(data + ix);
+		for (unsigned n = 0; n < num; ++n) {vals[n] = val_mult*float(ptr[n]) + val_add;}
+	}
+}
+
+// convert num pixels starting at ix from heightmap value to pixel
+void heightmap_t::set_pixel_heights(unsigned ix, unsigned num, float const *const vals, float val_div, float val_add) {
+	bool in_range(1);
+
+	if (ncolors == 2) { // 16-bit; same as write_pixel_16_bits()
+		unsigned char *const ptr(data + (ix<<1));
+
+		for (unsigned n = 0; n < num; ++n) {
+			float const v((vals[n] - val_add)*val_div);
+			unsigned char const high_bits(v); // high bits - truncate
+			in_range &= (v >= 0.0f && v < 256.0f);
+			ptr[(n<<1)+1] = high_bits;
+			ptr[n<<1]     = (unsigned char)(256.0f*(v - float(high_bits))); // low bits - remainder
+		}
+	}
+	else { // 8-bit
+		unsigned char *const ptr(data + ix);
+
+		for (unsigned n = 0; n < num; ++n) {
+			float const v((vals[n] - val_add)*val_div);
+			in_range &= (v >= 0.0f && v < 256.0f);
+			ptr[n] = (unsigned char)v;
+		}
+	}
+	assert(in_range); // must convert to [0,256) range
+}
+
+
+class hmap_erosion_source_t : public erosion_tile_source_t { // streams heightmap pixels to/from tiled erosion
+
+	heightmap_t &hmap;
+	float val_mult, val_div, val_add;
+public:
+	hmap_erosion_source_t(heightmap_t &hmap_, float val_mult_, float val_add_) : hmap(hmap_), val_mult(val_mult_), val_div(1.0/val_mult_), val_add(val_add_) {}
+
+	virtual void read_tile(int x1, int y1, int x2, int y2, float *vals) {
+#pragma omp parallel for schedule(static,16)
+		for (int y = y1; y < y2; ++y) {hmap.get_pixel_heights((y*hmap.width + x1), (x2 - x1), val_mult, val_add, (vals + (y - y1)*(x2 - x1)));}
+	}
+	virtual void write_tile(int x1, int y1, int x2, int y2, float const *vals) {
+#pragma omp parallel for schedule(static,16)
+		for (int y = y1; y < y2; ++y) {hmap.set_pixel_heights((y*hmap.width + x1), (x2 - x1), (vals + (y - y1)*(x2 - x1)), val_div, val_add);}
+	}
+};
+
+
 void heightmap_t::postprocess_height() {
 
 	if (erosion_iters_tt == 0 && !have_cities()) return; // no erosion or cities
 	timer_t timer("Postprocess Height");
 	assert(is_allocated());
 	assert(ncolors == 1 || ncolors == 2); // one or two byte grayscale
+	float const val_mult(get_mh_texture_mult()), val_add(get_mh_texture_add());
+
+	if (!have_cities() && erosion_tile_size > 0 && (unsigned)max(width, height) > erosion_tile_size) {
+		// erode in tiles to bound memory usage for large heightmaps; cities need the entire heightmap in float form, so aren't supported here
+		vector<float> row(width);
+		get_pixel_heights(0, 1, val_mult, val_add, row.data());
+		float min_zval(row.front());
+
+		for (int y = 0; y < height; ++y) {
+			get_pixel_heights(y*width, width, val_mult, val_add, row.data());
+			for (auto i = row.begin(); i != row.end(); ++i) {min_eq(min_zval, *i);}
+		}
+		hmap_erosion_source_t src(*this, val_mult, val_add);
+		apply_erosion_tiled(src, width, height, min_zval, erosion_iters_tt, erosion_tile_size, max(16U, erosion_tile_size/4)); // margin = 1/4 tile size
+		return;
+	}
 	vector<float> vals(num_pixels());
 	assert(!vals.empty());
-	float const val_mult(get_mh_texture_mult()), val_div(1.0/val_mult), val_add(get_mh_texture_add());
-
-#pragma omp parallel for schedule(static,64)
-	for (int i = 0; i < (int)vals.size(); ++i) { // convert from pixel to heightmap value; max value is 255.0
-		float &v(vals[i]);
-		if (ncolors == 2) {v = (data[i<<1]/256.0 + data[(i<<1)+1]);} // 16-bit
-		else {v = data[i];} // 8-bit
-		v = val_mult*v + val_add;
-	}
+
+#pragma omp parallel for schedule(static,16)
+	for (int y = 0; y < height; ++y) {get_pixel_heights(y*width, width, val_mult, val_add, (vals.data() + y*width));}
 	if (erosion_iters_tt > 0) {
 		float min_zval(vals.front());
 		for (auto i = vals.begin(); i != vals.end(); ++i) {min_eq(min_zval, *i);}
@@ -137,13 +280,10 @@ void heightmap_t::postprocess_height() {
 	}
 	gen_cities(&vals.front(), width, height);
 
-#pragma omp parallel for schedule(static,64)
-	for (int i = 0; i < (int)vals.size(); ++i) { // convert from heightmap value to pixel
-		float v((vals[i] - val_add)*val_div);
-		assert(v >= 0.0 && v < 256.0); // must convert to [0,256) range
-		if (ncolors == 2) {write_pixel_16_bits(i, v);} // 16-bit
-		else {data[i] = (unsigned char)v;} // 8-bit
-	}
+	float const val_div(1.0/val_mult);
+
+#pragma omp parallel for schedule(static,16)
+	for (int y = 0; y < height; ++y) {set_pixel_heights(y*width, width, (vals.data() + y*width), val_div, val_add);}
 }
 
 
@@ -337,6 +477,15 @@ void terrain_hmap_manager_t::modify_height(mod_elem_t const &elem, bool is_delta
 	hmap.modify_heightmap_value(elem.x, elem.y, elem.delta, is_delta);
 }
 
+bool terrain_hmap_manager_t::modify_height_row_if_inside(int x, int y, hmap_val_t const *vals, unsigned num, bool is_delta) { // {x, y} is unscaled, as in clamp_no_scale()
+	x += hmap.width /2; // offset (0,0) to texture center
+	y += hmap.height/2;
+	if (x < 0 || y < 0 || x + (int)num > hmap.width || y >= hmap.height) return 0; // not entirely on the texture
+	assert((unsigned)max(hmap.width, hmap.height) <= max_tex_ix());
+	hmap.modify_heightmap_row(x, y, vals, num, is_delta);
+	return 1;
+}
+
 tex_mod_map_manager_t::hmap_val_t terrain_hmap_manager_t::scale_delta(float delta) const {
 	int const scale_factor(1 << (hmap.bytes_per_channel() << 3));
 	return scale_factor*CLIP_TO_pm1(delta);
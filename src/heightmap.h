@@ -26,6 +26,9 @@ public:
 	unsigned get_pixel_value (unsigned x, unsigned y) const;
 	float get_heightmap_value(unsigned x, unsigned y) const;
 	void modify_heightmap_value(unsigned x, unsigned y, int val, bool val_is_delta);
+	void modify_heightmap_row(unsigned x, unsigned y, int const *const vals, unsigned num, bool val_is_delta);
+	void get_pixel_heights(unsigned ix, unsigned num, float val_mult, float val_add, float *const vals) const;
+	void set_pixel_heights(unsigned ix, unsigned num, float const *const vals, float val_div, float val_add);
 	void postprocess_height();
 };
 
@@ -72,6 +75,8 @@ public:
 		hmap_brush_t() : x(0), y(0), radius(0), delta(0), shape(0) {}
 		hmap_brush_t(int x_, int y_, hmap_val_t d, unsigned r, short s) : x(x_), y(y_), radius(r), delta(d), shape(s) {assert(shape < NUM_BSHAPES);}
 		bool is_flatten_brush() const {return (shape == BSHAPE_FLAT_SQ || shape == BSHAPE_FLAT_CIR);}
+		bool is_round() const {return (shape != BSHAPE_CONST_SQ && shape != BSHAPE_FLAT_SQ);}
+		bool overlaps_rect(int rx1, int ry1, int rx2, int ry2) const;
 		void apply(tex_mod_map_manager_t *tmmm, int step_sz=1, unsigned num_steps=1) const;
 	};
 
@@ -99,6 +104,7 @@ public:
 	bool write_mod(std::string const &fn) const;
 
 	virtual bool modify_height_value(int x, int y, hmap_val_t val, bool is_delta, float fract_x=0.0, float fract_y=0.0, bool allow_wrap=1) = 0;
+	virtual void modify_height_row(int x0, int y, int step_sz, unsigned num_steps, float fract_y, unsigned n1, unsigned n2, hmap_val_t const *vals, bool is_delta);
 	virtual ~tex_mod_map_manager_t() {}
 };
 
@@ -126,6 +132,7 @@ public:
 		return 1;
 	}
 	void modify_height(mod_elem_t const &elem, bool is_delta);
+	bool modify_height_row_if_inside(int x, int y, hmap_val_t const *vals, unsigned num, bool is_delta);
 	void modify_and_cache_height(mod_elem_t const &elem, bool is_delta) {modify_height(elem, is_delta); add_mod(elem);} // unused
 	hmap_val_t scale_delta(float delta) const;
 	bool read_and_apply_mod(std::string const &fn);
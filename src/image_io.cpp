@@ -3,7 +3,9 @@
 // 10/14/13
 #include "targa.h"
 #include "textures.h"
+#include "function_registry.h"
 #include <fstream> // for filebuf
+#include <sys/stat.h> // for texture cache source file timestamps
 
 using namespace std;
 
@@ -31,6 +33,10 @@ void wrap_png_error(png_structp, png_const_charp) {
 
 
 string const texture_dir("textures");
+unsigned const TEX_CACHE_MAGIC   = 0x58455433; // "3TEX"
+unsigned const TEX_CACHE_VERSION = 1; // increment when texture post-processing changes
+
+extern string texture_cache_dir;
 
 string append_texture_dir(string const &filename) {return (texture_dir + "/" + filename);}
 
@@ -89,6 +95,95 @@ string get_file_extension(string const &filename, unsigned level, bool make_lowe
 }
 
 
+// decoded texture disk cache: stores post-processed image data keyed by source file path/size/mtime and load parameters
+struct tex_cache_header_t {
+	unsigned magic, version, key_len;
+	int width, height, ncolors;
+	unsigned char is_16_bit_gray, pad[3];
+	tex_cache_header_t() : magic(TEX_CACHE_MAGIC), version(TEX_CACHE_VERSION), key_len(0), width(0), height(0), ncolors(0), is_16_bit_gray(0) {pad[0] = pad[1] = pad[2] = 0;}
+};
+
+bool get_texture_file_stats(string const &filename, unsigned long long &fsize, unsigned long long &mtime) {
+	struct stat st;
+	// check the texture directory first, then the current directory, matching open_texture_file_no_check()
+	if (stat(append_texture_dir(filename).c_str(), &st) != 0 && stat(filename.c_str(), &st) != 0) return 0;
+	fsize = (unsigned long long)st.st_size;
+	mtime = (unsigned long long)st.st_mtime;
+	return 1;
+}
+
+unsigned long long hash_bytes_fnv1a(void const *data, size_t len, unsigned long long hash) {
+	unsigned char const *bytes((unsigned char const *)data);
+	for (size_t i = 0; i < len; ++i) {hash ^= bytes[i]; hash *= 1099511628211ULL;}
+	return hash;
+}
+unsigned long long hash_string_fnv1a(string const &str) {return hash_bytes_fnv1a(str.data(), str.size());}
+
+bool get_texture_cache_fn_and_key(string const &name, string const &params, string &cache_fn, string &key) {
+	if (texture_cache_dir.empty() || name.empty()) return 0; // cache disabled
+	unsigned long long fsize(0), mtime(0);
+	if (!get_texture_file_stats(name, fsize, mtime)) return 0; // file not found; let the loader report the error
+	std::ostringstream oss;
+	oss << name << "|" << fsize << "|" << mtime << "|" << params;
+	key = oss.str();
+	std::ostringstream fn;
+	fn << texture_cache_dir << "/" << std::hex << hash_string_fnv1a(key) << ".tcache";
+	cache_fn = fn.str();
+	return 1;
+}
+
+bool texture_t::read_from_cache(string const &cache_fn, string const &key) {
+
+	FILE *fp(fopen(cache_fn.c_str(), "rb"));
+	if (fp == nullptr) return 0; // not cached
+	tex_cache_header_t header;
+	bool valid(fread(&header, sizeof(header), 1, fp) == 1 && header.magic == TEX_CACHE_MAGIC && header.version == TEX_CACHE_VERSION && header.key_len == key.size());
+	valid &= (header.width > 0 && header.height > 0 && header.ncolors >= 1 && header.ncolors <= 4);
+
+	if (valid) { // check the full key in case of a hash collision or stale source file
+		string file_key(key.size(), ' ');
+		valid = (fread(&file_key[0], 1, key.size(), fp) == key.size() && file_key == key);
+	}
+	if (valid) {
+		width   = header.width;
+		height  = header.height;
+		ncolors = header.ncolors;
+		is_16_bit_gray = (header.is_16_bit_gray != 0);
+		alloc();
+		valid = (fread(data, 1, num_bytes(), fp) == num_bytes());
+		if (!valid) {free_client_mem();}
+	}
+	checked_fclose(fp);
+	return valid;
+}
+
+bool texture_t::write_to_cache(string const &cache_fn, string const &key) const {
+
+	assert(is_allocated());
+	// write to a temp file and rename so that concurrent loads of the same texture never see a partial file
+	std::ostringstream tmp_fn_oss;
+	tmp_fn_oss << cache_fn << "." << omp_get_thread_num_3dw() << ".tmp";
+	string const tmp_fn(tmp_fn_oss.str());
+	FILE *fp(fopen(tmp_fn.c_str(), "wb"));
+
+	if (fp == nullptr) {
+		cerr << "Warning: Failed to open texture cache file " << tmp_fn << " for writing" << endl;
+		return 0;
+	}
+	tex_cache_header_t header;
+	header.key_len = key.size();
+	header.width   = width;
+	header.height  = height;
+	header.ncolors = ncolors;
+	header.is_16_bit_gray = is_16_bit_gray;
+	bool const success(fwrite(&header, sizeof(header), 1, fp) == 1 && fwrite(key.data(), 1, key.size(), fp) == key.size() && fwrite(data, 1, num_bytes(), fp) == num_bytes());
+	checked_fclose(fp);
+	if (success && rename(tmp_fn.c_str(), cache_fn.c_str()) == 0) return 1;
+	remove(tmp_fn.c_str()); // failed, or another thread already wrote this cache entry
+	return 0;
+}
+
+
 void texture_t::load(int index, bool allow_diff_width_height, bool allow_two_byte_grayscale, bool ignore_word_alignment) {
 
 	if (type > 0) { // generated texture
@@ -115,7 +210,14 @@ void texture_t::load(int index, bool allow_diff_width_height, bool allow_two_byt
 			}
 		}
 		unsigned const want_alpha_channel(ncolors == 4), want_luminance(ncolors == 1);
+		string cache_fn, cache_key;
 
+		if (format != 10) { // DDS files use deferred load and aren't decoded on the CPU
+			std::ostringstream params;
+			params << int(format) << " " << width << " " << height << " " << ncolors << " " << invert_y << invert_alpha << allow_diff_width_height
+				<< allow_two_byte_grayscale << ignore_word_alignment;
+			if (get_texture_cache_fn_and_key(name, params.str(), cache_fn, cache_key) && read_from_cache(cache_fn, cache_key)) return; // cache hit
+		}
 		switch (format) {
 		case 0: case 1: case 2: case 3: load_raw_bmp(index, allow_diff_width_height, allow_two_byte_grayscale); break; // raw
 		case 4: load_targa(index, allow_diff_width_height); break;
@@ -149,6 +251,7 @@ void texture_t::load(int index, bool allow_diff_width_height, bool allow_two_byt
 				for (unsigned i = 0; i < npixels; ++i) {data[4*i+3] = (255 - data[4*i+3]);}
 			}
 		}
+		if (!cache_fn.empty()) {write_to_cache(cache_fn, cache_key);}
 	} // end non-generated texture case
 #if 0
 	if (name.size() > 4 && name.front() != '@') {
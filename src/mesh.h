@@ -19,6 +19,21 @@ struct ripple_state {
 class compute_shader_t;
 class compute_shader_comp_t;
 
+struct noise_gen_params_t { // CPU simplex/perlin noise state that is constant across a batch of samples
+	int mode, shape;
+	unsigned end_octave;
+	float rx, ry, xy_scale, hmap_scale;
+
+	noise_gen_params_t() : mode(MGEN_SINE), shape(0), end_octave(0), rx(0.0), ry(0.0), xy_scale(0.0), hmap_scale(0.0) {}
+	noise_gen_params_t(int mode_, int shape_) {setup(mode_, shape_);}
+	void setup(int mode_, int shape_);
+	bool use_simplex() const {return (mode == MGEN_SIMPLEX || mode == MGEN_SIMPLEX_GPU || mode == MGEN_DWARP_GPU);}
+	float gen_noise(float xv, float yv) const;
+	float get_noise_zval(float xval, float yval) const;
+	void gen_noise_batch(float const *const xv, float const *const yv, float *const zvals, unsigned num) const;
+	void get_noise_zvals(float const *const xvals, float yval, float *const zvals, unsigned num) const;
+};
+
 class mesh_xy_grid_cache_t {
 
 	vector<float> xyterms, sine_mag_terms, cached_vals;
@@ -26,6 +41,7 @@ class mesh_xy_grid_cache_t {
 	float mx0, my0, mdx, mdy, sine_offset;
 	int gen_mode, gen_shape;
 	bool do_glaciate;
+	noise_gen_params_t noise_params; // for CPU noise modes
 
 	// compute_shader_t or compute_shader_comp_t, but only compute_shader_t works for tiled terrain (size not a multiple of block_size=16)
 	typedef compute_shader_t grid_gen_shader_t;
@@ -34,6 +50,7 @@ class mesh_xy_grid_cache_t {
 
 	void run_gpu_simplex();
 	void cache_gpu_simplex_vals();
+	void cache_cpu_noise_vals();
 
 public:
 	mesh_xy_grid_cache_t() : cur_nx(0), cur_ny(0), yterms_start(0), tid(0), mx0(0.0), my0(0.0), mdx(0.0), mdy(0.0), sine_offset(0.0),
@@ -41,6 +58,7 @@ public:
 	~mesh_xy_grid_cache_t() {clear_context();}
 	bool build_arrays(float x0, float y0, float dx, float dy, unsigned nx, unsigned ny, bool cache_values=0, bool force_sine_mode=0, bool no_wait=0);
 	void enable_glaciate();
+	void cancel_async();
 	float eval_index(unsigned x, unsigned y, int min_start_sin=0, bool use_cache=1) const;
 	void clear_context();
 	void free_cshader();
@@ -88,6 +106,13 @@ struct surf_adv { // size = 4
 
 float const hmap_large_zval = 1000.0;
 
+struct erosion_tile_source_t { // streaming heightmap interface for apply_erosion_tiled(); tile ranges are [x1,x2)x[y1,y2), row major
+	virtual void read_tile (int x1, int y1, int x2, int y2, float *vals) = 0;
+	virtual void write_tile(int x1, int y1, int x2, int y2, float const *vals) = 0;
+	virtual ~erosion_tile_source_t() {}
+};
+
+
 struct hmap_params_t {
 	//int mode, shape;
 	float plat_bot, plat_h, plat_s, plat_max, crat_h, crat_s, crack_lo, crack_hi, crack_d, sine_mag, sine_freq, sine_bias, volcano_width, volcano_height;
@@ -27,6 +27,7 @@ bool     const DEF_GLACIATE       = 1;
 float    const DEF_GLACIATE_EXP   = 3.0;
 bool     const GEN_SCROLLING_MESH = 1;
 float    const S_GEN_ATTEN_DIST   = 128.0;
+unsigned const NOISE_BATCH_SIZE   = 64; // samples per batch in CPU noise row evaluation
 
 int   const F_TABLE_SIZE = NUM_FREQ_COMP*N_RAND_SIN2;
 
@@ -542,6 +543,14 @@ void compute_scale() {
 	start_eval_sin = N_RAND_SIN2*max(0, min(NUM_FREQ_COMP-MIN_FREQS, (iscale+mesh_freq_filter)));
 }
 
+// writes all state that affects procedural height generation, for use in persistent cache keys
+void write_mesh_gen_params_key(std::ostream &out) {
+	string const sin_table((char const *)sinTable, sizeof(sinTable)), hparams((char const *)&hmap_params, sizeof(hmap_params_t));
+	out << mesh_gen_mode << " " << mesh_gen_shape << " " << mesh_seed << " " << mesh_rgen_index << " " << start_eval_sin << " " << GLACIATE << " "
+		<< mesh_scale << " " << mesh_scale_z_inv << " " << mesh_height_scale << " " << MESH_HEIGHT << " " << glaciate_exp << " " << zmax_est << " " << zmax_est2 << " "
+		<< MESH_X_SIZE << " " << MESH_Y_SIZE << " " << DX_VAL << " " << DY_VAL << " " << hash_string_fnv1a(sin_table) << " " << hash_string_fnv1a(hparams);
+}
+
 float get_hmap_scale(int mode) {
 	float const scale((mode == MGEN_SIMPLEX || mode == MGEN_SIMPLEX_GPU || mode == MGEN_DWARP_GPU) ? 16.0 : 32.0); // simplex vs. perlin
 	return scale*MESH_HEIGHT*mesh_height_scale*mesh_scale_z_inv;
@@ -599,6 +608,11 @@ bool mesh_xy_grid_cache_t::build_arrays(float x0, float y0, float dx, float dy,
 		cache_gpu_simplex_vals();
 		return 1; // results are available
 	}
+	if (gen_mode != MGEN_SINE) { // CPU simplex/perlin noise - sine terms are unused
+		noise_params.setup(gen_mode, gen_shape);
+		if (cache_values) {cache_cpu_noise_vals();}
+		return 1; // results are available
+	}
 	yterms_start = nx*F_TABLE_SIZE;
 	xyterms.resize((nx + ny)*F_TABLE_SIZE, 0.0);
 	float const msx(mesh_scale*DX_VAL_INV), msy(mesh_scale*DY_VAL_INV), ms2(0.5*mesh_scale);
@@ -690,6 +704,24 @@ void mesh_xy_grid_cache_t::cache_gpu_simplex_vals() {
 	}
 }
 
+void mesh_xy_grid_cache_t::cache_cpu_noise_vals() { // evaluates all samples at once, one row per thread, using SIMD within each row
+
+	cached_vals.resize(cur_nx*cur_ny);
+	vector<float> xvals(cur_nx);
+	for (unsigned x = 0; x < cur_nx; ++x) {xvals[x] = (x*mdx + mx0)*DX_VAL_INV;} // same as eval_index()
+
+#pragma omp parallel for schedule(static,1)
+	for (int y = 0; y < (int)cur_ny; ++y) {
+		noise_params.get_noise_zvals(xvals.data(), (y*mdy + my0)*DY_VAL_INV, (cached_vals.data() + y*cur_nx), cur_nx);
+	}
+}
+
+void mesh_xy_grid_cache_t::cancel_async() { // discard the results of a pending no_wait GPU job so that this cache can be reused
+	if (cshader == nullptr || !cshader->get_is_running()) return; // nothing pending
+	cshader->cancel_read(1); // keep FBO for reuse; drops the pending readback rather than mapping the PBO and waiting on the GPU
+	cached_vals.clear();
+}
+
 void mesh_xy_grid_cache_t::clear_context() { // for GPU-mode cached state
 	free_texture(tid);
 	if (cshader != nullptr) {cshader->end_shader(); free_cshader();}
@@ -699,51 +731,312 @@ void mesh_xy_grid_cache_t::free_cshader() { // don't make any GPU calls - hard r
 }
 
 
-float gen_noise(float xv, float yv, int mode, int shape) {
+// SIMD versions of glm::simplex(vec2) and glm::perlin(vec2) that evaluate 8 (AVX2) or 4 (SSE4.1) positions at once, selected at runtime;
+// they perform the same IEEE float operations in the same order as the glm code, without FMA, so results are bit-identical to the scalar path
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define NOISE_SIMD
+#define TARGET_AVX2  __attribute__((target("avx2")))
+#define TARGET_SSE41 __attribute__((target("sse4.1")))
+#define SIMD_INLINE  inline __attribute__((always_inline))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define NOISE_SIMD
+#define TARGET_AVX2
+#define TARGET_SSE41
+#define SIMD_INLINE  __forceinline
+#endif
+
+#ifdef NOISE_SIMD
+struct noise_v4_t {
+	__m128 v;
+	TARGET_SSE41 noise_v4_t(__m128 v_) : v(v_) {}
+	TARGET_SSE41 static noise_v4_t set1(float f) {return _mm_set1_ps(f);}
+	TARGET_SSE41 static noise_v4_t load(float const *p) {return _mm_loadu_ps(p);}
+	TARGET_SSE41 void store(float *p) const {_mm_storeu_ps(p, v);}
+	TARGET_SSE41 noise_v4_t operator+(noise_v4_t const &b) const {return _mm_add_ps(v, b.v);}
+	TARGET_SSE41 noise_v4_t operator-(noise_v4_t const &b) const {return _mm_sub_ps(v, b.v);}
+	TARGET_SSE41 noise_v4_t operator*(noise_v4_t const &b) const {return _mm_mul_ps(v, b.v);}
+	TARGET_SSE41 noise_v4_t operator/(noise_v4_t const &b) const {return _mm_div_ps(v, b.v);}
+	TARGET_SSE41 noise_v4_t floor() const {return _mm_floor_ps(v);}
+	TARGET_SSE41 noise_v4_t neg() const {return _mm_xor_ps(v, _mm_set1_ps(-0.0f));}
+	// returns (a < b) ? c : d and (a >= b) ? c : d, matching the glm scalar comparisons for all inputs including NaN
+	TARGET_SSE41 static noise_v4_t sel_lt(noise_v4_t const &a, noise_v4_t const &b, noise_v4_t const &c, noise_v4_t const &d) {return _mm_blendv_ps(d.v, c.v, _mm_cmplt_ps(a.v, b.v));}
+	TARGET_SSE41 static noise_v4_t sel_ge(noise_v4_t const &a, noise_v4_t const &b, noise_v4_t const &c, noise_v4_t const &d) {return _mm_blendv_ps(d.v, c.v, _mm_cmpge_ps(a.v, b.v));}
+};
+
+struct noise_v8_t {
+	__m256 v;
+	TARGET_AVX2 noise_v8_t(__m256 v_) : v(v_) {}
+	TARGET_AVX2 static noise_v8_t set1(float f) {return _mm256_set1_ps(f);}
+	TARGET_AVX2 static noise_v8_t load(float const *p) {return _mm256_loadu_ps(p);}
+	TARGET_AVX2 void store(float *p) const {_mm256_storeu_ps(p, v);}
+	TARGET_AVX2 noise_v8_t operator+(noise_v8_t const &b) const {return _mm256_add_ps(v, b.v);}
+	TARGET_AVX2 noise_v8_t operator-(noise_v8_t const &b) const {return _mm256_sub_ps(v, b.v);}
+	TARGET_AVX2 noise_v8_t operator*(noise_v8_t const &b) const {return _mm256_mul_ps(v, b.v);}
+	TARGET_AVX2 noise_v8_t operator/(noise_v8_t const &b) const {return _mm256_div_ps(v, b.v);}
+	TARGET_AVX2 noise_v8_t floor() const {return _mm256_floor_ps(v);}
+	TARGET_AVX2 noise_v8_t neg() const {return _mm256_xor_ps(v, _mm256_set1_ps(-0.0f));}
+	TARGET_AVX2 static noise_v8_t sel_lt(noise_v8_t const &a, noise_v8_t const &b, noise_v8_t const &c, noise_v8_t const &d) {return _mm256_blendv_ps(d.v, c.v, _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ));}
+	TARGET_AVX2 static noise_v8_t sel_ge(noise_v8_t const &a, noise_v8_t const &b, noise_v8_t const &c, noise_v8_t const &d) {return _mm256_blendv_ps(d.v, c.v, _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ));}
+};
+
+// Note: these take and return vectors by reference so that they don't depend on the vector ABI of the (non-SIMD) calling convention
+template<typename V> SIMD_INLINE void noise_mod(V const &x, V const &y, V &ret) {ret = x - y*(x/y).floor();} // glm::mod()
+template<typename V> SIMD_INLINE void noise_fract(V const &x, V &ret) {ret = x - x.floor();} // glm::fract()
+template<typename V> SIMD_INLINE void noise_abs(V const &x, V &ret) {ret = V::sel_ge(x, V::set1(0.0f), x, x.neg());} // glm::abs()
+
+template<typename V> SIMD_INLINE void noise_permute(V const &x, V &ret) { // glm::detail::permute()
+	V const t(((x*V::set1(34.0f)) + V::set1(1.0f))*x);
+	ret = t - (t*V::set1(1.0f/289.0f)).floor()*V::set1(289.0f); // mod289()
+}
 
-	float zval(0.0), mag(1.0), freq(1.0), rx, ry;
-	unsigned const end_octave(NUM_FREQ_COMP - start_eval_sin/N_RAND_SIN2);
-	float const lacunarity(1.92), gain(0.5);
+// glm::detail::taylorInvSqrt()
+template<typename V> SIMD_INLINE void noise_taylor_inv_sqrt(V const &r, V &ret) {ret = V::set1(float(1.79284291400159)) - V::set1(float(0.85373472095314))*r;}
+
+// gradient for one simplex corner, matching glm::simplex(vec2); m is updated in place and the gradient dot product is returned in g
+template<typename V> SIMD_INLINE void simplex_corner(V const &p, V const &dx, V const &dy, V &m, V &g) {
+	V fp(p), ax(p), scale(p);
+	noise_fract(p*V::set1(float(0.024390243902439)), fp);
+	V const x((V::set1(2.0f)*fp) - V::set1(1.0f));
+	noise_abs(x, ax);
+	V const h(ax - V::set1(0.5f)), a0(x - (x + V::set1(0.5f)).floor());
+	noise_taylor_inv_sqrt((a0*a0) + (h*h), scale);
+	m = m*m;
+	m = m*m;
+	m = m*scale;
+	g = (a0*dx) + (h*dy);
+}
+
+template<typename V> SIMD_INLINE void simplex_simd(V const &vx, V const &vy, V &ret) { // glm::simplex(vec2)
+	V const cx(V::set1(float(0.211324865405187))), cy(V::set1(float(0.366025403784439))), cz(V::set1(float(-0.577350269189626)));
+	V const zero(V::set1(0.0f)), one(V::set1(1.0f)), half(V::set1(0.5f)), v289(V::set1(289.0f));
+	V const dv((vx*cy) + (vy*cy));
+	V const ix((vx + dv).floor()), iy((vy + dv).floor());
+	V const di((ix*cx) + (iy*cx));
+	V const x0x((vx - ix) + di), x0y((vy - iy) + di);
+	V const i1x(V::sel_lt(x0y, x0x, one, zero)), i1y(V::sel_lt(x0y, x0x, zero, one)); // x0.x > x0.y
+	V const x12x((x0x + cx) - i1x), x12y((x0y + cx) - i1y), x12z(x0x + cz), x12w(x0y + cz);
+	V mx(vx), my(vy), t(vx), p0(vx), p1(vx), p2(vx);
+	noise_mod(ix, v289, mx);
+	noise_mod(iy, v289, my);
+	noise_permute(my + zero, t); noise_permute((t + mx) + zero, p0);
+	noise_permute(my + i1y,  t); noise_permute((t + mx) + i1x,  p1);
+	noise_permute(my + one,  t); noise_permute((t + mx) + one,  p2);
+	// max(0.5 - dot(x, x), 0)
+	V const d0(half - ((x0x *x0x ) + (x0y *x0y ))), d1(half - ((x12x*x12x) + (x12y*x12y))), d2(half - ((x12z*x12z) + (x12w*x12w)));
+	V m0(V::sel_lt(d0, zero, zero, d0)), m1(V::sel_lt(d1, zero, zero, d1)), m2(V::sel_lt(d2, zero, zero, d2)), g0(zero), g1(zero), g2(zero);
+	simplex_corner(p0, x0x,  x0y,  m0, g0);
+	simplex_corner(p1, x12x, x12y, m1, g1);
+	simplex_corner(p2, x12z, x12w, m2, g2);
+	ret = V::set1(130.0f)*(((m0*g0) + (m1*g1)) + (m2*g2));
+}
+
+// gradient for one perlin corner, matching glm::perlin(vec2); returns dot(g, f) in n
+template<typename V> SIMD_INLINE void perlin_corner(V const &pix, V const &piy, V const &fx, V const &fy, V &n) {
+	V t(pix), fi(pix), agx(pix), norm(pix);
+	noise_permute(pix, t);
+	noise_permute(t + piy, t);
+	noise_fract(t/V::set1(41.0f), fi);
+	V gx((V::set1(2.0f)*fi) - V::set1(1.0f));
+	noise_abs(gx, agx);
+	V gy(agx - V::set1(0.5f));
+	gx = gx - (gx + V::set1(0.5f)).floor();
+	noise_taylor_inv_sqrt((gx*gx) + (gy*gy), norm);
+	gx = gx*norm;
+	gy = gy*norm;
+	n  = (gx*fx) + (gy*fy);
+}
+
+template<typename V> SIMD_INLINE void noise_fade(V const &t, V &ret) {ret = ((t*t)*t)*((t*((t*V::set1(6.0f)) - V::set1(15.0f))) + V::set1(10.0f));}
+
+template<typename V> SIMD_INLINE void perlin_simd(V const &px, V const &py, V &ret) { // glm::perlin(vec2)
+	V const zero(V::set1(0.0f)), one(V::set1(1.0f)), v289(V::set1(289.0f)), flx(px.floor()), fly(py.floor());
+	V pi0(px), pi1(px), pi2(px), pi3(px), fr0(px), fr1(px), n00(px), n10(px), n01(px), n11(px), fdx(px), fdy(px);
+	noise_mod(flx + zero, v289, pi0);
+	noise_mod(fly + zero, v289, pi1);
+	noise_mod(flx + one,  v289, pi2);
+	noise_mod(fly + one,  v289, pi3);
+	noise_fract(px, fr0);
+	noise_fract(py, fr1);
+	V const pf0(fr0 - zero), pf1(fr1 - zero), pf2(fr0 - one), pf3(fr1 - one);
+	perlin_corner(pi0, pi1, pf0, pf1, n00);
+	perlin_corner(pi2, pi1, pf2, pf1, n10);
+	perlin_corner(pi0, pi3, pf0, pf3, n01);
+	perlin_corner(pi2, pi3, pf2, pf3, n11);
+	noise_fade(pf0, fdx);
+	noise_fade(pf1, fdy);
+	V const nx0(n00 + fdx*(n10 - n00)), nx1(n01 + fdx*(n11 - n01));
+	ret = V::set1(2.3f)*(nx0 + fdy*(nx1 - nx0));
+}
+
+template<typename V> SIMD_INLINE unsigned eval_noise_simd(bool use_simplex, float const *const px, float const *const py, float *const vals, unsigned num, unsigned width) {
+	unsigned i(0);
+
+	for (; i + width <= num; i += width) {
+		V const x(V::load(px + i)), y(V::load(py + i));
+		V r(x);
+		if (use_simplex) {simplex_simd(x, y, r);} else {perlin_simd(x, y, r);}
+		r.store(vals + i);
+	}
+	return i; // number of values computed
+}
+TARGET_AVX2  unsigned eval_noise_avx2 (bool use_simplex, float const *px, float const *py, float *vals, unsigned num) {return eval_noise_simd<noise_v8_t>(use_simplex, px, py, vals, num, 8);}
+TARGET_SSE41 unsigned eval_noise_sse41(bool use_simplex, float const *px, float const *py, float *vals, unsigned num) {return eval_noise_simd<noise_v4_t>(use_simplex, px, py, vals, num, 4);}
+
+unsigned get_noise_simd_width() { // 8 for AVX2, 4 for SSE4.1, 1 for scalar
+#ifdef _MSC_VER
+	int info[4] = {};
+	__cpuid(info, 0);
+	int const max_leaf(info[0]);
+	__cpuid(info, 1);
+	bool const sse41((info[2] & (1 << 19)) != 0), os_avx((info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0); // OSXSAVE and AVX
+	bool avx2(0);
+
+	if (os_avx && max_leaf >= 7 && (_xgetbv(0) & 6) == 6) { // OS saves XMM and YMM state
+		__cpuidex(info, 7, 0);
+		avx2 = ((info[1] & (1 << 5)) != 0);
+	}
+	return (avx2 ? 8 : (sse41 ? 4 : 1));
+#else
+	__builtin_cpu_init();
+	return (__builtin_cpu_supports("avx2") ? 8 : (__builtin_cpu_supports("sse4.1") ? 4 : 1));
+#endif
+}
+#endif // NOISE_SIMD
+
+// evaluates simplex or perlin noise at num (px, py) positions, with SIMD where supported and glm for the remainder
+void eval_noise_batch(bool use_simplex, float const *const px, float const *const py, float *const vals, unsigned num) {
+	unsigned i(0);
+#ifdef NOISE_SIMD
+	static unsigned const simd_width(get_noise_simd_width());
+	if      (simd_width == 8) {i = eval_noise_avx2 (use_simplex, px, py, vals, num);}
+	else if (simd_width == 4) {i = eval_noise_sse41(use_simplex, px, py, vals, num);}
+#endif
+	for (; i < num; ++i) {
+		glm::vec2 const pos(px[i], py[i]);
+		vals[i] = (use_simplex ? glm::simplex(pos) : glm::perlin(pos));
+	}
+}
+
+void noise_gen_params_t::setup(int mode_, int shape_) {
+
+	mode       = mode_;
+	shape      = shape_;
+	end_octave = (NUM_FREQ_COMP - start_eval_sin/N_RAND_SIN2);
+	xy_scale   = MESH_SCALE_FACTOR*mesh_scale;
+	hmap_scale = get_hmap_scale(mode);
 	gen_rx_ry(rx, ry);
+}
+
+void apply_octave_shape(float &noise, int shape) {
+	switch (shape) {
+	case 0: break; // linear - do nothing
+	case 1: noise = fabs(noise) - 0.40; break; // billowy
+	case 2: noise = 0.45 - fabs(noise); break; // ridged
+	//abs(0.5-abs(noise)*2.0)*2.0-0.5
+	}
+}
+
+float noise_gen_params_t::gen_noise(float xv, float yv) const {
+
+	float zval(0.0), mag(1.0), freq(1.0), rx_(rx), ry_(ry);
+	float const lacunarity(1.92), gain(0.5);
 
 	//#pragma omp parallel for schedule(static,1)
 	for (unsigned i = 0; i < end_octave; ++i) {
-		glm::vec2 const pos((freq*xv + rx), (freq*yv + ry));
-		float noise((mode == MGEN_SIMPLEX || mode == MGEN_SIMPLEX_GPU || mode == MGEN_DWARP_GPU) ? glm::simplex(pos) : glm::perlin(pos));
-		switch (shape) {
-		case 0: break; // linear - do nothing
-		case 1: noise = fabs(noise) - 0.40; break; // billowy
-		case 2: noise = 0.45 - fabs(noise); break; // ridged
-		//abs(0.5-abs(noise)*2.0)*2.0-0.5
-		}
+		glm::vec2 const pos((freq*xv + rx_), (freq*yv + ry_));
+		float noise(use_simplex() ? glm::simplex(pos) : glm::perlin(pos));
+		apply_octave_shape(noise, shape);
 		zval += mag*noise;
 		mag  *= gain;
 		freq *= lacunarity;
-		rx   *= 1.5;
-		ry   *= 1.5;
+		rx_  *= 1.5;
+		ry_  *= 1.5;
 	}
 	return zval;
 }
 
-// mode: 0=sine tables, 1=simplex, 2=perlin, 3=GPU simplex, 4=GPU domain warp
-// shape: 0=linear, 1=billowy, 2=ridged
-float get_noise_zval(float xval, float yval, int mode, int shape) {
+float noise_gen_params_t::get_noise_zval(float xval, float yval) const {
 
 	assert(mode != MGEN_SINE); // mode 0 not supported by this function
-	float const xy_scale(MESH_SCALE_FACTOR*mesh_scale);
 	float xv(xy_scale*xval), yv(xy_scale*yval);
 
 	if (mode == MGEN_DWARP_GPU) { // domain warping
 		float const scale(0.2);
-		float const dx1(gen_noise(xv+0.0, yv+0.0, mode, shape));
-		float const dy1(gen_noise(xv+5.2, yv+1.3, mode, shape));
-		float const dx2(gen_noise((xv + scale*dx1 + 1.7), (yv + scale*dy1 + 9.2), mode, shape));
-		float const dy2(gen_noise((xv + scale*dx1 + 8.3), (yv + scale*dy1 + 2.8), mode, shape));
+		float const dx1(gen_noise(xv+0.0, yv+0.0));
+		float const dy1(gen_noise(xv+5.2, yv+1.3));
+		float const dx2(gen_noise((xv + scale*dx1 + 1.7), (yv + scale*dy1 + 9.2)));
+		float const dy2(gen_noise((xv + scale*dx1 + 8.3), (yv + scale*dy1 + 2.8)));
 		xv += scale*dx2; yv += scale*dy2;
 	}
-	float zval(gen_noise(xv, yv, mode, shape));
+	float zval(gen_noise(xv, yv));
 	postproc_noise_zval(zval);
-	return zval*get_hmap_scale(mode);
+	return zval*hmap_scale;
+}
+
+// same as gen_noise() for num <= NOISE_BATCH_SIZE samples, with each octave evaluated across all samples at once
+void noise_gen_params_t::gen_noise_batch(float const *const xv, float const *const yv, float *const zvals, unsigned num) const {
+
+	assert(num <= NOISE_BATCH_SIZE);
+	float px[NOISE_BATCH_SIZE], py[NOISE_BATCH_SIZE], noise[NOISE_BATCH_SIZE];
+	float mag(1.0), freq(1.0), rx_(rx), ry_(ry);
+	float const lacunarity(1.92), gain(0.5);
+	for (unsigned n = 0; n < num; ++n) {zvals[n] = 0.0;}
+
+	for (unsigned i = 0; i < end_octave; ++i) {
+		for (unsigned n = 0; n < num; ++n) {px[n] = (freq*xv[n] + rx_); py[n] = (freq*yv[n] + ry_);}
+		eval_noise_batch(use_simplex(), px, py, noise, num);
+
+		for (unsigned n = 0; n < num; ++n) {
+			apply_octave_shape(noise[n], shape);
+			zvals[n] += mag*noise[n];
+		}
+		mag  *= gain;
+		freq *= lacunarity;
+		rx_  *= 1.5;
+		ry_  *= 1.5;
+	}
+}
+
+// same as calling get_noise_zval() for each (xvals[n], yval), but much faster; results are bit-identical
+void noise_gen_params_t::get_noise_zvals(float const *const xvals, float yval, float *const zvals, unsigned num) const {
+
+	assert(mode != MGEN_SINE); // mode 0 not supported by this function
+	float xv[NOISE_BATCH_SIZE], yv[NOISE_BATCH_SIZE], tx[NOISE_BATCH_SIZE], ty[NOISE_BATCH_SIZE];
+	float dx1[NOISE_BATCH_SIZE], dy1[NOISE_BATCH_SIZE], dx2[NOISE_BATCH_SIZE], dy2[NOISE_BATCH_SIZE];
+
+	for (unsigned s = 0; s < num; s += NOISE_BATCH_SIZE) {
+		unsigned const bnum(min(NOISE_BATCH_SIZE, (num - s)));
+		float *const bz(zvals + s);
+		for (unsigned n = 0; n < bnum; ++n) {xv[n] = xy_scale*xvals[s+n]; yv[n] = xy_scale*yval;}
+
+		if (mode == MGEN_DWARP_GPU) { // domain warping; must match get_noise_zval()
+			float const scale(0.2);
+			for (unsigned n = 0; n < bnum; ++n) {tx[n] = xv[n]+0.0; ty[n] = yv[n]+0.0;}
+			gen_noise_batch(tx, ty, dx1, bnum);
+			for (unsigned n = 0; n < bnum; ++n) {tx[n] = xv[n]+5.2; ty[n] = yv[n]+1.3;}
+			gen_noise_batch(tx, ty, dy1, bnum);
+			for (unsigned n = 0; n < bnum; ++n) {tx[n] = (xv[n] + scale*dx1[n] + 1.7); ty[n] = (yv[n] + scale*dy1[n] + 9.2);}
+			gen_noise_batch(tx, ty, dx2, bnum);
+			for (unsigned n = 0; n < bnum; ++n) {tx[n] = (xv[n] + scale*dx1[n] + 8.3); ty[n] = (yv[n] + scale*dy1[n] + 2.8);}
+			gen_noise_batch(tx, ty, dy2, bnum);
+			for (unsigned n = 0; n < bnum; ++n) {xv[n] += scale*dx2[n]; yv[n] += scale*dy2[n];}
+		}
+		gen_noise_batch(xv, yv, bz, bnum);
+
+		for (unsigned n = 0; n < bnum; ++n) {
+			postproc_noise_zval(bz[n]);
+			bz[n] *= hmap_scale;
+		}
+	} // for s
+}
+
+// mode: 0=sine tables, 1=simplex, 2=perlin, 3=GPU simplex, 4=GPU domain warp
+// shape: 0=linear, 1=billowy, 2=ridged
+// Note: slow when called per-sample since the noise params are recomputed each call; use mesh_xy_grid_cache_t for grids of samples
+float get_noise_zval(float xval, float yval, int mode, int shape) {
+	return noise_gen_params_t(mode, shape).get_noise_zval(xval, yval);
 }
 
 
@@ -757,7 +1050,7 @@ float mesh_xy_grid_cache_t::eval_index(unsigned x, unsigned y, int min_start_sin
 	}
 	else if (gen_mode != MGEN_SINE) { // perlin/simplex
 		float const xval((x*mdx + mx0)*DX_VAL_INV), yval((y*mdy + my0)*DY_VAL_INV);
-		zval += get_noise_zval(xval, yval, gen_mode, gen_shape);
+		zval += noise_params.get_noise_zval(xval, yval);
 	}
 	else { // sine tables
 		float const *const xptr(&xyterms.front() + x*F_TABLE_SIZE);
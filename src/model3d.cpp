@@ -18,17 +18,20 @@ bool const ENABLE_BUMP_MAPS  = 1;
 bool const ENABLE_SPEC_MAPS  = 1;
 bool const ENABLE_INTER_REFLECTIONS = 1;
 unsigned const MAGIC_NUMBER  = 42987143; // arbitrary file signature
+unsigned const LOD_CHAIN_MAGIC = 42987145; // optional LOD chain section appended after the materials; ignored by older readers; changed when LOD errors became cumulative
 unsigned const BLOCK_SIZE    = 32768; // in vertex indices
+unsigned const MAX_SIMP_LODS = 6; // max number of simplified LOD levels per vertex block
+unsigned const MIN_SIMP_LOD_IXS = 3*1024; // don't generate LOD chains for small vertex blocks
 
 bool model_calc_tan_vect(1); // slower and more memory but sometimes better quality/smoother transitions
 
 extern bool group_back_face_cull, enable_model3d_tex_comp, disable_shader_effects, texture_alpha_in_red_comp, use_model2d_tex_mipmaps, enable_model3d_bump_maps;
 extern bool two_sided_lighting, have_indir_smoke_tex, use_core_context, model3d_wn_normal, invert_model_nmap_bscale, use_z_prepass, all_model3d_ref_update;
-extern bool use_interior_cube_map_refl, enable_model3d_custom_mipmaps, enable_tt_model_indir, no_subdiv_model, auto_calc_tt_model_zvals, use_model_lod_blocks;
+extern bool use_interior_cube_map_refl, enable_model3d_custom_mipmaps, enable_tt_model_indir, no_subdiv_model, auto_calc_tt_model_zvals, use_model_lod_blocks, gen_model_lod_chains;
 extern bool flatten_tt_mesh_under_models, no_store_model_textures_in_memory, disable_model_textures, allow_model3d_quads, merge_model_objects;
 extern unsigned shadow_map_sz, reflection_tid;
-extern int display_mode;
-extern float model3d_alpha_thresh, model3d_texture_anisotropy, model_triplanar_tc_scale, model_mat_lod_thresh, cobj_z_bias, model_hemi_lighting_scale, light_int_scale[];
+extern int display_mode, window_height;
+extern float model_lod_pixel_error, model3d_alpha_thresh, model3d_texture_anisotropy, model_triplanar_tc_scale, model_mat_lod_thresh, cobj_z_bias, model_hemi_lighting_scale, light_int_scale[];
 extern pos_dir_up orig_camera_pdu;
 extern bool vert_opt_flags[3];
 extern vector<texture_t> textures;
@@ -501,12 +504,53 @@ template<typename T> void indexed_vntc_vect_t<T>::simplify_indices(float reduce_
 	indices.swap(simplified_indices);
 }
 
+// builds a chain of progressively simplified index buffers, each with roughly half the triangles of the previous level
+template<typename T> void indexed_vntc_vect_t<T>::gen_lod_chain(unsigned npts) {
+
+	if (npts != 3 || indices.size() < MIN_SIMP_LOD_IXS || !simp_lods.empty()) return; // triangles only, not too small, not already generated
+	float const extent(bcube.max_len()); // meshoptimizer error is relative to the max bcube dimension
+	if (extent == 0.0) return;
+	unsigned const num_verts(size());
+	float accum_error(0.0); // each level is simplified from the previous one, so errors add up
+	vector<unsigned> in(indices), out;
+
+	for (unsigned level = 0; level < MAX_SIMP_LODS; ++level) {
+		unsigned const num_ixs(in.size()), target_num_ixs(max(3U, 3*(num_ixs/6))); // half the triangles
+		float const target_error(0.005*(2 << level)); // allow more error at coarser levels
+		out.resize(num_ixs);
+		size_t const num_ixs_out(meshopt_simplify(out.data(), in.data(), num_ixs, &this->front().v.x, num_verts, sizeof(T), target_num_ixs, target_error));
+		if (num_ixs_out < 3 || 5*num_ixs_out > 4*num_ixs) break; // degenerate, or less than 20% reduction; done
+		out.resize(num_ixs_out);
+		accum_error += target_error*extent; // bound on the error of this step relative to the previous level
+		simp_lods.push_back(simp_lod_t(lod_indices.size(), num_ixs_out, accum_error)); // conservative error bound relative to the original mesh
+		vector_add_to(out, lod_indices);
+		in.swap(out);
+	}
+	if (!simp_lods.empty()) {this->clear_vbos();} // IVBO must be recreated to include lod_indices
+}
+
+// returns the simp_lods index + 1 of the lowest detail level with projected error below model_lod_pixel_error, or 0 for full detail
+template<typename T> unsigned indexed_vntc_vect_t<T>::select_simp_lod(float dist) const {
+
+	if (dist <= 0.0 || model_lod_pixel_error <= 0.0) return 0;
+	float const pixels_per_unit(window_height/(2.0*dist*tan(0.5*PERSP_ANGLE*TO_RADIANS)));
+	unsigned level(0);
+
+	for (unsigned i = 0; i < simp_lods.size(); ++i) {
+		if (simp_lods[i].error*pixels_per_unit > model_lod_pixel_error) break; // error too large
+		level = i+1;
+	}
+	return level;
+}
+
 template<typename T> void indexed_vntc_vect_t<T>::clear() {
 	
 	vntc_vect_t<T>::clear();
 	indices.clear();
 	blocks.clear();
 	lod_blocks.clear();
+	simp_lods.clear();
+	lod_indices.clear();
 	need_normalize = 0;
 }
 
@@ -578,9 +622,13 @@ template<typename T> void indexed_vntc_vect_t<T>::render(shader_t &shader, bool
 	}
 	assert(!indices.empty()); // now always using indexed drawing
 	int prim_type(GL_TRIANGLES);
-	unsigned ixn(1), ixd(1), end_ix(indices.size());
+	unsigned ixn(1), ixd(1), end_ix(indices.size()), simp_lod(0);
 
-	if (!is_shadow_pass && !lod_blocks.empty()) { // block LOD
+	if (!is_shadow_pass && !simp_lods.empty()) { // simplified LOD chain, selected by screen space error
+		float const dist(p2p_dist(camera_pdu.pos, bsphere.pos) - bsphere.radius);
+		simp_lod = select_simp_lod(dist);
+	}
+	if (!is_shadow_pass && !lod_blocks.empty() && simp_lod == 0) { // block LOD
 		float const dmin(2.0*bsphere.radius), dist(p2p_dist(camera_pdu.pos, bsphere.pos));
 
 		if (dist > dmin) { // no LOD if within the bounding sphere
@@ -604,12 +652,22 @@ template<typename T> void indexed_vntc_vect_t<T>::render(shader_t &shader, bool
 	}
 	else {
 		if (npts == 4) {prim_type = GL_QUADS;}
-		this->create_and_upload(*this, indices, is_shadow_pass, 0, 1); // dynamic_level=0, setup_pointers=1
+
+		if (!simp_lods.empty() && !this->ivbo) { // upload the LOD chain after the full detail indices
+			vector<unsigned> all_ixs(indices);
+			vector_add_to(lod_indices, all_ixs);
+			this->create_and_upload(*this, all_ixs, is_shadow_pass, 0, 1); // dynamic_level=0, setup_pointers=1
+		}
+		else {this->create_and_upload(*this, indices, is_shadow_pass, 0, 1);} // dynamic_level=0, setup_pointers=1
 	}
 	this->pre_render(is_shadow_pass);
 	check_mvm_update();
 	
-	if (is_shadow_pass || blocks.empty() || no_vfc || camera_pdu.sphere_completely_visible_test(bsphere.pos, bsphere.radius)) { // draw the entire range
+	if (simp_lod > 0) { // draw the selected simplified level; block VFC is skipped since the level is small
+		simp_lod_t const &lod(simp_lods[simp_lod-1]);
+		glDrawRangeElements(prim_type, 0, (unsigned)size(), lod.num, GL_UNSIGNED_INT, (void *)((indices.size() + lod.start_ix)*sizeof(unsigned)));
+	}
+	else if (is_shadow_pass || blocks.empty() || no_vfc || camera_pdu.sphere_completely_visible_test(bsphere.pos, bsphere.radius)) { // draw the entire range
 		glDrawRangeElements(prim_type, 0, (unsigned)size(), (unsigned)(ixn*end_ix/ixd), GL_UNSIGNED_INT, 0);
 	}
 	else { // draw each block independently
@@ -694,6 +752,20 @@ struct shared_vertex_t {
 
 template<typename T> void indexed_vntc_vect_t<T>::get_polygons(get_polygon_args_t &args, unsigned npts) const {
 
+	if (args.lod_level > 1 && !simp_lods.empty()) { // use the first precomputed level with at least the requested reduction
+		unsigned const target_num(indices.size()/args.lod_level);
+
+		for (auto l = simp_lods.begin(); l != simp_lods.end(); ++l) {
+			if (l->num > target_num && l+1 != simp_lods.end()) continue;
+			indexed_vntc_vect_t<T> simplified_this;
+			simplified_this.insert(simplified_this.begin(), begin(), end()); // copy only vertex data
+			simplified_this.indices.assign(lod_indices.begin()+l->start_ix, lod_indices.begin()+l->get_end_ix());
+			get_polygon_args_t args2(args);
+			args2.lod_level = 0;
+			simplified_this.get_polygons(args2, npts);
+			return;
+		}
+	}
 	if (args.lod_level > 1 && !indices.empty()) {
 		indexed_vntc_vect_t<T> simplified_this;
 		simplified_this.insert(simplified_this.begin(), begin(), end()); // copy only vertex data; indices will be filled in below, and other fields are unused
@@ -773,6 +845,23 @@ template<typename T> void indexed_vntc_vect_t<T>::read(istream &in) {
 	read_vector(in, indices);
 }
 
+template<typename T> void indexed_vntc_vect_t<T>::write_lod_chain(ostream &out) const {
+	write_uint(out, (unsigned)indices.size()); // for validation on read
+	write_vector(out, simp_lods);
+	write_vector(out, lod_indices);
+}
+
+template<typename T> bool indexed_vntc_vect_t<T>::read_lod_chain(istream &in) {
+
+	unsigned const num_ixs(read_uint(in));
+	read_vector(in, simp_lods);
+	read_vector(in, lod_indices);
+	if (num_ixs == indices.size() && in.good()) return 1;
+	simp_lods.clear(); // doesn't match this geometry
+	lod_indices.clear();
+	return 0;
+}
+
 
 // ************ polygon_t ************
 
@@ -901,6 +990,10 @@ template<typename T> void vntc_vect_block_t<T>::simplify_indices(float reduce_ta
 	for (auto i = begin(); i != end(); ++i) {i->simplify_indices(reduce_target);}
 }
 
+template<typename T> void vntc_vect_block_t<T>::gen_lod_chains(unsigned npts) {
+	for (auto i = begin(); i != end(); ++i) {i->gen_lod_chain(npts);}
+}
+
 template<typename T> void vntc_vect_block_t<T>::merge_into_single_vector() {
 	if (this->size() <= 1) return; // nothing to merge
 	unsigned tot_verts(0), tot_ixs(0);
@@ -938,6 +1031,20 @@ template<typename T> bool vntc_vect_block_t<T>::read(istream &in) {
 	return 1;
 }
 
+template<typename T> void vntc_vect_block_t<T>::write_lod_chains(ostream &out) const {
+
+	write_uint(out, (unsigned)this->size());
+	for (auto i = begin(); i != end(); ++i) {i->write_lod_chain(out);}
+}
+
+template<typename T> bool vntc_vect_block_t<T>::read_lod_chains(istream &in) {
+
+	if (read_uint(in) != this->size()) return 0; // blocks were merged or file is inconsistent; can't use the LOD chains
+	bool ret(1);
+	for (auto i = begin(); i != end(); ++i) {ret &= i->read_lod_chain(in);}
+	return ret;
+}
+
 
 // ************ geometry_t ************
 
@@ -1557,6 +1664,7 @@ void model3d::finalize() {
 #pragma omp parallel for schedule(dynamic)
 	for (int i = 0; i < (int)materials.size(); ++i) {materials[i].finalize();}
 	unbound_geom.finalize();
+	if (gen_model_lod_chains) {gen_lod_chains();}
 }
 
 
@@ -1642,6 +1750,14 @@ void model3d::calc_tangent_vectors() {
 	}
 }
 
+void model3d::gen_lod_chains() {
+
+	timer_t timer("Gen Model LOD Chains");
+#pragma omp parallel for schedule(dynamic)
+	for (int i = 0; i < (int)materials.size(); ++i) {materials[i].gen_lod_chains();}
+	unbound_geom.gen_lod_chains();
+}
+
 void model3d::simplify_indices(float reduce_target) {
 	for (deque<material_t>::iterator m = materials.begin(); m != materials.end(); ++m) {m->simplify_indices(reduce_target);}
 	unbound_geom.simplify_indices(reduce_target);
@@ -2100,15 +2216,8 @@ bool model3d::check_coll_line(point const &p1, point const &p2, point &cpos, vec
 	bool coll(0);
 	point cur(p2);
 
-	for (auto xf = transforms.begin(); xf != transforms.end(); ++xf) {
-		if (!check_line_clip(p1, p2, xf->get_xformed_bcube(bcube).d)) continue;
-		point p1x(p1), p2x(cur);
-		xf->inv_xform_pos(p1x);
-		xf->inv_xform_pos(p2x);
-
-		if (check_coll_line_cur_xf(p1x, p2x, cpos, cnorm, color, exact)) { // Note: only modifies cnorm and color if a collision is found
-			xf->xform_pos(cpos);
-			xf->xform_pos_rm(cnorm);
+	for (unsigned i = 0; i < transforms.size(); ++i) {
+		if (check_coll_line_instance(i, p1, cur, cpos, cnorm, color, exact, 1)) {
 			coll = 1;
 			cur  = cpos; // closer intersection point - shorten the segment
 		}
@@ -2116,6 +2225,22 @@ bool model3d::check_coll_line(point const &p1, point const &p2, point &cpos, vec
 	return coll;
 }
 
+bool model3d::check_coll_line_instance(unsigned inst_ix, point const &p1, point const &p2, point &cpos, vector3d &cnorm, colorRGBA &color, bool exact, bool build_bvh_if_needed) {
+
+	if (!build_bvh_if_needed && coll_tree.is_empty()) return 0;
+	if (transforms.empty()) {return check_coll_line_cur_xf(p1, p2, cpos, cnorm, color, exact);}
+	assert(inst_ix < transforms.size());
+	model3d_xform_t &xf(transforms[inst_ix]);
+	if (!check_line_clip(p1, p2, xf.get_xformed_bcube(bcube).d)) return 0;
+	point p1x(p1), p2x(p2);
+	xf.inv_xform_pos(p1x);
+	xf.inv_xform_pos(p2x);
+	if (!check_coll_line_cur_xf(p1x, p2x, cpos, cnorm, color, exact)) return 0; // Note: only modifies cnorm and color if a collision is found
+	xf.xform_pos(cpos);
+	xf.xform_pos_rm(cnorm);
+	return 1;
+}
+
 
 void model3d::get_all_mat_lib_fns(set<string> &mat_lib_fns) const {
 	for (deque<material_t>::const_iterator m = materials.begin(); m != materials.end(); ++m) {mat_lib_fns.insert(m->filename);}
@@ -2169,9 +2294,25 @@ bool model3d::write_to_disk(string const &fn) const { // Note: transforms not wr
 			return 0;
 		}
 	}
+	if (gen_model_lod_chains) { // optional trailing section
+		write_uint(out, LOD_CHAIN_MAGIC);
+		unbound_geom.write_lod_chains(out);
+		for (auto m = materials.begin(); m != materials.end(); ++m) {m->geom.write_lod_chains(out); m->geom_tan.write_lod_chains(out);}
+	}
 	return out.good();
 }
 
+bool model3d::read_lod_chains(istream &in) {
+
+	if (read_uint(in) != LOD_CHAIN_MAGIC) return 0; // no LOD chain section (EOF)
+	if (!unbound_geom.read_lod_chains(in)) return 0;
+
+	for (auto m = materials.begin(); m != materials.end(); ++m) {
+		if (!m->geom.read_lod_chains(in) || !m->geom_tan.read_lod_chains(in)) return 0;
+	}
+	return 1;
+}
+
 
 bool model3d::read_from_disk(string const &fn) { // Note: transforms not read
 
@@ -2202,7 +2343,9 @@ bool model3d::read_from_disk(string const &fn) { // Note: transforms not read
 		mat_map[m->name] = (m - materials.begin());
 	}
 	//simplify_indices(0.1); // TESTING
-	return in.good();
+	if (!in.good()) return 0;
+	if (!read_lod_chains(in) && gen_model_lod_chains) {gen_lod_chains();} // generate if missing or invalid; will only regenerate blocks without LODs
+	return 1;
 }
 
 
@@ -2253,6 +2396,7 @@ void model3ds::clear() {
 	for (iterator m = begin(); m != end(); ++m) {m->clear();}
 	deque<model3d>::clear();
 	tmgr.clear();
+	clear_inst_tree();
 }
 
 void model3ds::free_context() {
@@ -2352,6 +2496,7 @@ void model3ds::ensure_reflection_cube_maps() {
 void model3ds::set_xform_zval_from_tt_height(bool flatten_mesh) {
 	if (!auto_calc_tt_model_zvals) return;
 	for (iterator m = begin(); m != end(); ++m) {m->set_xform_zval_from_tt_height(flatten_mesh);}
+	clear_inst_tree(); // transforms have changed
 }
 
 bool model3ds::has_any_transforms() const {
@@ -2385,16 +2530,53 @@ unsigned model3ds::get_gpu_mem() const {
 
 void model3ds::build_cobj_trees(bool verbose) {
 	for (iterator m = begin(); m != end(); ++m) {m->build_cobj_tree(verbose);}
+	if (!inst_tree_valid()) {build_inst_tree();}
+}
+
+unsigned model3ds::get_num_instances() const {
+	unsigned num(0);
+	for (const_iterator m = begin(); m != end(); ++m) {num += m->get_num_instances();}
+	return num;
 }
 
+void model3ds::build_inst_tree() {
+
+	clear_inst_tree();
+	vector<cube_with_ix_t> &objs(inst_tree.get_objs_ref());
+
+	for (iterator m = begin(); m != end(); ++m) {
+		unsigned const model_ix(m - begin()), num_insts(m->get_num_instances());
+
+		for (unsigned i = 0; i < num_insts; ++i) {
+			objs.push_back(cube_with_ix_t(m->get_instance_bcube(i), insts.size()));
+			insts.push_back(model_inst_t(model_ix, i));
+		}
+	}
+	inst_tree.build_tree_top(0);
+}
 
 bool model3ds::check_coll_line(point const &p1, point const &p2, point &cpos, vector3d &cnorm, colorRGBA &color, bool exact, bool build_bvh_if_needed) {
 
 	bool ret(0);
 	point end_pos(p2);
+	if (build_bvh_if_needed && !inst_tree_valid()) {build_inst_tree();}
+
+	if (!inst_tree_valid()) { // no instance tree (not thread safe to build here), iterate over all models and their transforms
+		for (iterator m = begin(); m != end(); ++m) { // Note: const as long as build_bvh_if_needed=0
+			if (m->check_coll_line(p1, end_pos, cpos, cnorm, color, exact, build_bvh_if_needed)) {
+				end_pos = cpos; // advance so that we get the closest intersection point to p1
+				ret = 1;
+			}
+		}
+		return ret;
+	}
+	vector<unsigned> ixs;
+	inst_tree.get_line_isect_ixs(p1, p2, ixs);
+
+	for (auto i = ixs.begin(); i != ixs.end(); ++i) {
+		model_inst_t const &inst(insts[*i]);
 
-	for (iterator m = begin(); m != end(); ++m) { // Note: const as long as build_bvh_if_needed=0
-		if (m->check_coll_line(p1, end_pos, cpos, cnorm, color, exact, build_bvh_if_needed)) {
+		if ((*this)[inst.model_ix].check_coll_line_instance(inst.inst_ix, p1, end_pos, cpos, cnorm, color, exact, build_bvh_if_needed)) {
 			end_pos = cpos; // advance so that we get the closest intersection point to p1
 			ret = 1;
 		}
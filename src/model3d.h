@@ -277,6 +277,17 @@ private:
 	vector<lod_block_t> lod_blocks;
 	unsigned get_block_ix(float area) const;
 
+	struct simp_lod_t { // one level of the simplified LOD chain; indices are stored in lod_indices
+		unsigned start_ix, num;
+		float error; // geometric error bound in model space
+		simp_lod_t() : start_ix(0), num(0), error(0.0) {}
+		simp_lod_t(unsigned s, unsigned n, float e) : start_ix(s), num(n), error(e) {}
+		unsigned get_end_ix() const {return (start_ix + num);}
+	};
+	vector<simp_lod_t> simp_lods; // ordered from highest to lowest detail
+	vector<unsigned> lod_indices; // concatenated simplified index buffers, uploaded to the IVBO after indices
+	unsigned select_simp_lod(float dist) const;
+
 public:
 	using vntc_vect_t<T>::size;
 	using vntc_vect_t<T>::empty;
@@ -303,6 +314,8 @@ public:
 	void simplify(vector<unsigned> &out, float target) const;
 	void simplify_meshoptimizer(vector<unsigned> &out, float target) const;
 	void simplify_indices(float reduce_target);
+	void gen_lod_chain(unsigned npts);
+	bool has_lod_chain() const {return !simp_lods.empty();}
 	void clear();
 	unsigned num_verts() const {return unsigned(indices.empty() ? size() : indices.size());}
 	T       &get_vert(unsigned i)       {return (*this)[indices.empty() ? i : indices[i]];}
@@ -315,6 +328,8 @@ public:
 	void invert_tcy();
 	void write(ostream &out) const;
 	void read(istream &in);
+	void write_lod_chain(ostream &out) const;
+	bool read_lod_chain(istream &in);
 	bool indexing_enabled() const {return !indices.empty();}
 	void mark_need_normalize() {need_normalize = 1;}
 };
@@ -338,9 +353,12 @@ template<typename T> struct vntc_vect_block_t : public deque<indexed_vntc_vect_t
 	void get_polygons(get_polygon_args_t &args, unsigned npts) const;
 	void invert_tcy();
 	void simplify_indices(float reduce_target);
+	void gen_lod_chains(unsigned npts);
 	void merge_into_single_vector();
 	bool write(ostream &out) const;
 	bool read(istream &in);
+	void write_lod_chains(ostream &out) const;
+	bool read_lod_chains(istream &in);
 };
 
 
@@ -365,8 +383,11 @@ template<typename T> struct geometry_t {
 	void get_stats(model3d_stats_t &stats) const;
 	void calc_area(float &area, unsigned &ntris);
 	void simplify_indices(float reduce_target);
+	void gen_lod_chains() {triangles.gen_lod_chains(3);} // mesh simplification only applies to triangles, not quads
 	bool write(ostream &out) const {return (triangles.write(out) && quads.write(out));}
 	bool read(istream &in)         {return (triangles.read (in ) && quads.read (in ));}
+	void write_lod_chains(ostream &out) const {triangles.write_lod_chains(out);}
+	bool read_lod_chains(istream &in)         {return triangles.read_lod_chains(in);}
 };
 
 
@@ -437,6 +458,7 @@ struct material_t : public material_params_t {
 	bool is_partial_transparent() const {return (alpha < 1.0 || get_needs_alpha_test());}
 	void compute_area_per_tri();
 	void simplify_indices(float reduce_target);
+	void gen_lod_chains() {geom.gen_lod_chains(); geom_tan.gen_lod_chains();}
 	void ensure_textures_loaded(texture_manager &tmgr);
 	void init_textures(texture_manager &tmgr);
 	void check_for_tc_invert_y(texture_manager &tmgr);
@@ -543,6 +565,7 @@ public:
 	void bind_all_used_tids();
 	void calc_tangent_vectors();
 	void simplify_indices(float reduce_target);
+	void gen_lod_chains();
 	static void bind_default_flat_normal_map() {select_multitex(FLAT_NMAP_TEX, 5);}
 	void set_sky_lighting_file(string const &fn, float weight, unsigned sz[3]);
 	void set_occlusion_cube(cube_t const &cube) {occlusion_cube = cube;}
@@ -571,6 +594,9 @@ public:
 	void build_cobj_tree(bool verbose);
 	bool check_coll_line_cur_xf(point const &p1, point const &p2, point &cpos, vector3d &cnorm, colorRGBA &color, bool exact);
 	bool check_coll_line(point const &p1, point const &p2, point &cpos, vector3d &cnorm, colorRGBA &color, bool exact, bool build_bvh_if_needed=0);
+	bool check_coll_line_instance(unsigned inst_ix, point const &p1, point const &p2, point &cpos, vector3d &cnorm, colorRGBA &color, bool exact, bool build_bvh_if_needed=0);
+	unsigned get_num_instances() const {return max((unsigned)transforms.size(), 1U);} // the untransformed model counts as one instance
+	cube_t const &get_instance_bcube(unsigned inst_ix) {return (transforms.empty() ? bcube : transforms[inst_ix].get_xformed_bcube(bcube));}
 	bool get_needs_alpha_test() const {return needs_alpha_test;}
 	bool get_needs_bump_maps () const {return needs_bump_maps;}
 	bool uses_spec_map()        const {return has_spec_maps;}
@@ -584,6 +610,7 @@ public:
 	void get_all_mat_lib_fns(set<std::string> &mat_lib_fns) const;
 	bool write_to_disk (string const &fn) const;
 	bool read_from_disk(string const &fn);
+	bool read_lod_chains(istream &in);
 	static void proc_model_normals(vector<counted_normal> &cn, int recalc_normals, float nmag_thresh=0.7);
 	static void proc_model_normals(vector<weighted_normal> &wn, int recalc_normals, float nmag_thresh=0.7);
 	void write_to_cobj_file(std::ostream &out) const;
@@ -594,6 +621,19 @@ struct model3ds : public deque<model3d> {
 
 	texture_manager tmgr;
 
+private:
+	struct model_inst_t {
+		unsigned model_ix, inst_ix;
+		model_inst_t(unsigned m, unsigned i) : model_ix(m), inst_ix(i) {}
+	};
+	cobj_tree_cube_ix_t inst_tree; // top level BVH over transformed model instance bcubes; bottom levels are the per-model coll_trees
+	vector<model_inst_t> insts;
+
+	unsigned get_num_instances() const;
+	bool inst_tree_valid() const {return (!inst_tree.is_empty() && insts.size() == get_num_instances());}
+	void build_inst_tree();
+	void clear_inst_tree() {inst_tree.clear(); insts.clear();}
+public:
 	void clear();
 	void free_context();
 	void render(bool is_shadow_pass, int reflection_pass, int trans_op_mask, vector3d const &xlate); // non-const
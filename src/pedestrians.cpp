@@ -3,11 +3,15 @@
 // 12/6/18
 #include "city.h"
 #include "shaders.h"
+#include <cfloat>
 
 float const PED_WIDTH_SCALE  = 0.5; // ratio of collision radius to model radius (x/y)
 float const PED_HEIGHT_SCALE = 2.5; // ratio of collision radius to model height (z)
 float const CROSS_SPEED_MULT = 1.8; // extra speed multiplier when crossing the road
 float const CROSS_WAIT_TIME  = 60.0; // in seconds
+unsigned const MIN_PEDS_FOR_THREADS = 1024; // update peds in parallel when there are at least this many
+float const PED_AVOID_EXPAND = 1.1; // avoid cube expansion relative to ped radius; slightly larger than 1.0 to leave some room for floating-point error
+float const PED_PATH_GAP     = 0.1; // path finding gap around avoid cubes relative to ped radius
 bool const FORCE_USE_CROSSWALKS = 0; // more realistic and safe, but causes problems with pedestian collisions
 
 extern bool tt_fire_button_down;
@@ -51,7 +55,7 @@ float get_sidewalk_width(cube_t const &plot_bcube) { // Note: technically should
 	return -STREETLIGHT_DIST_FROM_PLOT_EDGE*plot_sz + streetlight_ns::get_streetlight_pole_radius();
 }
 
-bool pedestrian_t::check_inside_plot(ped_manager_t &ped_mgr, point const &prev_pos, cube_t const &plot_bcube, cube_t const &next_plot_bcube) {
+bool pedestrian_t::check_inside_plot(ped_manager_t const &ped_mgr, point const &prev_pos, cube_t const &plot_bcube, cube_t const &next_plot_bcube) {
 	if (in_building) return 0; // not implemented yet
 	//if (ssn == 2516) {cout << "in_the_road: " << in_the_road << ", pos: " << pos.str() << ", plot_bcube: " << plot_bcube.str() << ", npbc: " << next_plot_bcube.str() << endl;}
 	if (plot_bcube.contains_pt_xy(pos)) {return 1;} // inside the plot
@@ -59,7 +63,7 @@ bool pedestrian_t::check_inside_plot(ped_manager_t &ped_mgr, point const &prev_p
 	if (next_plot == plot) return 0; // no next plot - clip to this plot
 	
 	if (next_plot_bcube.contains_pt_xy(pos)) {
-		ped_mgr.move_ped_to_next_plot(*this);
+		plot      = next_plot; // ped_mgr plot counts are updated after the parallel update
 		next_plot = ped_mgr.get_next_plot(*this);
 		return 1;
 	}
@@ -119,20 +123,19 @@ bool pedestrian_t::is_valid_pos(vect_cube_t const &colliders, bool &ped_at_dest,
 	return 1;
 }
 
-void register_ped_coll(pedestrian_t &p1, pedestrian_t &p2, unsigned pid1, unsigned pid2) {
-	p1.collided = p1.ped_coll = 1; p1.colliding_ped = pid2;
-	p2.collided = p2.ped_coll = 1; p2.colliding_ped = pid1;
-}
-
-bool pedestrian_t::check_ped_ped_coll_range(vector<pedestrian_t> &peds, unsigned pid, unsigned ped_start, unsigned target_plot, float prox_radius, vector3d &force) {
+// Note: reads other peds from prev_state and only modifies this ped, so that peds can be updated in parallel and in any order;
+// each ped of a colliding pair detects the collision on its own since both sides test each other
+bool pedestrian_t::check_ped_ped_coll_range(vector<ped_coll_state_t> const &prev_state, unsigned pid, unsigned ped_start, unsigned target_plot, float prox_radius, vector3d &force) {
 	float const prox_radius_sq(prox_radius*prox_radius);
 
-	for (auto i = peds.begin()+ped_start; i != peds.end(); ++i) { // check every ped until we exit target_plot
+	for (auto i = prev_state.begin()+ped_start; i != prev_state.end(); ++i) { // check every ped until we exit target_plot
 		if (i->plot != target_plot) break; // moved to a new plot, no collision, done; since plots are globally unique across cities, we don't need to check cities
+		unsigned const ix(i - prev_state.begin());
+		if (ix == pid) continue; // skip self
 		float const dist_sq(p2p_dist_xy_sq(pos, i->pos));
 		if (dist_sq > prox_radius_sq) continue; // proximity test
 		float const r_sum(0.6f*(radius + i->radius)); // using a smaller radius to allow peds to get close to each other
-		if (dist_sq < r_sum*r_sum) {register_ped_coll(*this, *i, pid, (i - peds.begin())); return 1;} // collision
+		if (dist_sq < r_sum*r_sum) {ped_coll = 1; colliding_ped = ix; return 1;} // collision
 		if (speed < TOLERANCE) continue;
 		vector3d const delta_v(vel - i->vel), delta_p((pos.x - i->pos.x), (pos.y - i->pos.y), 0.0);
 		float const dp(-dot_product_xy(delta_v, delta_p));
@@ -149,38 +152,25 @@ bool pedestrian_t::check_ped_ped_coll_range(vector<pedestrian_t> &peds, unsigned
 	return 0;
 }
 
-bool pedestrian_t::check_ped_ped_coll(ped_manager_t const &ped_mgr, vector<pedestrian_t> &peds, unsigned pid, float delta_dir) {
+bool pedestrian_t::check_ped_ped_coll(ped_manager_t const &ped_mgr, vector<ped_coll_state_t> const &prev_state, unsigned pid, float delta_dir) {
 	if (in_building) return 0; // no ped-ped collisions in buildings (yet)
-	assert(pid < peds.size());
+	assert(pid < prev_state.size());
 	float const timestep(2.0*TICKS_PER_SECOND), lookahead_dist(timestep*speed); // how far we can travel in 2s
 	float const prox_radius(1.2*radius + lookahead_dist); // assume other ped has a similar radius
 	vector3d force(zero_vector);
-	if (check_ped_ped_coll_range(peds, pid, pid+1, plot, prox_radius, force)) return 1;
+	// peds are sorted by plot and prev_state is in the same order, so scan every ped that started this frame in our plot (which may have just changed)
+	if (check_ped_ped_coll_range(prev_state, pid, ped_mgr.get_first_ped_at_plot(plot), plot, prox_radius, force)) return 1;
 
 	if (in_the_road && next_plot != plot) {
 		// need to check for coll between two peds crossing the street from different sides, since they won't be in the same plot while in the street
 		unsigned const ped_ix(ped_mgr.get_first_ped_at_plot(next_plot));
-		assert(ped_ix <= peds.size()); // could be at the end
-		if (check_ped_ped_coll_range(peds, pid, ped_ix, next_plot, prox_radius, force)) return 1;
+		assert(ped_ix <= prev_state.size()); // could be at the end
+		if (check_ped_ped_coll_range(prev_state, pid, ped_ix, next_plot, prox_radius, force)) return 1;
 	}
 	if (force != zero_vector) {set_velocity((0.1*delta_dir)*force + ((1.0 - delta_dir)/speed)*vel);} // apply ped repulsive force
 	return 0;
 }
 
-bool pedestrian_t::check_ped_ped_coll_stopped(vector<pedestrian_t> &peds, unsigned pid) {
-	if (in_building) return 0; // no ped-ped collisions in buildings (yet)
-	assert(pid < peds.size());
-
-	// Note: shouldn't have to check peds in the next plot, assuming that if we're stopped, they likely are as well, and won't be walking toward us
-	for (auto i = peds.begin()+pid+1; i != peds.end(); ++i) { // check every ped until we exit target_plot
-		if (i->plot != plot) break; // moved to a new plot, no collision, done; since plots are globally unique across cities, we don't need to check cities
-		if (!dist_xy_less_than(pos, i->pos, 0.6f*(radius + i->radius))) continue; // no collision
-		i->collided = i->ped_coll = 1; i->colliding_ped = pid;
-		return 1; // Note: could omit this return and continue processing peds
-	} // for i
-	return 0;
-}
-
 bool pedestrian_t::try_place_in_plot(cube_t const &plot_cube, vect_cube_t const &colliders, unsigned plot_id, rand_gen_t &rgen) {
 	pos    = rand_xy_pt_in_cube(plot_cube, radius, rgen);
 	pos.z += radius; // place on top of the plot
@@ -331,9 +321,114 @@ bool path_finder_t::find_best_path() {
 	return found_path();
 }
 
+// ped_nav_graph_t
+void ped_nav_graph_t::build(vect_cube_t const &cubes_, float gap) {
+	cubes = cubes_;
+	nodes.clear();
+	edge_start.clear();
+	edges.clear();
+
+	for (auto c = cubes.begin(); c != cubes.end(); ++c) {
+		cube_t ec(*c);
+		ec.expand_by_xy(gap);
+		point const corners[4] = {point(ec.x1(), ec.y1(), 0.0), point(ec.x1(), ec.y2(), 0.0), point(ec.x2(), ec.y2(), 0.0), point(ec.x2(), ec.y1(), 0.0)};
+
+		for (unsigned n = 0; n < 4; ++n) {
+			if (!any_cube_contains_pt_xy(cubes, corners[n])) {nodes.push_back(corners[n]);} // skip corners blocked by another cube
+		}
+	}
+	unsigned const num(nodes.size());
+	vector<uint8_t> visible(num*num, 0);
+
+	for (unsigned i = 0; i < num; ++i) { // Note: O(n^2*m), but only done once per plot
+		for (unsigned j = i+1; j < num; ++j) {visible[i*num + j] = visible[j*num + i] = !line_int_cubes_xy(nodes[i], nodes[j], cubes);}
+	}
+	for (unsigned i = 0; i < num; ++i) {
+		edge_start.push_back(edges.size());
+
+		for (unsigned j = 0; j < num; ++j) {
+			if (visible[i*num + j]) {edges.emplace_back(j, p2p_dist_xy(nodes[i], nodes[j]));}
+		}
+	}
+	edge_start.push_back(edges.size()); // terminator
+}
+
+// path_finder_t nav graph queries: nodes [0, num_nodes) are graph nodes, num_nodes is pos, and num_nodes+1 is dest
+void path_finder_t::extract_graph_path(ped_nav_graph_t const &graph, unsigned end_node, path_t &path) const {
+	unsigned const num(graph.num_nodes());
+	path.clear();
+
+	for (unsigned n = end_node; n != num; n = node_prev[n]) { // walk back to pos
+		assert(n < node_prev.size());
+		path.push_back((n == num+1) ? dest : point(graph.nodes[n].x, graph.nodes[n].y, pos.z));
+	}
+	path.push_back(pos);
+	reverse(path.begin(), path.end());
+	path.calc_length();
+}
+
+bool path_finder_t::find_best_path_graph(ped_nav_graph_t const &graph) {
+	unsigned const num(graph.num_nodes()), start(num), goal(num+1);
+	best_path.clear();
+	partial_path.clear();
+	open.clear();
+	node_dist.assign(num+2, FLT_MAX);
+	node_prev.assign(num+2, start);
+	node_closed.assign(num+2, 0);
+	node_dist[start] = 0.0;
+	open.emplace_back(p2p_dist_xy(pos, dest), start);
+	unsigned best_partial(start);
+	float best_partial_len(FLT_MAX);
+
+	while (!open.empty()) {
+		pop_heap(open.begin(), open.end());
+		unsigned const cur(open.back().node);
+		open.pop_back();
+		if (node_closed[cur]) continue; // stale entry
+		node_closed[cur] = 1;
+		if (cur == goal) break; // done
+		point const cur_pt((cur == start) ? pos : point(graph.nodes[cur].x, graph.nodes[cur].y, pos.z));
+		float const cur_dist(node_dist[cur]);
+
+		if (cur != start) {
+			// track the best partial path using the same metric as find_best_path_recur(): length plus twice the distance we're short
+			float const partial_len(cur_dist + 2.0*p2p_dist_xy(cur_pt, dest));
+			if (partial_len < best_partial_len) {best_partial_len = partial_len; best_partial = cur;}
+		}
+		auto add_cand = [&](unsigned n, float len) {
+			float const dist(cur_dist + len);
+			if (node_closed[n] || dist >= node_dist[n]) return;
+			node_dist[n] = dist;
+			node_prev[n] = cur;
+			open.emplace_back((dist + ((n == goal) ? 0.0f : p2p_dist_xy(graph.nodes[n], dest))), n);
+			push_heap(open.begin(), open.end());
+		};
+		// the graph doesn't include pos or dest, and the ped's avoid cubes may differ from the graph's (dest cube removed), so check their visibility here
+		if (!line_int_cubes_xy(cur_pt, dest, avoid)) {add_cand(goal, p2p_dist_xy(cur_pt, dest));}
+
+		if (cur == start) {
+			for (unsigned n = 0; n < num; ++n) {
+				point const &p(graph.nodes[n]);
+				if (!plot_bcube.contains_pt_xy(p) || line_int_cubes_xy(pos, point(p.x, p.y, pos.z), avoid)) continue;
+				add_cand(n, p2p_dist_xy(pos, p));
+			}
+		}
+		else {
+			for (unsigned e = graph.edge_start[cur]; e < graph.edge_start[cur+1]; ++e) {
+				ped_nav_graph_t::edge_t const &edge(graph.edges[e]);
+				if (plot_bcube.contains_pt_xy(graph.nodes[edge.node])) {add_cand(edge.node, edge.len);} // skip nodes outside the plot
+			}
+		}
+	} // end while
+	if (node_closed[goal]) {extract_graph_path(graph, goal, best_path);}
+	else if (best_partial != start) {extract_graph_path(graph, best_partial, partial_path);}
+	return found_path();
+}
+
 // Note: avoid must be non-overlapping and should be non-adjacent; even better if cubes are separated enough that peds can pass between them (> 2*ped radius)
+// if graph is non-null, it's used for path finding in place of the recursive search; its cubes should be a superset of avoid, excluding the dest building or car
 // return values: 0=failed, 1=valid path, 2=init contained, 3=straight path (no collisions)
-unsigned path_finder_t::run(point const &pos_, point const &dest_, cube_t const &plot_bcube_, float gap_, point &new_dest) {
+unsigned path_finder_t::run(point const &pos_, point const &dest_, cube_t const &plot_bcube_, float gap_, point &new_dest, ped_nav_graph_t const *const graph) {
 	if (!line_int_cubes_xy(pos_, dest_, avoid)) return 3; // no work to be done, leave dest as it is
 	pos = pos_; dest = dest_; plot_bcube = plot_bcube_; gap = gap_;
 	//if (any_cube_contains_pt_xy(avoid, dest)) return 0; // invalid dest pos - ignore for now and let path finding deal with it when we get to that pos
@@ -368,7 +463,7 @@ unsigned path_finder_t::run(point const &pos_, point const &dest_, cube_t const
 			}
 		} // for i
 	}
-	if (!find_best_path()) return 0; // if we fail to find a path, leave new_dest unchanged
+	if (!(graph ? find_best_path_graph(*graph) : find_best_path())) return 0; // if we fail to find a path, leave new_dest unchanged
 	vector<point> const &path(get_best_path());
 	assert(next_pt_ix < path.size());
 	new_dest = path[next_pt_ix]; // set dest to next point on the best path
@@ -433,7 +528,7 @@ void pedestrian_t::get_avoid_cubes(ped_manager_t const &ped_mgr, vect_cube_t con
 	avoid.clear();
 	if (in_building) return; // not yet implemented, but if it was we would get the nearby building walls, objects, etc.
 	get_building_bcubes(ped_mgr.get_city_plot_bcube_for_peds(city, plot), avoid);
-	float const expand(1.1*radius); // slightly larger than radius to leave some room for floating-point error
+	float const expand(PED_AVOID_EXPAND*radius);
 	expand_cubes_by_xy(avoid, expand); // expand building cubes in x and y to approximate a cylinder collision (conservative)
 	//remove_cube_if_contains_pt_xy(avoid, pos); // init coll cases (for example from previous dest_bldg) are handled by path_finder_t
 	if (plot == dest_plot && has_dest_bldg) {remove_cube_if_contains_pt_xy(avoid, dest_pos);} // exclude our dest building, we do want to collide with it
@@ -475,18 +570,10 @@ void pedestrian_t::move(ped_manager_t const &ped_mgr, cube_t const &plot_bcube,
 	anim_time += timestep*speed;
 }
 
-void pedestrian_t::next_frame(ped_manager_t &ped_mgr, vector<pedestrian_t> &peds, unsigned pid, rand_gen_t &rgen, float delta_dir) {
-	if (destroyed)    return; // destroyed
-	if (speed == 0.0) return; // not moving, no update needed
-	if (in_building)  return; // building update/movement logic handled elsewhere
-
-	// navigation with destination
-	if (at_dest) {
-		register_at_dest();
-		ped_mgr.choose_new_ped_plot_pos(*this);
-	}
-	if (at_crosswalk) {ped_mgr.mark_crosswalk_in_use(*this);}
-	// movement logic
+// Note: may be called in parallel for different peds; only modifies this ped, and reads other peds from prev_state
+void pedestrian_t::next_frame(ped_manager_t const &ped_mgr, vector<ped_coll_state_t> const &prev_state, path_finder_t &path_finder, unsigned pid, rand_gen_t &rgen, float delta_dir) {
+	if (!needs_update()) return;
+	// movement logic; navigation with destination and crosswalk state were handled serially by ped_mgr
 	cube_t const &plot_bcube(ped_mgr.get_city_plot_bcube_for_peds(city, plot));
 	cube_t const &next_plot_bcube(ped_mgr.get_city_plot_bcube_for_peds(city, next_plot));
 	point const prev_pos(pos); // assume this ped starts out not colliding
@@ -497,8 +584,7 @@ void pedestrian_t::next_frame(ped_manager_t &ped_mgr, vector<pedestrian_t> &peds
 			target_pos = all_zeros;
 			go(); // back up or turn so that we don't walk forward into the street? move() should attempt to rotate in place
 		}
-		else {
-			check_ped_ped_coll_stopped(peds, pid); // still need to check for other peds colliding with us; this doesn't always work
+		else { // other peds check for collisions with us using prev_state
 			collided = ped_coll = 0;
 			return;
 		}
@@ -507,11 +593,10 @@ void pedestrian_t::next_frame(ped_manager_t &ped_mgr, vector<pedestrian_t> &peds
 	vect_cube_t const &colliders(ped_mgr.get_colliders_for_plot(city, plot));
 	bool outside_plot(0);
 
-	if (collided) {} // already collided with a previous ped this frame, handled below
-	else if (!check_inside_plot(ped_mgr, prev_pos, plot_bcube, next_plot_bcube)) {collided = outside_plot = 1;} // outside the plot, treat as a collision with the plot bounds
+	if (!check_inside_plot(ped_mgr, prev_pos, plot_bcube, next_plot_bcube)) {collided = outside_plot = 1;} // outside the plot, treat as a collision with the plot bounds
 	else if (!is_valid_pos(colliders, at_dest, &ped_mgr)) {collided = 1;} // collided with a static collider
 	else if (check_road_coll(ped_mgr, plot_bcube, next_plot_bcube)) {collided = 1;} // collided with something in the road (stoplight, streetlight, etc.)
-	else if (check_ped_ped_coll(ped_mgr, peds, pid, delta_dir)) {collided = 1;} // collided with another pedestrian
+	else if (check_ped_ped_coll(ped_mgr, prev_state, pid, delta_dir)) {collided = 1;} // collided with another pedestrian
 	else { // no collisions
 		//cout << TXT(pid) << TXT(plot) << TXT(dest_plot) << TXT(next_plot) << TXT(at_dest) << TXT(delta_dir) << TXT((unsigned)stuck_count) << TXT(collided) << endl;
 		vector3d dest_pos(get_dest_pos(plot_bcube, next_plot_bcube, ped_mgr));
@@ -526,12 +611,12 @@ void pedestrian_t::next_frame(ped_manager_t &ped_mgr, vector<pedestrian_t> &peds
 			}
 			// run only every several frames to reduce runtime; also run when at dest and when close to the current target pos or at the destination
 			if (at_dest || update_path) {
-				get_avoid_cubes(ped_mgr, colliders, dest_pos, ped_mgr.path_finder.get_avoid_vector());
+				get_avoid_cubes(ped_mgr, colliders, dest_pos, path_finder.get_avoid_vector());
 				target_pos = all_zeros;
 				cube_t union_plot_bcube(plot_bcube);
 				union_plot_bcube.union_with_cube(next_plot_bcube); // this is the area the ped is constrained to (both plots + road in between)
 				// run path finding between pos and dest_pos using avoid cubes
-				if (ped_mgr.path_finder.run(pos, dest_pos, union_plot_bcube, 0.1*radius, dest_pos)) {target_pos = dest_pos;}
+				if (path_finder.run(pos, dest_pos, union_plot_bcube, PED_PATH_GAP*radius, dest_pos, &ped_mgr.get_nav_graph(*this))) {target_pos = dest_pos;}
 			}
 			else if (target_valid()) {dest_pos = target_pos;} // use previous frame's dest if valid
 			vector3d dest_dir((dest_pos.x - pos.x), (dest_pos.y - pos.y), 0.0); // zval=0, not normalized
@@ -561,8 +646,8 @@ void pedestrian_t::next_frame(ped_manager_t &ped_mgr, vector<pedestrian_t> &peds
 			else {pos += rgen.signed_rand_vector_spherical_xy()*(0.1*radius); } // shift randomly by 10% radius to get unstuck
 		}
 		if (ped_coll) {
-			assert(colliding_ped < peds.size());
-			vector3d const coll_dir(peds[colliding_ped].pos - pos);
+			assert(colliding_ped < prev_state.size());
+			vector3d const coll_dir(prev_state[colliding_ped].pos - pos);
 			new_dir = cross_product(vel, plus_z);
 			if (dot_product_xy(new_dir, coll_dir) > 0.0) {new_dir = -new_dir;} // orient away from the other ped
 		}
@@ -665,6 +750,34 @@ void ped_manager_t::init(unsigned num_city, unsigned num_building) {
 	} // for i
 	cout << "City Pedestrians: " << peds.size() << ", Building Residents: " << peds_b.size() << endl; // testing
 	sort_by_city_and_plot();
+	clear_nav_graphs(); // buildings and plot colliders are final at this point
+}
+
+// Note: thread safe; graphs are built the first time they're needed and never modified after that
+ped_nav_graph_t const &ped_manager_t::get_nav_graph(pedestrian_t const &ped) const {
+	uint32_t radius_bits(0);
+	memcpy(&radius_bits, &ped.radius, sizeof(uint32_t)); // radius depends on the ped model
+	uint64_t const key((uint64_t(ped.plot) << 32) | radius_bits);
+	ped_nav_graph_t const *graph(nullptr);
+
+#pragma omp critical(ped_nav_graph)
+	{
+		auto it(nav_graphs.find(key));
+
+		if (it == nav_graphs.end()) { // build it; should be fast and only done once per plot, so it's okay to hold the lock
+			vect_cube_t avoid;
+			get_building_bcubes(get_city_plot_bcube_for_peds(ped.city, ped.plot), avoid);
+			float const expand(PED_AVOID_EXPAND*ped.radius);
+			expand_cubes_by_xy(avoid, expand); // same as pedestrian_t::get_avoid_cubes(), but without removing the dest building/car
+			size_t const num_building_cubes(avoid.size());
+			vector_add_to(get_colliders_for_plot(ped.city, ped.plot), avoid);
+			for (auto i = avoid.begin()+num_building_cubes; i != avoid.end(); ++i) {i->expand_by_xy(expand);}
+			it = nav_graphs.insert(make_pair(key, ped_nav_graph_t())).first;
+			it->second.build(avoid, PED_PATH_GAP*ped.radius);
+		}
+		graph = &it->second;
+	}
+	return *graph;
 }
 
 void ped_manager_t::assign_ped_model(pedestrian_t &ped) { // Note: non-const, modifies rgen
@@ -700,7 +813,7 @@ void ped_manager_t::sort_by_city_and_plot() {
 		for (unsigned city = 0; city+1 < by_city.size(); ++city) {
 			if (!need_to_sort_city[city]) continue;
 			need_to_sort_city[city] = 0;
-			sort((peds.begin() + by_plot[by_city[city].plot_ix]), (peds.begin() + by_plot[by_city[city+1].plot_ix]), ped_by_plot());
+			resort_mostly_sorted(peds, by_plot[by_city[city].plot_ix], by_plot[by_city[city+1].plot_ix], ped_by_plot(), resort_temp); // only a few peds changed plots
 		}
 	}
 	// construct by_plot
@@ -792,11 +905,6 @@ void ped_manager_t::register_ped_new_plot(pedestrian_t const &ped) {
 	if (!need_to_sort_city.empty()) {need_to_sort_city[ped.city] = 1;}
 	need_to_sort_peds = 1;
 }
-void ped_manager_t::move_ped_to_next_plot(pedestrian_t &ped) {
-	if (ped.next_plot == ped.plot) return; // already there (error?)
-	ped.plot = ped.next_plot; // assumes plot is adjacent; doesn't actually do any moving, only registers the move
-	register_ped_new_plot(ped);
-}
 
 void ped_manager_t::next_frame() {
 	if (!animate2) return; // nothing to do (only applies to moving peds)
@@ -815,7 +923,35 @@ void ped_manager_t::next_frame() {
 		if (first_frame) { // choose initial ped destinations (must be after building setup, etc.)
 			for (auto i = peds.begin(); i != peds.end(); ++i) {choose_dest_building_or_parked_car(*i);}
 		}
-		for (auto i = peds.begin(); i != peds.end(); ++i) {i->next_frame(*this, peds, (i - peds.begin()), rgen, delta_dir);}
+		// serial pass: handle the parts of the update that modify shared ped_mgr state (dest selection, crosswalks)
+		for (auto i = peds.begin(); i != peds.end(); ++i) {
+			if (!i->needs_update()) continue;
+			if (i->at_dest) {i->register_at_dest(); choose_new_ped_plot_pos(*i);}
+			if (i->at_crosswalk) {mark_crosswalk_in_use(*i);}
+		}
+		// capture the state other peds read for collisions so that the parallel update doesn't depend on update order or thread count
+		prev_state.clear();
+		for (auto i = peds.begin(); i != peds.end(); ++i) {prev_state.emplace_back(*i);}
+		path_finders.resize(omp_get_max_threads_3dw());
+		assert(by_plot.size() >= 2 && by_plot.back() == peds.size()); // peds must be sorted
+		int const num_plots(by_plot.size() - 1);
+		unsigned const rand_seed(frame_counter + 1);
+
+		// parallel pass: peds are sorted by plot, and each plot's peds are updated by one thread; each ped has its own rand seed
+#pragma omp parallel for schedule(dynamic,4) if (peds.size() >= MIN_PEDS_FOR_THREADS)
+		for (int plot = 0; plot < num_plots; ++plot) {
+			path_finder_t &path_finder(path_finders[omp_get_thread_num_3dw()]);
+
+			for (unsigned pid = by_plot[plot]; pid < by_plot[plot+1]; ++pid) {
+				rand_gen_t ped_rgen;
+				ped_rgen.set_state(pid+1, rand_seed);
+				peds[pid].next_frame(*this, prev_state, path_finder, pid, ped_rgen, delta_dir);
+			}
+		} // for plot
+		// serial pass: register plot changes
+		for (unsigned i = 0; i < peds.size(); ++i) {
+			if (peds[i].plot != prev_state[i].plot) {register_ped_new_plot(peds[i]);}
+		}
 		if (need_to_sort_peds) {sort_by_city_and_plot();}
 		first_frame = 0;
 	}
@@ -966,7 +1102,7 @@ void pedestrian_t::debug_draw(ped_manager_t &ped_mgr) const {
 	cube_t union_plot_bcube(plot_bcube);
 	union_plot_bcube.union_with_cube(next_plot_bcube);
 	vector<point> path;
-	unsigned const ret(path_finder.run(pos, dest_pos, union_plot_bcube, 0.05*radius, dest_pos)); // 0=no path, 1=standard path, 2=init intersection path
+	unsigned const ret(path_finder.run(pos, dest_pos, union_plot_bcube, PED_PATH_GAP*radius, dest_pos, &ped_mgr.get_nav_graph(*this))); // 0=no path, 1=standard path, 2=init intersection path
 	if (ret == 0) return; // no path found
 	bool const at_dest_plot(plot == dest_plot), complete(path_finder.found_complete_path());
 	colorRGBA line_color(at_dest_plot ? RED : YELLOW); // paths
@@ -270,6 +270,7 @@ class vert_coll_detector {
 
 	bool safe_norm_div(float rad, float radius, vector3d &norm);
 	void check_cobj_intersect(int index, bool enable_cfs, bool player_step);
+	void check_voxel_field_coll();
 	void init_reset_pos();
 public:
 	vert_coll_detector(dwobject &obj_, int obj_index_, int do_coll_funcs_, int iter_, vector3d *cnorm_,
@@ -3,6 +3,7 @@
 // 11/20/18
 #include "city.h"
 #include "lightmap.h"
+#include <cfloat> // for FLT_MAX
 
 float const STREETLIGHT_BEAMWIDTH       = 0.25;
 float const SLIGHT_DIST_TO_CORNER_SCALE = 2.0;
@@ -731,6 +732,115 @@ bool tunnel_t::line_intersect(point const &p1, point const &p2, float &t) const
 }
 
 
+void car_router_t::clear() {
+	num_nodes = 0;
+	edges.clear();
+	node_edges.clear();
+	seg_ixs.clear();
+	rev_start.clear();
+	rev_edges.clear();
+	cost_to_dest.clear();
+}
+
+void car_router_t::build(vector<road_seg_t> const &segs, vector<road_isec_t> const isecs[3]) {
+	clear();
+	for (unsigned n = 0; n < 3; ++n) {isec_offset[n] = num_nodes; num_nodes += isecs[n].size();}
+	node_edges.resize(4*num_nodes, -1);
+	cost_to_dest.resize(num_nodes);
+
+	for (unsigned n = 0; n < 3; ++n) { // {2-way, 3-way, 4-way}
+		for (unsigned i = 0; i < isecs[n].size(); ++i) {
+			road_isec_t const &isec(isecs[n][i]);
+			unsigned const node(get_node(n, i));
+
+			for (unsigned orient = 0; orient < 4; ++orient) { // exit orient {-x, +x, -y, +y}
+				if (!(isec.conn & (1<<orient)) || isec.conn_ix[orient] < 0) continue; // not connected, or connector road to another city
+				bool const dir(orient & 1);
+				unsigned seg_ix(isec.conn_ix[orient]);
+				edge_t edge(node, seg_ixs.size());
+				bool found(0);
+
+				for (unsigned n_iter = 0; n_iter < segs.size(); ++n_iter) { // follow segments to the next intersection
+					assert(seg_ix < segs.size());
+					road_seg_t const &seg(segs[seg_ix]);
+					seg_ixs.push_back(seg_ix);
+					edge.len += seg.get_sz_dim(seg.dim);
+
+					if (seg.conn_type[dir] != TYPE_RSEG) {
+						if (is_isect(seg.conn_type[dir])) {edge.dest = get_node((seg.conn_type[dir] - TYPE_ISEC2), seg.conn_ix[dir]); found = 1;}
+						break;
+					}
+					seg_ix = seg.conn_ix[dir];
+				} // for n_iter
+				if (!found) {seg_ixs.resize(edge.seg_start); continue;} // dead end; shouldn't happen
+				edge.seg_end = seg_ixs.size();
+				edge.cost    = calc_edge_cost(edge.len, 0); // no cars yet
+				node_edges[4*node + orient] = edges.size();
+				edges.push_back(edge);
+			} // for orient
+		} // for i
+	} // for n
+	rev_start.resize(num_nodes+1, 0);
+	for (auto e = edges.begin(); e != edges.end(); ++e) {++rev_start[e->dest+1];}
+	for (unsigned n = 0; n < num_nodes; ++n) {rev_start[n+1] += rev_start[n];}
+	rev_edges.resize(edges.size());
+	vector<unsigned> pos(rev_start.begin(), rev_start.end()-1);
+	for (unsigned e = 0; e < edges.size(); ++e) {rev_edges[pos[edges[e].dest]++] = e;}
+}
+
+// edge cost is road length, scaled up by the fraction of the road covered by cars and with a fixed cost per intersection
+float car_router_t::calc_edge_cost(float len, unsigned num_cars) {
+	float const car_len(city_params.get_nom_car_size().x), isec_cost(4.0*car_len); // about the cost of waiting at a stoplight
+	float const occupancy(min(1.0f, num_cars*car_len/max(len, car_len)));
+	return len*(1.0 + 4.0*occupancy) + isec_cost;
+}
+
+// uses the car counts of the previous frame, so should be called before they're reset
+void car_router_t::update_edge_costs(vector<road_seg_t> const &segs) {
+	for (auto e = edges.begin(); e != edges.end(); ++e) {
+		unsigned num_cars(0);
+		for (unsigned i = e->seg_start; i < e->seg_end; ++i) {num_cars += segs[seg_ixs[i]].car_count;} // Note: counts cars in both directions
+		e->cost = calc_edge_cost(e->len, num_cars);
+	}
+	for (auto c = cost_to_dest.begin(); c != cost_to_dest.end(); ++c) {c->clear();} // invalidate; recomputed on demand
+}
+
+void car_router_t::calc_costs_to_dest(unsigned dest) const { // Dijkstra's algorithm over incoming edges, starting from dest
+	vector<float> &costs(cost_to_dest[dest]);
+	costs.resize(num_nodes, FLT_MAX);
+	costs[dest] = 0.0;
+	open.clear();
+	open.emplace_back(0.0, dest);
+	std::greater<pair<float, unsigned>> const comp;
+
+	while (!open.empty()) {
+		std::pop_heap(open.begin(), open.end(), comp);
+		pair<float, unsigned> const cur(open.back());
+		open.pop_back();
+		if (cur.first > costs[cur.second]) continue; // stale entry
+
+		for (unsigned i = rev_start[cur.second]; i < rev_start[cur.second+1]; ++i) {
+			edge_t const &edge(edges[rev_edges[i]]);
+			float const cost(cur.first + edge.cost);
+			if (cost >= costs[edge.src]) continue; // not shorter
+			costs[edge.src] = cost;
+			open.emplace_back(cost, edge.src);
+			std::push_heap(open.begin(), open.end(), comp);
+		}
+	} // end while
+}
+
+float car_router_t::get_cost_via(unsigned node, unsigned orient, unsigned dest) const { // returns FLT_MAX if there's no route
+	assert(node < num_nodes && dest < num_nodes && orient < 4);
+	int const eix(node_edges[4*node + orient]);
+	if (eix < 0) return FLT_MAX; // no edge in this dir
+	if (cost_to_dest[dest].empty()) {calc_costs_to_dest(dest);}
+	edge_t const &edge(edges[eix]);
+	float const cost(cost_to_dest[dest][edge.dest]);
+	return ((cost == FLT_MAX) ? FLT_MAX : (cost + edge.cost));
+}
+
+
 road_mat_mgr_t road_mat_mgr;
 
 void road_draw_state_t::draw_road_region_int(quad_batch_draw &cache, unsigned type_ix) {
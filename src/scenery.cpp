@@ -498,6 +498,7 @@ void voxel_rock_manager_t::build_models(unsigned num_lod_levels) {
 		assert(!models[ix]);
 		models[ix].reset(new voxel_model_rock(&ntg, num_lod_levels));
 		gen_voxel_rock(*models[ix], all_zeros, 1.0, ROCK_VOX_SZ, 1, ix);
+		models[ix]->compact_values(); // rock models are never modified after creation, so only a compressed copy of the values is needed
 	}
 	to_gen.clear();
 }
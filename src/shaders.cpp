@@ -1205,6 +1205,19 @@ void compute_shader_t::read_float_vals(vector<float> &vals, bool is_last, bool k
 	if (is_last) {unset_fbo(keep_fbo_for_reuse);}
 }
 
+void compute_shader_t::cancel_read(bool keep_fbo_for_reuse) { // discard the results of a run without waiting for the GPU
+
+	assert(is_running);
+
+	if (pbo) { // the driver defers freeing the buffer until any pending readback completes, so this doesn't block
+		bind_pbo(0);
+		glDeleteBuffers(1, &pbo);
+		pbo = 0;
+	}
+	is_running = 0;
+	unset_fbo(keep_fbo_for_reuse);
+}
+
 void compute_shader_t::prep_for_read_pixels(bool is_first) {
 
 	bind_fbo(fbo_id);
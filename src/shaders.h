@@ -249,6 +249,7 @@ public:
 	void run(unsigned &tid);
 	void prep_for_read_pixels(bool is_first=1);
 	void read_float_vals(vector<float> &vals, bool is_last=1, bool keep_fbo_for_reuse=0);
+	void cancel_read(bool keep_fbo_for_reuse=0);
 	void gen_matrix_RGBA8(vector<float> &vals, unsigned &tid, bool is_first=1, bool is_last=1, bool keep_fbo_for_reuse=0);
 	void gen_matrix_R32F(vector<float> &vals, unsigned &tid, bool is_first=1, bool is_last=1, bool keep_fbo_for_reuse=0);
 	void set_comp_prefix(char const *const prefix) {set_prefix(prefix, 1);} // FS
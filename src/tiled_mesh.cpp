@@ -7,6 +7,9 @@
 #include "shaders.h"
 #include "openal_wrap.h"
 #include "heightmap.h"
+#include "file_utils.h"
+#include "binary_file_io.h"
+#include <fstream>
 
 
 bool const DEBUG_TILES        = 0;
@@ -52,18 +55,19 @@ tile_offset_t model3d_offset;
 
 extern bool inf_terrain_scenery, enable_tiled_mesh_ao, underwater, fog_enabled, volume_lighting, combined_gu, enable_depth_clamp, tt_triplanar_tex, use_grass_tess;
 extern bool use_instanced_pine_trees, enable_tt_model_reflect, water_is_lava, tt_fire_button_down, flashlight_on;
-extern unsigned grass_density, max_unique_trees, shadow_map_sz, num_birds_per_tile, num_fish_per_tile, erosion_iters_tt, num_rnd_grass_blocks;
+extern unsigned grass_density, max_unique_trees, shadow_map_sz, num_birds_per_tile, num_fish_per_tile, erosion_iters_tt, num_rnd_grass_blocks, tile_cache_max_mb;
 extern int DISABLE_WATER, display_mode, tree_mode, leaf_color_changed, ground_effects_level, animate2, iticks, num_trees, window_width, window_height;
 extern int invert_mh_image, is_cloudy, camera_surf_collide, show_fog, mesh_gen_mode, mesh_gen_shape, cloud_model, precip_mode, auto_time_adv, draw_model;
 extern float zmax, zmin, water_plane_z, mesh_scale, mesh_scale_z, vegetation, relh_adj_tex, grass_length, grass_width, fticks, cloud_height_offset, clouds_per_tile;
 extern float ocean_wave_height, sm_tree_density, tree_density_thresh, atmosphere, cloud_cover, temperature, flower_density, FAR_CLIP, shadow_map_pcf_offset, biome_x_offset;
-extern float smap_thresh_scale, tt_grass_scale_factor;
+extern float smap_thresh_scale, tt_grass_scale_factor, tile_gen_time_budget;
 extern double tfticks;
 extern point sun_pos, moon_pos, surface_pos;
 extern vector3d wind;
 extern cube_t grass_exclude1, grass_exclude2;
 extern water_params_t water_params;
 extern char *mh_filename_tt;
+extern string tile_cache_dir;
 extern float h_dirt[];
 extern tree_data_manager_t tree_data_manager;
 extern pt_line_drawer tree_scenery_pld;
@@ -159,17 +163,9 @@ void update_tiled_grass_colors() {grass_tile_manager.clear();} // regenerate gra
 
 class tiled_terrain_hmap_manager_t : public terrain_hmap_manager_t {
 
-	tile_t *cur_tile;
-	bool modified[3][3];
-
 public:
-	tiled_terrain_hmap_manager_t() : cur_tile(NULL) {clear_modified();}
-	void clear_modified() {for (unsigned i = 0; i < 3; ++i) {UNROLL_3X(modified[i][i_] = 0;)}}
-
 	void apply_brush(tex_mod_map_manager_t::hmap_brush_t brush, tile_t *tile, bool cache) { // Note: brush is copied and may be modified
-		cur_tile = tile;
 		assert(brush.radius <= get_tile_size()); // only allow for a single adjacent tile
-		clear_modified();
 
 		if (brush.is_flatten_brush()) { // use heightmap value at brush center instead of a delta
 			brush.delta = get_clamped_pixel_value(brush.x, brush.y); // Note: original delta is overwritten/unused in this case
@@ -177,17 +173,20 @@ public:
 		int const step_sz(max(1, int(1.0/mesh_scale + SMALL_NUMBER))); // Note: only intended to work when mesh_scale is a power of 0.5 (or generally an integer reciprocol)
 		unsigned const num_steps(max(1U, unsigned(mesh_scale + SMALL_NUMBER))); // Note: only intended to work when mesh_scale is a power of 2 (or generally an integer)
 		if (cache) {apply_and_cache_brush(brush, step_sz, num_steps);} else {terrain_hmap_manager_t::apply_brush(brush, step_sz, num_steps);}
-		if (cur_tile == NULL) return; // no tile specified, so can't do any updates
-		tile_xy_pair const tp(cur_tile->get_tile_xy_pair());
+		if (tile == NULL) return; // no tile specified, so can't do any updates
+		tile_xy_pair const tp(tile->get_tile_xy_pair());
 
+		// invalidate only the tiles whose height rect is overlapped by the brush footprint (the dirty rect);
+		// this is computed once per brush rather than per modified pixel, and is exact for round brushes near tile corners
 		for (int dy = -1; dy <= 1; ++dy) {
 			for (int dx = -1; dx <= 1; ++dx) {
-				if (!modified[dy+1][dx+1]) continue;
 				tile_t *adj_tile(get_tile_from_xy(tile_xy_pair(tp.x + dx, tp.y + dy)));
-				if (adj_tile) {adj_tile->invalidate_mesh_height();}
+				if (adj_tile == nullptr) continue;
+				int rx1, ry1, rx2, ry2;
+				adj_tile->get_height_rect(rx1, ry1, rx2, ry2);
+				if (brush.overlaps_rect(rx1, ry1, rx2, ry2)) {adj_tile->invalidate_mesh_height();}
 			}
 		}
-		cur_tile = NULL;
 	}
 	void flatten_region(cube_t const &cube) {
 		// Note: to be applied before tiles are generated so that they don't need to be invalidated
@@ -214,9 +213,13 @@ public:
 		if (!clamp_xy(clamped_x, clamped_y, fract_x, fract_y, allow_wrap)) return 0;
 		assert(clamped_x >= 0 && clamped_y >= 0);
 		modify_height(tex_mod_map_manager_t::mod_elem_t(clamped_x, clamped_y, val), is_delta); // Note: *not* cached at this level
-		if (cur_tile) {cur_tile->fill_adj_mask(modified, x, y);}
 		return 1;
 	}
+	virtual void modify_height_row(int x0, int y, int step_sz, unsigned num_steps, float fract_y, unsigned n1, unsigned n2, hmap_val_t const *vals, bool is_delta) {
+		// one sample per pixel, so clamp_xy() only offsets; write contiguous pixels directly if no clamping or wrapping is needed
+		if (step_sz == 1 && num_steps == 1 && mesh_scale == 1.0 && modify_height_row_if_inside((x0 + n1), y, (vals + n1), (n2 - n1), is_delta)) return; // not cached
+		terrain_hmap_manager_t::modify_height_row(x0, y, step_sz, num_steps, fract_y, n1, n2, vals, is_delta); // per-sample
+	}
 };
 
 
@@ -275,7 +278,15 @@ tile_t::tile_t(unsigned size_, int x, int y) : last_occluded_frame(0), weight_ti
 }
 
 float tile_t::get_draw_priority() const {
-	return (p2p_dist_xy(get_camera_pos(), get_center()) + (is_visible() ? 0.0 : FAR_CLIP)); // prioritize visible tiles
+	point const camera(get_camera_pos()), center(get_center());
+	float const dist(p2p_dist_xy(camera, center));
+	vector3d dir(center - camera);
+	dir.z = 0.0;
+	vector3d view_dir(get_vdir_all());
+	view_dir.z = 0.0;
+	// prioritize visible tiles, then tiles in front of the camera over those to the side or behind, then by distance
+	float const dir_weight((dist > TOLERANCE && view_dir != zero_vector) ? (1.5 - 0.5*dot_product(dir.get_norm(), view_dir.get_norm())) : 1.0);
+	return (dir_weight*dist + (is_visible() ? 0.0 : FAR_CLIP));
 }
 
 
@@ -302,16 +313,6 @@ void tile_t::update_terrain_params() { // setup biomes
 }
 
 
-// used to determine what adjacent tiles modifying this location in global space can affect
-void tile_t::fill_adj_mask(bool mask[3][3], int x, int y) const { // mask is {y-1, y, y+1} x {x-1, x, x+1}
-
-	if (x >= x1 && x <= x2 && y >= y1 && y <= y2) {mask[1][1] |= 1;} // ourself
-	if (x <= x1) {mask[1][0] |= 1; mask[0][0] |= (y <= y1); mask[2][0] |= (y >= y2);} // left  + top/bottom left  corners
-	if (x >= x2) {mask[1][2] |= 1; mask[0][2] |= (y <= y1); mask[2][2] |= (y >= y2);} // right + top/bottom right corners
-	mask[0][1] |= (y <= y1); mask[2][1] |= (y >= y2); // top/bottom edges
-}
-
-
 float tile_t::get_min_dist_to_pt(point const &pt, bool xy_only, bool mesh_only) const {
 
 	cube_t const bcube(mesh_only ? get_mesh_bcube() : get_bcube());
@@ -409,6 +410,156 @@ void tile_t::clear_vbo_tid(tile_shadow_map_manager *smap_manager) {
 }
 
 
+// optional persistent disk cache of generated tile heights and AO lighting, keyed by tile position and mesh generation parameters
+unsigned const TILE_CACHE_MAGIC   = 0x454C4954; // "TILE"
+unsigned const TILE_CACHE_VERSION = 2; // increment when tile height generation changes
+
+struct tile_cache_header_t {
+	unsigned magic, version, key_len, num_zvals, num_ao;
+	tile_cache_header_t() : magic(TILE_CACHE_MAGIC), version(TILE_CACHE_VERSION), key_len(0), num_zvals(0), num_ao(0) {}
+};
+
+class tile_disk_cache_t { // tracks cache file sizes and use order so that total disk usage can be bounded with LRU eviction
+	struct entry_t {
+		unsigned long long size, last_use;
+		entry_t(unsigned long long size_=0, unsigned long long last_use_=0) : size(size_), last_use(last_use_) {}
+	};
+	map<string, entry_t> entries; // cache filename => entry
+	string dir; // copy of tile_cache_dir, since it may be destroyed before this object at exit
+	unsigned long long total_size, use_counter;
+	unsigned num_changes;
+	bool index_loaded;
+
+	string get_index_fn() const {return dir + "/tile_cache.idx";}
+
+	void load_index() {
+		if (index_loaded) return;
+		index_loaded = 1;
+		dir = tile_cache_dir;
+		ifstream in(get_index_fn());
+		if (!in.good()) return; // no index yet
+		string fn;
+		unsigned long long size(0), last_use(0);
+
+		while (in >> fn >> size >> last_use) {
+			entries[fn] = entry_t(size, last_use);
+			total_size += size;
+			max_eq(use_counter, last_use);
+		}
+	}
+	void evict_lru(string const &keep_fn) {
+		unsigned long long const max_size((unsigned long long)tile_cache_max_mb << 20);
+
+		while (total_size > max_size && entries.size() > 1) {
+			auto lru(entries.end());
+
+			for (auto i = entries.begin(); i != entries.end(); ++i) {
+				if (i->first != keep_fn && (lru == entries.end() || i->second.last_use < lru->second.last_use)) {lru = i;}
+			}
+			assert(lru != entries.end());
+			remove((dir + "/" + lru->first).c_str());
+			total_size -= min(total_size, lru->second.size);
+			entries.erase(lru);
+		}
+	}
+public:
+	tile_disk_cache_t() : total_size(0), use_counter(0), num_changes(0), index_loaded(0) {}
+	~tile_disk_cache_t() {write_index();}
+	static bool enabled() {return !tile_cache_dir.empty();}
+
+	void write_index() {
+		if (num_changes == 0) return; // nothing to write
+		ofstream out(get_index_fn());
+		if (!out.good()) {cerr << "Warning: Failed to write tile cache index " << get_index_fn() << endl; return;}
+		for (auto i = entries.begin(); i != entries.end(); ++i) {out << i->first << " " << i->second.size << " " << i->second.last_use << "\n";}
+		num_changes = 0;
+	}
+	void mark_used(string const &fn, unsigned long long size, bool was_written) { // fn is relative to the cache dir
+		load_index();
+		entry_t &e(entries[fn]);
+		total_size += size;
+		total_size -= min(total_size, e.size);
+		e.size      = size;
+		e.last_use  = ++use_counter;
+		if (was_written) {evict_lru(fn);}
+		if (++num_changes >= 64) {write_index();} // write periodically in case we don't exit cleanly
+	}
+};
+
+tile_disk_cache_t tile_disk_cache;
+
+unsigned long long get_disk_file_size(string const &fn) {
+	ifstream in(fn, ios::binary | ios::ate);
+	return (in.good() ? (unsigned long long)in.tellg() : 0ULL);
+}
+
+
+bool tile_t::get_cache_fn_and_key(string &cache_fn, string &key) const {
+
+	if (!tile_disk_cache_t::enabled() || using_tiled_terrain_hmap_tex()) return 0; // heightmaps can be edited at runtime, so are never cached
+	ostringstream oss;
+	oss.precision(9);
+	oss << x1 << " " << y1 << " " << zvsize << " " << stride << " " << deltax << " " << deltay << " " << zmin << " " << erosion_iters_tt << " "
+		<< enable_tiled_mesh_ao << " " << (USE_PARAMS_HSCALE && enable_terrain_env) << " " << biome_x_offset << " " << HALF_DXY << " ";
+	write_mesh_gen_params_key(oss);
+	key = oss.str();
+	ostringstream fn;
+	fn << hex << hash_string_fnv1a(key) << ".tile.gz"; // gz extension selects zlib compression in binary_file_io
+	cache_fn = fn.str();
+	return 1;
+}
+
+bool tile_t::read_from_cache() {
+
+	string cache_fn, key;
+	if (!get_cache_fn_and_key(cache_fn, key)) return 0;
+	string const full_fn(tile_cache_dir + "/" + cache_fn);
+	if (!check_file_exists(full_fn)) return 0; // not cached
+	binary_file_reader reader;
+	if (!reader.open(full_fn)) {cerr << endl; return 0;}
+	tile_cache_header_t header;
+	unsigned const num_ao(enable_tiled_mesh_ao ? stride*stride : 0);
+	bool valid(reader.read(&header, sizeof(header), 1) && header.magic == TILE_CACHE_MAGIC && header.version == TILE_CACHE_VERSION);
+	valid &= (header.key_len == key.size() && header.num_zvals == zvsize*zvsize && header.num_ao == num_ao);
+
+	if (valid) { // check the full key in case of a hash collision
+		string file_key(key.size(), ' ');
+		valid = (reader.read(&file_key[0], 1, key.size()) && file_key == key);
+	}
+	if (valid) {
+		zvals.resize(header.num_zvals);
+		ao_lighting.resize(num_ao);
+		valid = (reader.read(zvals.data(), sizeof(float), zvals.size()) && (num_ao == 0 || reader.read(ao_lighting.data(), 1, num_ao)));
+		if (!valid) {ao_lighting.clear();}
+	}
+	reader.close();
+	if (valid) {tile_disk_cache.mark_used(cache_fn, get_disk_file_size(full_fn), 0);}
+	return valid;
+}
+
+void tile_t::write_to_cache() const { // called after zvals (and AO lighting, if enabled) are generated
+
+	string cache_fn, key;
+	if (!get_cache_fn_and_key(cache_fn, key)) return;
+	string const full_fn(tile_cache_dir + "/" + cache_fn);
+	binary_file_writer writer;
+
+	if (!writer.open(full_fn)) {
+		cerr << " Tile cache disabled for this tile." << endl;
+		return;
+	}
+	tile_cache_header_t header;
+	header.key_len   = key.size();
+	header.num_zvals = zvals.size();
+	header.num_ao    = ao_lighting.size();
+	bool const success(writer.write(&header, sizeof(header), 1) && writer.write(key.data(), 1, key.size()) &&
+		writer.write(zvals.data(), sizeof(float), zvals.size()) && (ao_lighting.empty() || writer.write(ao_lighting.data(), 1, ao_lighting.size())));
+	writer.close(); // flush before checking the compressed size
+	if (success) {tile_disk_cache.mark_used(cache_fn, get_disk_file_size(full_fn), 1);}
+	else {remove(full_fn.c_str());}
+}
+
+
 bool setup_height_gen(mesh_xy_grid_cache_t &height_gen, float x0, float y0, float dx, float dy, unsigned nx, unsigned ny, bool cache_values, bool no_wait=0) {
 
 	bool const add_detail(using_hmap_with_detail());
@@ -420,14 +571,9 @@ bool setup_height_gen(mesh_xy_grid_cache_t &height_gen, float x0, float y0, floa
 }
 
 
-bool tile_t::create_zvals(mesh_xy_grid_cache_t &height_gen, bool no_wait) {
+bool tile_t::gen_zvals(mesh_xy_grid_cache_t &height_gen, bool no_wait) {
 
-	//timer_t timer("Create Zvals");
-	if (enable_terrain_env) {update_terrain_params();}
-	zvals.resize(zvsize*zvsize);
-	mzmin =  FAR_DISTANCE;
-	mzmax = -FAR_DISTANCE;
-	unsigned const block_size(zvsize/4), context_sz(stride + 2*AO_RAY_LEN);
+	unsigned const context_sz(stride + 2*AO_RAY_LEN);
 	bool const using_hmap(using_tiled_terrain_hmap_tex()), add_detail(using_hmap_with_detail()); // add procedural detail to heightmap
 
 	// When using AO + GPU noise generation, it's faster to compute the AO + context and clip the zvals from this rather than making two separate compute calls (one without blocking)
@@ -445,7 +591,7 @@ bool tile_t::create_zvals(mesh_xy_grid_cache_t &height_gen, bool no_wait) {
 		bool results_ready(setup_height_gen(height_gen, get_xval(x1), get_yval(y1), deltax, deltay, zvsize, zvsize, 0, no_wait)); // cache_values=0
 		if (!results_ready) {assert(no_wait); return 0;} // cached heights are not yet ready
 	}
-	float const xy_mult(1.0/float(size)), wpz_max(get_water_z_height() + ocean_wave_height);
+	float const xy_mult(1.0/float(size));
 
 #pragma omp parallel for schedule(static,1)
 	for (int y = 0; y < (int)zvsize; ++y) {
@@ -468,6 +614,22 @@ bool tile_t::create_zvals(mesh_xy_grid_cache_t &height_gen, bool no_wait) {
 		} // for x
 	} // for y
 	if (!using_hmap) {apply_erosion(&zvals.front(), zvsize, zvsize, zmin, erosion_iters_tt);} // heightmap is eroded during load
+	return 1; // results are ready
+}
+
+bool tile_t::create_zvals(mesh_xy_grid_cache_t &height_gen, bool no_wait) {
+
+	//timer_t timer("Create Zvals");
+	if (enable_terrain_env) {update_terrain_params();}
+	zvals.resize(zvsize*zvsize);
+	mzmin =  FAR_DISTANCE;
+	mzmax = -FAR_DISTANCE;
+
+	if (read_from_cache()) {} // heights (and AO lighting) were loaded from the disk cache
+	else if (!gen_zvals(height_gen, no_wait)) return 0; // cached heights are not yet ready
+	else if (!enable_tiled_mesh_ao) {write_to_cache();} // else written after AO lighting is calculated
+	unsigned const block_size(zvsize/4);
+	float const wpz_max(get_water_z_height() + ocean_wave_height);
 
 	for (unsigned yy = 0; yy < 4; ++yy) {
 		for (unsigned xx = 0; xx < 4; ++xx) {
@@ -800,7 +962,7 @@ void tile_t::check_shadow_map_and_normal_texture(bool no_push) {
 	if (!tid_is_valid) {setup_texture(shadow_tid, 0, 0, 0, 0, 0); sun_shadows_invalid = moon_shadows_invalid = 1;}
 	assert(has_sun || has_moon);
 	if (mesh_shadows) {calc_shadows(update_sun, update_moon, no_push);}
-	if (enable_tiled_mesh_ao && ao_lighting.empty()) {calc_mesh_ao_lighting();}
+	if (enable_tiled_mesh_ao && ao_lighting.empty()) {calc_mesh_ao_lighting(); write_to_cache();}
 	upload_shadow_map_texture(tid_is_valid);
 	sun_shadows_invalid = moon_shadows_invalid = 0;
 }
@@ -2127,6 +2289,13 @@ float tile_draw_t::update(float &min_camera_dist) { // view-independent updates;
 
 		for (unsigned i = 0; i < to_gen_zvals.size(); ++i) { // tiles were waiting on zval generation (async)
 			tile_t *tile(to_gen_zvals[i].second);
+
+			if (tile->get_rel_dist_to_camera() >= CREATE_DIST_TILES) { // camera has moved away - cancel this tile rather than finishing it
+				height_gens[i].cancel_async();
+				if (create_buildings_first) {remove_buildings_tile(tile->get_tile_xy_pair().x, tile->get_tile_xy_pair().y);}
+				delete tile;
+				continue;
+			}
 			tile->create_zvals(height_gens[i], 0); // wait for zvals to be generated
 			insert_tile(tile); // zvals have been generated
 		}
@@ -2179,14 +2348,18 @@ float tile_draw_t::update(float &min_camera_dist) { // view-independent updates;
 		// if there are fewer than 4 tiles to generate, use CPU simplex rather than GPU simplex to avoid stalling/flusing the graphics pipeline
 		int const prev_mesh_gen_mode(mesh_gen_mode);
 		if (gpu_mode && gen_this_frame <= max_cpu_tiles) {mesh_gen_mode = MGEN_SIMPLEX;} // GPU simplex => CPU simplex
-		if (gen_this_frame < num_to_gen) {sort(to_gen_zvals.begin(), to_gen_zvals.end());} // sort by priority if not all generated
+		bool const use_budget(tile_gen_time_budget > 0.0); // may stop before gen_this_frame tiles
+		if (use_budget || gen_this_frame < num_to_gen) {sort(to_gen_zvals.begin(), to_gen_zvals.end());} // sort by priority if not all generated
 		//ostringstream oss; oss << "Gen " << gen_this_frame << " tiles"; timer_t timer(oss.str());
+		int const gen_start_time(use_budget ? GET_TIME_MS() : 0);
 
 		for (unsigned i = 0; i < num_to_gen; ++i) {
 			tile_t *tile(to_gen_zvals[i].second);
 			if (i >= gen_this_frame) {delete tile; continue;} // delete these tiles - they will be created in a later frame
-			tile->create_zvals(height_gens[0], 0); // generate these tiles
+			tile->create_zvals(height_gens[0], 0); // generate these tiles in priority order
 			insert_tile(tile);
+			// if over the per-frame time budget, stop early so that the remaining (lower priority) tiles are deferred to a later frame; always generate at least one
+			if (use_budget && (GET_TIME_MS() - gen_start_time) > tile_gen_time_budget) {gen_this_frame = i+1;}
 		}
 		to_gen_zvals.clear();
 		mesh_gen_mode = prev_mesh_gen_mode;
@@ -263,7 +263,7 @@ public:
 		float const xv1(get_xval(x1)), yv1(get_yval(y1));
 		return cube_t(xv1, xv1+(x2-x1)*deltax, yv1, yv1+(y2-y1)*deltay, mzmin, mzmax);
 	}
-	void fill_adj_mask(bool mask[3][3], int x, int y) const;
+	void get_height_rect(int &rx1, int &ry1, int &rx2, int &ry2) const {rx1 = x1; ry1 = y1; rx2 = x2; ry2 = y2;} // inclusive; edge zvals are shared with adjacent tiles
 	float get_min_dist_to_pt(point const &pt, bool xy_only=0, bool mesh_only=1) const;
 	float get_max_xy_dist_to_pt(point const &pt) const;
 	bool contains_point(point const &pos) const {return get_bcube().contains_pt_xy(pos);}
@@ -281,7 +281,11 @@ public:
 	void clear_shadow_map(tile_shadow_map_manager *smap_manager);
 	void clear_vbo_tid(tile_shadow_map_manager *smap_manager);
 	void clear_pine_tree_vbos() {pine_trees.clear_vbos();}
+	bool gen_zvals(mesh_xy_grid_cache_t &height_gen, bool no_wait);
 	bool create_zvals(mesh_xy_grid_cache_t &height_gen, bool no_wait);
+	bool get_cache_fn_and_key(string &cache_fn, string &key) const;
+	bool read_from_cache();
+	void write_to_cache() const;
 	void get_z_minmax_for_area(point const &pos, float radius, float &zmin, float &zmax) const;
 	float get_zval_at(float x, float y, bool in_global_space) const;
 
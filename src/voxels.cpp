@@ -18,10 +18,17 @@ bool const DEBUG_BLOCKS    = 0;
 bool const PRE_ALLOC_COBJS = 1;
 unsigned const NOISE_TSIZE = 64;
 unsigned const GROUND_NUM_LOD = 1; // >= 1
+unsigned const VOXEL_BRICK_SZ = 8; // in each dim
+unsigned const VOXEL_BRICK_NO_DATA = 0xFFFFFFFF; // uniform brick
+unsigned const VOXEL_BRICK_DENSE_BIT = 0x80000000; // brick has been modified and expanded to floats
+unsigned const VOXEL_FILE_MAGIC   = 0x3DB0C5E1;
+unsigned const VOXEL_FILE_VERSION = 2; // 1 = dense values (no header), 2 = brick-compressed values
 
 unsigned char const ON_EDGE_BIT    = 0x02;
 unsigned char const ANCHORED_BIT   = 0x04;
 unsigned char const UNDER_MESH_BIT = 0x08;
+unsigned char const EMPTY_DIST_MAX = 16; // in voxels
+unsigned char const CUR_SEARCH_BIT = 0x10; // only set temporarily during remove_unconnected_near_changed()
 
 
 voxel_params_t global_voxel_params;
@@ -203,7 +210,7 @@ template<typename V> bool voxel_grid<V>::read(FILE *fp) {
 
 	assert(fp);
 	unsigned sz(0);
-	if (!read_pod(nx, fp, "voxel nx") || !read_pod(nx, fp, "voxel ny") || !read_pod(nx, fp, "voxel nz")) return 0;
+	if (!read_pod(nx, fp, "voxel nx") || !read_pod(ny, fp, "voxel ny") || !read_pod(nz, fp, "voxel nz")) return 0;
 	if (!read_pod(xblocks, fp, "voxel xblocks") || !read_pod(yblocks, fp, "voxel yblocks")) return 0;
 	if (!read_pod(vsz, fp, "voxel vsz") || !read_pod(center, fp, "voxel center") || !read_pod(lo_pos, fp, "voxel lo_pos")) return 0;
 	if (!read_pod(sz, fp, "voxel_grid size")) return 0;
@@ -227,7 +234,7 @@ template<typename V> bool voxel_grid<V>::write(FILE *fp) const {
 
 	assert(fp);
 	unsigned const sz(size());
-	if (!write_pod(nx, fp, "voxel nx") || !write_pod(nx, fp, "voxel ny") || !write_pod(nx, fp, "voxel nz")) return 0;
+	if (!write_pod(nx, fp, "voxel nx") || !write_pod(ny, fp, "voxel ny") || !write_pod(nz, fp, "voxel nz")) return 0;
 	if (!write_pod(xblocks, fp, "voxel xblocks") || !write_pod(yblocks, fp, "voxel yblocks")) return 0;
 	if (!write_pod(vsz, fp, "voxel vsz") || !write_pod(center, fp, "voxel center") || !write_pod(lo_pos, fp, "voxel lo_pos")) return 0;
 	if (!write_pod(sz, fp, "voxel_grid size")) return 0;
@@ -240,6 +247,205 @@ template<typename V> bool voxel_grid<V>::write(FILE *fp) const {
 }
 
 
+template<typename T> bool read_pod_vector(vector<T> &v, FILE *fp, char const *const name) {
+	unsigned sz(0);
+	if (!read_pod(sz, fp, name)) return 0;
+	v.resize(sz);
+	if (sz == 0) return 1;
+	if (fread(&v.front(), sizeof(T), sz, fp) == sz) return 1;
+	cerr << "Error reading " << name << " data" << endl;
+	return 0;
+}
+template<typename T> bool write_pod_vector(vector<T> const &v, FILE *fp, char const *const name) {
+	unsigned const sz(v.size());
+	if (!write_pod(sz, fp, name)) return 0;
+	if (sz == 0) return 1;
+	if (fwrite(&v.front(), sizeof(T), sz, fp) == sz) return 1;
+	cerr << "Error writing " << name << " data" << endl;
+	return 0;
+}
+
+
+void voxel_brick_store_t::clear() {
+	nx = ny = nz = bnx = bny = bnz = 0;
+	brick_data.clear();
+	uniform_qvals.clear();
+	qvals.clear();
+	dense_vals.clear();
+}
+
+unsigned voxel_brick_store_t::get_brick_ix(unsigned x, unsigned y, unsigned z) const {
+	return ((z/VOXEL_BRICK_SZ) + ((x/VOXEL_BRICK_SZ) + (y/VOXEL_BRICK_SZ)*bnx)*bnz);
+}
+unsigned voxel_brick_store_t::get_val_ix(unsigned x, unsigned y, unsigned z) const {
+	return ((z%VOXEL_BRICK_SZ) + ((x%VOXEL_BRICK_SZ) + (y%VOXEL_BRICK_SZ)*VOXEL_BRICK_SZ)*VOXEL_BRICK_SZ);
+}
+
+unsigned short voxel_brick_store_t::quantize(float val) const {
+
+	int q(round_fp(max(-32767.0f, min(32767.0f, qscale*(val - isolevel))))); // clamp before converting to int to avoid overflow
+	// never round a value onto or across the isolevel, since that would change which side of the surface it's on
+	if (val > isolevel) {q = max(q, 1);} else if (val < isolevel) {q = min(q, -1);} else {q = 0;}
+	return (unsigned short)max(0, min(65535, (q + 32768)));
+}
+
+void voxel_brick_store_t::compress(float_voxel_grid const &grid, float isolevel_, bool narrow_band) {
+
+	assert(!grid.empty());
+	clear();
+	nx = grid.nx; ny = grid.ny; nz = grid.nz;
+	bnx = (nx + VOXEL_BRICK_SZ - 1)/VOXEL_BRICK_SZ;
+	bny = (ny + VOXEL_BRICK_SZ - 1)/VOXEL_BRICK_SZ;
+	bnz = (nz + VOXEL_BRICK_SZ - 1)/VOXEL_BRICK_SZ;
+	isolevel = isolevel_;
+	float band(0.0); // max distance from the isolevel of either end of an edge that crosses the surface, or of any value if !narrow_band
+
+	for (unsigned y = 0; y < ny; ++y) {
+		for (unsigned x = 0; x < nx; ++x) {
+			for (unsigned z = 0; z < nz; ++z) {
+				float const v(grid.get(x, y, z));
+				if (!narrow_band) {band = max(band, fabs(v - isolevel)); continue;} // keep the full range of values
+				bool const above(v > isolevel);
+				unsigned const nxyz[3][3] = {{x+1, y, z}, {x, y+1, z}, {x, y, z+1}};
+
+				for (unsigned d = 0; d < 3; ++d) {
+					if (nxyz[d][0] >= nx || nxyz[d][1] >= ny || nxyz[d][2] >= nz) continue;
+					float const v2(grid.get(nxyz[d][0], nxyz[d][1], nxyz[d][2]));
+					if ((v2 > isolevel) == above && v != isolevel && v2 != isolevel) continue; // no crossing
+					band = max(band, max(fabs(v - isolevel), fabs(v2 - isolevel)));
+				}
+			}
+		}
+	}
+	if (band == 0.0) {band = 1.0;} // no surface, any band will do
+	qscale = 32000.0/band; // leave some headroom below 32767 for rounding
+	unsigned const brick_vals(VOXEL_BRICK_SZ*VOXEL_BRICK_SZ*VOXEL_BRICK_SZ);
+	brick_data.resize(bnx*bny*bnz, VOXEL_BRICK_NO_DATA);
+	uniform_qvals.resize(brick_data.size(), 0);
+	vector<unsigned short> bvals(brick_vals);
+
+	for (unsigned by = 0; by < bny; ++by) {
+		for (unsigned bx = 0; bx < bnx; ++bx) {
+			for (unsigned bz = 0; bz < bnz; ++bz) {
+				unsigned const x0(bx*VOXEL_BRICK_SZ), y0(by*VOXEL_BRICK_SZ), z0(bz*VOXEL_BRICK_SZ);
+				bool uniform(1);
+
+				for (unsigned y = 0; y < VOXEL_BRICK_SZ; ++y) {
+					for (unsigned x = 0; x < VOXEL_BRICK_SZ; ++x) {
+						for (unsigned z = 0; z < VOXEL_BRICK_SZ; ++z) {
+							// voxels past the grid edge (partial bricks) replicate the brick's first value
+							bool const valid(x0+x < nx && y0+y < ny && z0+z < nz);
+							unsigned short &q(bvals[get_val_ix(x, y, z)]);
+							q = (valid ? quantize(grid.get(x0+x, y0+y, z0+z)) : bvals[0]);
+							uniform &= (q == bvals[0]);
+						}
+					}
+				}
+				unsigned const bix(get_brick_ix(x0, y0, z0));
+				uniform_qvals[bix] = bvals[0];
+				if (uniform) continue;
+				brick_data[bix] = qvals.size();
+				qvals.insert(qvals.end(), bvals.begin(), bvals.end());
+			} // for bz
+		} // for bx
+	} // for by
+}
+
+float voxel_brick_store_t::get(unsigned x, unsigned y, unsigned z) const {
+
+	assert(x < nx && y < ny && z < nz);
+	unsigned const bix(get_brick_ix(x, y, z)), data_ix(brick_data[bix]);
+	if (data_ix == VOXEL_BRICK_NO_DATA) {return dequantize(uniform_qvals[bix]);}
+	if (data_ix &  VOXEL_BRICK_DENSE_BIT) {return dense_vals[(data_ix & ~VOXEL_BRICK_DENSE_BIT) + get_val_ix(x, y, z)];}
+	return dequantize(qvals[data_ix + get_val_ix(x, y, z)]);
+}
+
+void voxel_brick_store_t::expand_brick(unsigned bix) { // Note: the brick's quantized values are left unused in qvals rather than compacting qvals
+
+	unsigned const data_ix(brick_data[bix]), brick_vals(VOXEL_BRICK_SZ*VOXEL_BRICK_SZ*VOXEL_BRICK_SZ), dense_ix(dense_vals.size());
+	assert(data_ix == VOXEL_BRICK_NO_DATA || !(data_ix & VOXEL_BRICK_DENSE_BIT));
+	assert(dense_ix < VOXEL_BRICK_DENSE_BIT);
+	dense_vals.resize(dense_ix + brick_vals);
+
+	for (unsigned i = 0; i < brick_vals; ++i) {
+		dense_vals[dense_ix + i] = dequantize((data_ix == VOXEL_BRICK_NO_DATA) ? uniform_qvals[bix] : qvals[data_ix + i]);
+	}
+	brick_data[bix] = (dense_ix | VOXEL_BRICK_DENSE_BIT);
+}
+
+// Note: not thread safe, and the returned reference is invalidated by the next call that expands a brick, so edits of compacted values must be serialized
+float &voxel_brick_store_t::get_ref(unsigned x, unsigned y, unsigned z) {
+
+	assert(x < nx && y < ny && z < nz);
+	assert(!omp_in_parallel_3dw()); // parallel edits must expand_values() first
+	unsigned const bix(get_brick_ix(x, y, z));
+	if (brick_data[bix] == VOXEL_BRICK_NO_DATA || !(brick_data[bix] & VOXEL_BRICK_DENSE_BIT)) {expand_brick(bix);}
+	return dense_vals[(brick_data[bix] & ~VOXEL_BRICK_DENSE_BIT) + get_val_ix(x, y, z)];
+}
+
+void voxel_brick_store_t::expand(float_voxel_grid &grid) const {
+
+	assert(!empty());
+	assert(grid.nx == nx && grid.ny == ny && grid.nz == nz);
+	grid.resize(nx*ny*nz);
+
+	#pragma omp parallel for schedule(static)
+	for (int y = 0; y < (int)ny; ++y) {
+		for (unsigned x = 0; x < nx; ++x) {
+			for (unsigned z = 0; z < nz; ++z) {grid.set(x, y, z, get(x, y, z));}
+		}
+	}
+}
+
+bool voxel_brick_store_t::read(FILE *fp) {
+
+	assert(fp);
+	clear();
+	if (!read_pod(nx, fp, "voxel brick nx") || !read_pod(ny, fp, "voxel brick ny") || !read_pod(nz, fp, "voxel brick nz")) return 0;
+	if (!read_pod(isolevel, fp, "voxel brick isolevel") || !read_pod(qscale, fp, "voxel brick qscale")) return 0;
+	bnx = (nx + VOXEL_BRICK_SZ - 1)/VOXEL_BRICK_SZ;
+	bny = (ny + VOXEL_BRICK_SZ - 1)/VOXEL_BRICK_SZ;
+	bnz = (nz + VOXEL_BRICK_SZ - 1)/VOXEL_BRICK_SZ;
+	if (!read_pod_vector(brick_data, fp, "voxel brick data") || !read_pod_vector(uniform_qvals, fp, "voxel brick uniform values")) return 0;
+	if (!read_pod_vector(qvals, fp, "voxel brick values")) return 0;
+
+	if (brick_data.size() != bnx*bny*bnz || uniform_qvals.size() != brick_data.size()) {
+		cerr << "Error reading voxel bricks: expected " << bnx*bny*bnz << " bricks but got " << brick_data.size() << endl;
+		clear();
+		return 0;
+	}
+	return 1;
+}
+
+bool voxel_brick_store_t::write(FILE *fp) const {
+
+	assert(fp);
+	assert(!has_dense_bricks()); // modified bricks must be compressed again before writing
+	if (!write_pod(nx, fp, "voxel brick nx") || !write_pod(ny, fp, "voxel brick ny") || !write_pod(nz, fp, "voxel brick nz")) return 0;
+	if (!write_pod(isolevel, fp, "voxel brick isolevel") || !write_pod(qscale, fp, "voxel brick qscale")) return 0;
+	return (write_pod_vector(brick_data, fp, "voxel brick data") && write_pod_vector(uniform_qvals, fp, "voxel brick uniform values") &&
+		write_pod_vector(qvals, fp, "voxel brick values"));
+}
+
+
+// narrow_band clamps values far from the surface, which is only valid if they won't be modified, since that would change how much material edits remove;
+// values can still be modified after compacting, which expands the modified bricks back to floats
+void voxel_manager::compact_values(bool narrow_band) {
+
+	if (values_compacted() || empty()) return; // already compacted or nothing to compact
+	packed_vals.compress(*this, params.isolevel, narrow_band);
+	vector<value_type>().swap(*this); // free the dense values but keep the grid dimensions
+}
+
+void voxel_manager::expand_values() {
+
+	if (!values_compacted()) return; // already expanded
+	packed_vals.expand(*this);
+	packed_vals.clear();
+}
+
+
+// file format: magic number, version, the outside grid (which has the same dimensions as the values), brick-compressed values, AO lighting
 bool voxel_model::from_file(string const &fn) {
 
 	FILE *fp(fopen(fn.c_str(), "rb"));
@@ -248,9 +454,21 @@ bool voxel_model::from_file(string const &fn) {
 		cerr << "Error opening voxel file " << fn << " for read" << endl;
 		return 0;
 	}
-	bool const success(read(fp) && outside.read(fp) && ao_lighting.read(fp)); // should ao_lighting be read or recalculated?
+	unsigned magic(0), version(0);
+
+	if (!read_pod(magic, fp, "voxel file magic") || !read_pod(version, fp, "voxel file version") || magic != VOXEL_FILE_MAGIC || version != VOXEL_FILE_VERSION) {
+		cerr << "Error reading voxel file " << fn << ": unsupported format or version; expected version " << VOXEL_FILE_VERSION << endl;
+		checked_fclose(fp);
+		return 0;
+	}
+	voxel_brick_store_t packed;
+	bool const success(outside.read(fp) && packed.read(fp) && ao_lighting.read(fp)); // should ao_lighting be read or recalculated?
 	checked_fclose(fp);
-	return success;
+	if (!success) return 0;
+	packed_vals.clear();
+	copy_dims_from(outside);
+	packed.expand(*this);
+	return 1;
 }
 
 
@@ -262,7 +480,18 @@ bool voxel_model::to_file(string const &fn) const {
 		cerr << "Error opening voxel file " << fn << " for write" << endl;
 		return 0;
 	}
-	bool const success(write(fp) && outside.write(fp) && ao_lighting.write(fp)); // should ao_lighting be read or recalculated?
+	voxel_brick_store_t packed;
+
+	if (values_compacted() && !packed_vals.has_dense_bricks()) {packed = packed_vals;} // use as is
+	else if (values_compacted()) { // has modified bricks; expand to floats and compress again, keeping the full range of values since it may still be edited
+		float_voxel_grid vals;
+		vals.copy_dims_from(*this);
+		packed_vals.expand(vals);
+		packed.compress(vals, params.isolevel, 0); // narrow_band=0
+	}
+	else {packed.compress(*this, params.isolevel, 0);} // may still be edited, so keep the full range of values; narrow_band=0
+	bool const success(write_pod(VOXEL_FILE_MAGIC, fp, "voxel file magic") && write_pod(VOXEL_FILE_VERSION, fp, "voxel file version") &&
+		outside.write(fp) && packed.write(fp) && ao_lighting.write(fp)); // should ao_lighting be read or recalculated?
 	checked_fclose(fp);
 	return success;
 }
@@ -271,6 +500,8 @@ bool voxel_model::to_file(string const &fn) const {
 void voxel_manager::clear() {
 	
 	outside.clear();
+	empty_dist.clear();
+	packed_vals.clear();
 	float_voxel_grid::clear();
 }
 
@@ -528,19 +759,26 @@ unsigned voxel_manager::add_triangles_for_voxel(tri_data_t::value_type &tri_vert
 	for (unsigned i = 0; i < 12; ++i) {
 		if (!(edge_val & (1 << i))) continue;
 		unsigned const *eix = voxel_detail::edge_to_vals[i];
-		unsigned xhv(1), yhv(1), zhv(1);
+		unsigned xhi[2], yhi[2], zhi[2], xhv(1), yhv(1), zhv(1);
+
+		for (unsigned d = 0; d < 2; ++d) {
+			yhi[d] = ((eix[d] & 2) >> 1); xhi[d] = (yhi[d] ^ (eix[d] & 1)); zhi[d] = (eix[d] >> 2);
+			xhv &= xhi[d]; yhv &= yhi[d]; zhv &= zhi[d];
+		}
+		// cache is indexed in LOD steps; round up so that a clamped upper edge (x2 < x+step) doesn't alias the lower one
+		unsigned const cx((xv[xhv] - block_x0 + step - 1) >> lod_level), cy((yv[yhv] - block_y0 + step - 1) >> lod_level), cz((zv[zhv] + step - 1) >> lod_level);
+		vixs[i] = &(vix_cache.get_ref(cx, cy, cz).ix[edge_to_dim_map[i]]);
+		// each edge is shared by up to 4 cubes in this block; if an adjacent cube has already added its vertex, reuse it rather than reading and interpolating the voxels again
+		if (*vixs[i] >= 0) {vlist[i] = tri_verts[*vixs[i]].v; continue;}
 		float vals[2];
 		point pts[2];
 
 		for (unsigned d = 0; d < 2; ++d) {
-			unsigned const yhi((eix[d] & 2) >> 1), xhi(yhi ^ (eix[d] & 1)), zhi(eix[d] >> 2);
-			unsigned const ix(get_ix(xv[xhi], yv[yhi], zv[zhi]));
-			xhv &= xhi; yhv &= yhi; zhv &= zhi;
+			unsigned const ix(get_ix(xv[xhi[d]], yv[yhi[d]], zv[zhi[d]]));
 			vals[d] = ((outside[ix] & 7) == ON_EDGE_BIT) ? params.isolevel : operator[](ix);
-			pts[d].assign(cube.d[0][xhi], cube.d[1][yhi], cube.d[2][zhi]);
+			pts[d].assign(cube.d[0][xhi[d]], cube.d[1][yhi[d]], cube.d[2][zhi[d]]);
 		}
 		vlist[i] = interpolate_pt(params.isolevel, pts[0], pts[1], vals[0], vals[1]);
-		vixs [i] = &(vix_cache.get_ref(xv[xhv]-block_x0, yv[yhv]-block_y0, zv[zhv]).ix[edge_to_dim_map[i]]);
 	}
 	for (unsigned i = 0; tris[i] >= 0; i += 3) {
 		triangle const tri(vlist[tris[i]], vlist[tris[i+1]], vlist[tris[i+2]]);
@@ -638,6 +876,30 @@ void voxel_model::remove_unconnected_outside_modified_blocks(bool postproc_brush
 	// instead of during brush application, which may disagree with how the brushes were applied originally
 	bool const falling_voxels_shift_down(postproc_brushes_mode ? voxel_ppb_enable_falling : ((global_voxel_params.enable_falling & (voxel_editing ? 1 : 2)) != 0));
 
+	auto mark_xy_updated_blocks([&]() {
+		for (vector<unsigned>::const_iterator i = xy_updated.begin(); i != xy_updated.end(); ++i) {
+			unsigned const x((*i)%nx), y((*i)/nx);
+			assert(x < nx && y < ny);
+			unsigned const bx1(max(0, (int)x-1)/xblocks), by1(max(0, (int)y-1)/yblocks);
+			unsigned const bx2(min((int)nx-1, (int)x+1)/xblocks), by2(min((int)nx-1, (int)y+1)/yblocks);
+		
+			for (unsigned by = by1; by <= by2; ++by) {
+				for (unsigned bx = bx1; bx <= bx2; ++bx) {
+					unsigned const bix(by*num_blocks + bx);
+					assert(bix < tri_data[0].size());
+					modified_blocks.insert(bix);
+					if (falling_voxels_shift_down) {next_frame_modified_blocks.insert(bix);} // make sure we continue to update these blocks next frame
+				}
+			}
+		}
+	});
+	if (!falling_voxels_shift_down) {
+		// islands can only be created next to voxels that changed, so search locally from those rather than flood filling every block group;
+		// falling voxels move each frame and aren't tracked in changed_voxels, so they still use the block group flood fill below
+		remove_unconnected_near_changed(xy_updated, updated_pts);
+		mark_xy_updated_blocks();
+		to_proc.clear(); // skip block groups
+	}
 	for (unsigned i = 0; i < to_proc.size(); ++i) {
 		int const xbix(to_proc[i] % num_blocks), ybix(to_proc[i] / num_blocks);
 		block_group_t group;
@@ -667,22 +929,7 @@ void voxel_model::remove_unconnected_outside_modified_blocks(bool postproc_brush
 		remove_unconnected_outside_range(1, i->v[0][0]*xblocks, i->v[1][0]*yblocks,
 			min(nx, i->v[0][1]*xblocks), min(ny, i->v[1][1]*yblocks), &xy_updated, &updated_pts, falling_voxels_shift_down);
 		//group_work += i->area();
-
-		for (vector<unsigned>::const_iterator i = xy_updated.begin(); i != xy_updated.end(); ++i) {
-			unsigned const x((*i)%nx), y((*i)/nx);
-			assert(x < nx && y < ny);
-			unsigned const bx1(max(0, (int)x-1)/xblocks), by1(max(0, (int)y-1)/yblocks);
-			unsigned const bx2(min((int)nx-1, (int)x+1)/xblocks), by2(min((int)nx-1, (int)y+1)/yblocks);
-		
-			for (unsigned by = by1; by <= by2; ++by) {
-				for (unsigned bx = bx1; bx <= bx2; ++bx) {
-					unsigned const bix(by*num_blocks + bx);
-					assert(bix < tri_data[0].size());
-					modified_blocks.insert(bix);
-					if (falling_voxels_shift_down) {next_frame_modified_blocks.insert(bix);} // make sure we continue to update these blocks next frame
-				}
-			}
-		}
+		mark_xy_updated_blocks();
 	}
 	//cout << "blocks out " << modified_blocks.size() << " groups " << groups.size() << " group work " << group_work << " updated " << updated_pts.size() << " xy_up " << xy_updated.size() << endl;
 	if (updated_pts.empty()) return;
@@ -723,6 +970,77 @@ void voxel_model::remove_unconnected_outside_modified_blocks(bool postproc_brush
 }
 
 
+// Only voxels connected to one that changed between inside and outside can have become disconnected from their anchors,
+// so search outward from each changed voxel (BFS) until reaching an anchor or the edge of its block neighborhood, which is
+// treated as anchored like in remove_unconnected_outside_modified_blocks(); searches that run out of voxels have found an island.
+// The cost is proportional to the size of the edit plus the distance to the nearest anchor rather than to the size of the blocks.
+void voxel_model::remove_unconnected_near_changed(vector<unsigned> &xy_updated, vector<pt_ix_t> &updated_pts) {
+
+	if (changed_voxels.empty()) return;
+	int const pad = 1; // in blocks
+	unsigned const nxnz(nx*nz);
+	bool const anchor_at_center(params.atten_sphere_mode() || !use_mesh);
+	unsigned const center_ix(outside.get_ix(nx/2, ny/2, nz/2));
+	vector<unsigned> &visited(temp_work); // voxels marked with ANCHORED_BIT, which must be cleared at the end
+	assert(visited.empty());
+	vector<unsigned> queue;
+
+	for (vector<unsigned>::const_iterator c = changed_voxels.begin(); c != changed_voxels.end(); ++c) {
+		assert(*c < outside.size());
+		unsigned const y(*c/nxnz), x((*c - y*nxnz)/nz), z(*c - (x + y*nx)*nz);
+		unsigned const bx(x/xblocks), by(y/yblocks);
+		unsigned const x1(max(0, (int)bx-pad)*xblocks), x2(min(nx, (bx+pad+1)*xblocks));
+		unsigned const y1(max(0, (int)by-pad)*yblocks), y2(min(ny, (by+pad+1)*yblocks));
+		unsigned seeds[7] = {*c}, num_seeds(1); // the voxel itself (if added) and its neighbors (if removed)
+		if (x > 0   ) {seeds[num_seeds++] = *c - nz;}
+		if (x+1 < nx) {seeds[num_seeds++] = *c + nz;}
+		if (y > 0   ) {seeds[num_seeds++] = *c - nxnz;}
+		if (y+1 < ny) {seeds[num_seeds++] = *c + nxnz;}
+		if (z > 0   ) {seeds[num_seeds++] = *c - 1;}
+		if (z+1 < nz) {seeds[num_seeds++] = *c + 1;}
+
+		for (unsigned s = 0; s < num_seeds; ++s) {
+			if (outside[seeds[s]] != 0) continue; // not inside, or already visited from an earlier seed (and known to be anchored)
+			queue.clear();
+			queue.push_back(seeds[s]);
+			outside[seeds[s]] |= (ANCHORED_BIT | CUR_SEARCH_BIT);
+			bool anchored(0);
+
+			for (unsigned q = 0; q < queue.size() && !anchored; ++q) {
+				unsigned const cur(queue[q]), cy(cur/nxnz), cx((cur - cy*nxnz)/nz), cz(cur - (cx + cy*nx)*nz);
+				if (cx == x1 || cx+1 == x2 || cy == y1 || cy+1 == y2 || (anchor_at_center && cur == center_ix)) {anchored = 1; break;}
+				unsigned const adj[6] = {cur - nz, cur + nz, cur - nxnz, cur + nxnz, cur - 1, cur + 1}; // x/y are in range since cur isn't on the region edge
+				
+				for (unsigned n = 0; n < 6; ++n) {
+					if ((n == 4 && cz == 0) || (n == 5 && cz+1 == nz)) continue; // off the z range
+					unsigned char &o(outside[adj[n]]);
+					if (o & CUR_SEARCH_BIT) continue; // already queued
+					if ((o & ANCHORED_BIT) || o == UNDER_MESH_BIT) {anchored = 1; break;} // reached a voxel known to be anchored or the mesh
+					if (o != 0) continue; // outside or on edge
+					o |= (ANCHORED_BIT | CUR_SEARCH_BIT);
+					queue.push_back(adj[n]);
+				}
+			} // for q
+			for (vector<unsigned>::const_iterator i = queue.begin(); i != queue.end(); ++i) {outside[*i] &= ~CUR_SEARCH_BIT;}
+
+			if (anchored) { // keep the anchored bit as a shortcut for later searches
+				visited.insert(visited.end(), queue.begin(), queue.end());
+				continue;
+			}
+			for (vector<unsigned>::const_iterator i = queue.begin(); i != queue.end(); ++i) { // unconnected island, remove it
+				unsigned const vy(*i/nxnz), vx((*i - vy*nxnz)/nz), vz(*i - (vx + vy*nx)*nz);
+				updated_pts.push_back(pt_ix_t(get_pt_at(vx, vy, vz), *i));
+				xy_updated.push_back(vy*nx + vx);
+				make_voxel_outside(*i);
+			}
+		} // for s
+	} // for c
+	for (vector<unsigned>::const_iterator i = visited.begin(); i != visited.end(); ++i) {outside[*i] &= ~ANCHORED_BIT;}
+	visited.clear();
+	changed_voxels.clear(); // processed
+}
+
+
 #define FLOOD_FILL_INNER(pos, min_range, max_range, step) \
 	if (pos >= min_range + 1) { \
 		unsigned const ix(cur - step); \
@@ -865,6 +1183,72 @@ void voxel_manager::make_voxel_inside(unsigned ix) {
 }
 
 
+// two pass chamfer distance transform with the 3x3x3 neighborhood, which is exact for Chebyshev distance;
+// [x1,x2)x[y1,y2) is the range where voxels changed, and values are recomputed for all voxels within EMPTY_DIST_MAX of it
+void voxel_manager::update_empty_dist(unsigned x1, unsigned y1, unsigned x2, unsigned y2) {
+
+	if (outside.empty()) return;
+
+	if (empty_dist.size() != outside.size()) { // first call, or grid size changed
+		empty_dist.init(nx, ny, nz, vsz, center, EMPTY_DIST_MAX);
+		x1 = y1 = 0; x2 = nx; y2 = ny;
+	}
+	// voxels outside the range keep their values, which are still valid lower bounds: removing material only increases distances,
+	// and added material is more than EMPTY_DIST_MAX away from them
+	x1 = max((int)x1 - (int)EMPTY_DIST_MAX, 0); x2 = min(nx, x2 + EMPTY_DIST_MAX);
+	y1 = max((int)y1 - (int)EMPTY_DIST_MAX, 0); y2 = min(ny, y2 + EMPTY_DIST_MAX);
+	if (x1 >= x2 || y1 >= y2) return; // empty range
+
+	for (unsigned y = y1; y < y2; ++y) {
+		for (unsigned x = x1; x < x2; ++x) {
+			unsigned const ix0(outside.get_ix(x, y, 0));
+			for (unsigned z = 0; z < nz; ++z) {empty_dist[ix0+z] = (is_outside(ix0+z) ? EMPTY_DIST_MAX : 0);}
+		}
+	}
+	for (unsigned pass = 0; pass < 2; ++pass) { // forward pass uses the 13 neighbors earlier in yxz order, backward pass uses the other 13
+		int const dir(pass ? -1 : 1);
+
+		for (int yi = 0; yi < int(y2 - y1); ++yi) {
+			int const y(pass ? int(y2) - 1 - yi : int(y1) + yi);
+
+			for (int xi = 0; xi < int(x2 - x1); ++xi) {
+				int const x(pass ? int(x2) - 1 - xi : int(x1) + xi);
+
+				for (int zi = 0; zi < (int)nz; ++zi) {
+					int const z(pass ? int(nz) - 1 - zi : zi);
+					unsigned char &val(empty_dist[outside.get_ix(x, y, z)]);
+					if (val == 0) continue; // can't get any lower
+
+					for (int dy = -1; dy <= 0; ++dy) {
+						for (int dx = -1; dx <= 1; ++dx) {
+							if (dy == 0 && dx > 0) break;
+
+							for (int dz = -1; dz <= 1; ++dz) {
+								if (dy == 0 && dx == 0 && dz >= 0) break;
+								int const xn(x + dir*dx), yn(y + dir*dy), zn(z + dir*dz);
+								if (xn < 0 || yn < 0 || zn < 0 || xn >= (int)nx || yn >= (int)ny || zn >= (int)nz) continue; // off the grid
+								val = min<unsigned>(val, empty_dist[outside.get_ix(xn, yn, zn)]+1);
+							}
+						}
+					}
+				} // for z
+			} // for x
+		} // for y
+	} // for pass
+}
+
+
+// returns a distance from pos within which no point is in a non-outside voxel, or 0 if unknown
+float voxel_manager::get_empty_space_dist(point const &pos) const {
+
+	unsigned ix(0);
+	if (empty_dist.empty() || !empty_dist.get_ix(pos, ix)) return 0.0;
+	unsigned char const dist(empty_dist[ix]);
+	// a point within (dist-1) voxels of pos has a voxel index within (dist-1) of pos's voxel in each dim, so it's closer than the nearest non-outside voxel
+	return ((dist <= 1) ? 0.0 : (dist - 1)*min(vsz.x, min(vsz.y, vsz.z)));
+}
+
+
 bool voxel_manager::point_inside_volume(point const &pos) const {
 
 	if (outside.empty()) return 0;
@@ -885,6 +1269,8 @@ bool voxel_manager::sphere_intersect(point const &center, float radius, point *i
 
 	if (point_intersect(center, int_pt))  return 1; // optimization
 	if (radius == 0.0 || outside.empty()) return 0;
+	// the tested points may be one extra voxel away in z, so add a voxel to the radius
+	if (radius + min(vsz.x, min(vsz.y, vsz.z)) < get_empty_space_dist(center)) return 0; // no inside voxels within range
 	cube_t bcube;
 	bcube.set_from_sphere(center, radius);
 	int llc[3], urc[3];
@@ -919,6 +1305,19 @@ bool voxel_manager::line_intersect(point const &p1, point const &p2, point *int_
 	unsigned const num_steps(ceil(dist/step0));
 	assert(num_steps > 0);
 	vector3d const delta((pb - pa)/num_steps);
+
+	if (!empty_dist.empty()) { // sphere trace: skip over empty space, and take fixed steps of at most the same size when near inside voxels
+		float const step_len(delta.mag());
+		vector3d const dir(delta/step_len);
+		float t(0.0);
+
+		while (1) {
+			float const skip(get_empty_space_dist(pa + dir*t));
+			t += max(step_len, skip);
+			if (t >= dist) return point_intersect(pb, int_pt); // last point
+			if (point_intersect((pa + dir*t), int_pt)) return 1;
+		}
+	}
 	point p(pa + delta); // first point has already been tested
 	
 	for (unsigned i = 0; i < num_steps; ++i) {
@@ -929,6 +1328,95 @@ bool voxel_manager::line_intersect(point const &p1, point const &p2, point *int_
 }
 
 
+// trilinear interpolation of the voxel values, which agrees with the polygonized surface along voxel edges; on edge voxels use the isolevel, as in add_triangles_for_voxel()
+float voxel_manager::get_interpolated_val(point const &pos) const {
+
+	unsigned const num[3] = {nx, ny, nz};
+	unsigned i0[3];
+	float f[3], val(0.0);
+
+	for (unsigned d = 0; d < 3; ++d) {
+		float const v((pos[d] - lo_pos[d])/vsz[d]);
+		i0[d] = max(0, min((int)num[d]-2, (int)floor(v)));
+		f [d] = CLIP_TO_01(v - i0[d]);
+	}
+	for (unsigned n = 0; n < 8; ++n) {
+		unsigned const x(i0[0] + (n&1)), y(i0[1] + ((n>>1)&1)), z(i0[2] + (n>>2)), ix(get_ix(x, y, z));
+		float const cval(((outside[ix] & 7) == ON_EDGE_BIT) ? params.isolevel : get(x, y, z));
+		val += cval*((n&1) ? f[0] : 1.0f-f[0])*(((n>>1)&1) ? f[1] : 1.0f-f[1])*((n>>2) ? f[2] : 1.0f-f[2]);
+	}
+	return val;
+}
+
+// returns the first point where the line crosses the interpolated voxel field; unlike line_intersect(), which tests the voxel containing each point,
+// the hit point is on the surface (to within a small fraction of a voxel) rather than up to a voxel away from it
+bool voxel_manager::line_intersect_surface(point const &p1, point const &p2, point &int_pt) const {
+
+	if (outside.empty()) return 0;
+	point pa(p1), pb(p2);
+	if (!do_line_clip(pa, pb, get_raw_bbox().d)) return 0; // no bbox intersection
+	if (!val_is_outside(get_interpolated_val(pa), params)) {int_pt = pa; return 1;} // first point intersects
+	float const vmin(min(vsz.x, min(vsz.y, vsz.z))), step(0.5*vmin), dist(p2p_dist(pa, pb));
+	if (dist < TOLERANCE) return 0; // near zero length line
+	vector3d const dir((pb - pa)/dist);
+	float t(0.0);
+
+	while (t < dist) {
+		// the interpolated value depends on the 8 voxels around the point, which may be one voxel closer than the voxel used for the empty space distance
+		float const skip(empty_dist.empty() ? 0.0f : max(0.0f, get_empty_space_dist(pa + dir*t) - vmin)), prev_t(t);
+		t = min(dist, (t + max(step, skip)));
+		if (val_is_outside(get_interpolated_val(pa + dir*t), params)) continue;
+		float lo(prev_t), hi(t); // lo is outside, hi is inside
+
+		for (unsigned n = 0; n < 10; ++n) { // binary search for the surface
+			float const mid(0.5f*(lo + hi));
+			(val_is_outside(get_interpolated_val(pa + dir*mid), params) ? lo : hi) = mid;
+		}
+		int_pt = pa + dir*hi;
+		return 1;
+	}
+	return 0;
+}
+
+// point containment using the interpolated voxel field, which agrees with line_intersect_surface()
+bool voxel_manager::point_inside_surface(point const &pos) const {
+
+	if (outside.empty() || !get_raw_bbox().contains_pt(pos)) return 0;
+	if (get_empty_space_dist(pos) > min(vsz.x, min(vsz.y, vsz.z))) return 0; // the interpolated value reads voxels up to one voxel away
+	return !val_is_outside(get_interpolated_val(pos), params);
+}
+
+// sphere collision with the interpolated voxel field: finds the surface along the field normal through the sphere, and if the sphere
+// crosses it, moves center out along the normal so that the sphere rests on the surface; a center that's deep inside is pushed out by up to one diameter per call
+bool voxel_manager::sphere_intersect_surface(point &center, float radius, vector3d &cnorm) const {
+
+	if (outside.empty() || radius == 0.0) return 0;
+	// points in the sphere may be one voxel further away than the radius, and their interpolated values read voxels one more voxel away
+	if (get_empty_space_dist(center) > radius + 2.0*min(vsz.x, min(vsz.y, vsz.z))) return 0; // no surface within range
+	vector3d const normal(get_outward_normal(center));
+	point int_pt;
+	if (!line_intersect_surface((center + normal*radius), (center - normal*radius), int_pt)) return 0;
+	center = int_pt + normal*radius;
+	cnorm  = normal;
+	return 1;
+}
+
+
+vector3d voxel_manager::get_outward_normal(point const &pos) const { // from the gradient of the voxel values
+
+	int xyz[3];
+	get_xyz(pos, xyz);
+	int const num[3] = {(int)nx, (int)ny, (int)nz};
+	UNROLL_3X(xyz[i_] = max(1, min(num[i_]-2, xyz[i_]));) // clamp so that both neighbors are valid
+	vector3d grad;
+	grad.x = get(xyz[0]+1, xyz[1], xyz[2]) - get(xyz[0]-1, xyz[1], xyz[2]);
+	grad.y = get(xyz[0], xyz[1]+1, xyz[2]) - get(xyz[0], xyz[1]-1, xyz[2]);
+	grad.z = get(xyz[0], xyz[1], xyz[2]+1) - get(xyz[0], xyz[1], xyz[2]-1);
+	if (grad == zero_vector) return plus_z; // flat field, arbitrary
+	return (params.invert ? grad.get_norm() : -grad.get_norm()); // values increase toward the inside unless inverted
+}
+
+
 unsigned voxel_manager::upload_to_3d_texture(int wrap) const { // only works for float type
 
 	vector<unsigned char> data;
@@ -1026,6 +1514,7 @@ void voxel_model::clear() {
 	}
 	modified_blocks.clear();
 	next_frame_modified_blocks.clear();
+	changed_voxels.clear();
 	ao_lighting.clear();
 	voxel_manager::clear();
 	volume_added = 0;
@@ -1079,8 +1568,9 @@ unsigned voxel_model::create_block(voxel_ix_cache &vix_cache, unsigned block_ix,
 	assert(block_ix < td.size());
 	auto &tri_block(td[block_ix]);
 	assert(tri_block.empty());
-	vix_cache.init(xblocks+1, yblocks+1, nz, vsz, zero_vector, vert_ix_cache_entry(), 1);
 	unsigned const xbix(block_ix%params.num_blocks), ybix(block_ix/params.num_blocks), step(1 << lod_level);
+	// sized to the LOD step rather than the full res block, so higher LODs don't clear/touch unused entries
+	vix_cache.init(((xblocks+step-1) >> lod_level)+1, ((yblocks+step-1) >> lod_level)+1, ((nz+step-1) >> lod_level)+1, vsz, zero_vector, vert_ix_cache_entry(), 1);
 	unsigned count(0);
 
 	for (unsigned y = ybix*yblocks; y < (ybix+1)*yblocks; y += step) {
@@ -1191,7 +1681,64 @@ void voxel_model::calc_ao_dirs() {
 }
 
 
+// occupancy of AO ray blockers (inside or end ray voxels) for a range of x/y columns, with z packed 64 voxels per word,
+// so that a ray direction can be stepped for every voxel in a column at once
+class voxel_occupancy_mask_t {
+
+	int x1, y1, xsz, ysz;
+	unsigned nz, words_per_col;
+	vector<uint64_t> bits;
+
+	uint64_t get_word(uint64_t const *col, int w) const {return ((w < 0 || w >= (int)words_per_col) ? 0 : col[w]);}
+public:
+	voxel_occupancy_mask_t() : x1(0), y1(0), xsz(0), ysz(0), nz(0), words_per_col(0) {}
+	unsigned get_words_per_col() const {return words_per_col;}
+
+	void init(voxel_grid<unsigned char> const &outside, unsigned char end_ray_flags, unsigned x1_, unsigned y1_, unsigned x2, unsigned y2) {
+		assert(x1_ < x2 && y1_ < y2 && x2 <= outside.nx && y2 <= outside.ny);
+		x1 = x1_; y1 = y1_; xsz = x2 - x1_; ysz = y2 - y1_; nz = outside.nz;
+		words_per_col = (nz + 63)/64;
+		bits.clear();
+		bits.resize(xsz*ysz*words_per_col, 0);
+
+#pragma omp parallel for schedule(static)
+		for (int y = 0; y < ysz; ++y) {
+			for (int x = 0; x < xsz; ++x) {
+				uint64_t *const col(&bits[(x + y*xsz)*words_per_col]);
+				unsigned const ix0(outside.get_ix(x+x1, y+y1, 0));
+
+				for (unsigned z = 0; z < nz; ++z) {
+					unsigned char const val(outside[ix0 + z]);
+					if (val == 0 || (val & end_ray_flags)) {col[z>>6] |= (uint64_t(1) << (z&63));}
+				}
+			}
+		}
+	}
+	uint64_t const *get_col(int x, int y) const { // returns NULL if outside the range, which is either off the grid or beyond the max ray length
+		x -= x1; y -= y1;
+		if (x < 0 || y < 0 || x >= xsz || y >= ysz) return NULL;
+		return &bits[(x + y*xsz)*words_per_col];
+	}
+	uint64_t get_shifted(uint64_t const *col, unsigned w, int zoff) const { // returns bits for voxels (w*64 + i + zoff), zero outside the z range
+		int const base(int(w<<6) + zoff), wix((base >= 0) ? (base >> 6) : -((63 - base) >> 6)), sh(base - wix*64);
+		uint64_t const lo(get_word(col, wix));
+		return (sh ? ((lo >> sh) | (get_word(col, wix+1) << (64 - sh))) : lo);
+	}
+};
+
+
+unsigned voxel_model::get_max_ao_ray_len() const { // in voxels along any axis
+	unsigned max_ray_len(0);
+	for (vector<step_dir_t>::const_iterator i = ao_dirs.begin(); i != ao_dirs.end(); ++i) {max_ray_len = max(max_ray_len, i->nsteps+1);} // +1 for pos bias
+	return max_ray_len;
+}
+
 void voxel_model::calc_ao_lighting_for_block(unsigned block_ix, bool increase_only) {
+	calc_ao_lighting_for_range(block_ix, increase_only, 0, 0, nx, ny);
+}
+
+// only updates columns of the block that are within [x1,x2)x[y1,y2)
+void voxel_model::calc_ao_lighting_for_range(unsigned block_ix, bool increase_only, unsigned x1, unsigned y1, unsigned x2, unsigned y2) {
 
 	if (ao_lighting.empty()) return; // nothing to do
 	float const norm(params.ao_weight_scale/ao_dirs.size());
@@ -1200,48 +1747,74 @@ void voxel_model::calc_ao_lighting_for_block(unsigned block_ix, bool increase_on
 	unsigned const xstep(use_mesh ? max(1U, nx/MESH_X_SIZE ) : 1U);
 	unsigned const ystep(use_mesh ? max(1U, ny/MESH_Y_SIZE ) : 1U);
 	unsigned const zstep(use_mesh ? max(1U, nz/MESH_SIZE[2]) : 1U);
-	unsigned const x_end(min(nx, (xbix+1)*xblocks)), y_end(min(ny, (ybix+1)*yblocks));
-	unsigned const voxel_sz[3] = {nx, ny, nz};
+	unsigned const x_start(xbix*xblocks), y_start(ybix*yblocks), x_end(min(nx, (xbix+1)*xblocks)), y_end(min(ny, (ybix+1)*yblocks));
+	if (max(x_start, x1) >= min(x_end, x2) || max(y_start, y1) >= min(y_end, y2)) return; // range doesn't overlap this block
+	unsigned const max_ray_len(get_max_ao_ray_len());
+	voxel_occupancy_mask_t occ;
+	occ.init(outside, end_ray_flags, max((int)x_start-(int)max_ray_len, 0), max((int)y_start-(int)max_ray_len, 0), min(nx, x_end+max_ray_len), min(ny, y_end+max_ray_len));
+	unsigned const num_words(occ.get_words_per_col());
 	
 	#pragma omp parallel for schedule(dynamic,1)
-	for (int yi = ybix*yblocks; yi < (int)y_end; yi += ystep) {
-		for (unsigned xi = xbix*xblocks; xi < x_end; xi += xstep) {
+	for (int yi = y_start; yi < (int)y_end; yi += ystep) {
+		if ((unsigned)yi + ystep <= y1 || (unsigned)yi >= y2) continue; // not in range
+		vector<uint64_t> need(num_words), remaining(num_words);
+		vector<float> vals(nz, 0.0);
+		vector<pair<unsigned, bool> > zvals; // {zi, cast_rays}
+
+		for (unsigned xi = x_start; xi < x_end; xi += xstep) {
+			if (xi + xstep <= x1 || xi >= x2) continue; // not in range
 			if (xi == 0 || yi == 0 || xi >= nx-xstep || (unsigned)yi >= ny-ystep) continue; // at the mesh edges
-			bool saw_inside(0);
+			unsigned const x(min(x_end-1, xi+xstep-1)), y(min(y_end-1, yi+ystep-1));
+			bool saw_inside(0), any_rays(0);
+			zvals.clear();
+			for (unsigned w = 0; w < num_words; ++w) {need[w] = 0;}
 
-			for (int zi = nz-2; zi >= 0; zi -= zstep) { // skip top zval
-				unsigned const x(min(x_end-1, xi+xstep-1)), y(min(y_end-1, yi+ystep-1)), z(min(nz-1, zi+zstep-1));
+			for (int zi = nz-2; zi >= 0; zi -= zstep) { // skip top zval; first determine which voxels to update and which need rays
+				unsigned const z(min(nz-1, zi+zstep-1));
 				unsigned char const outside_val(outside.get(x, y, z));
 				saw_inside |= (outside_val == 0 || (outside_val & end_ray_flags));
 				if (!saw_inside) continue;
 				if (increase_only && ao_lighting.get(x, y, z) == 255) continue;
 				point const pos(ao_lighting.get_pt_at(x, y, z));
 				if (use_mesh && !is_over_mesh(pos)) continue;
-				float val(0.0);
-				
-				if (z+1 == nz || !(outside.get(x, y, z+1) & end_ray_flags)) { // above mesh
-					for (vector<step_dir_t>::const_iterator i = ao_dirs.begin(); i != ao_dirs.end(); ++i) {
-						float cur_val(1.0);
-						unsigned cur[3] = {x, y, z};
-						// bias to pos side by 1 unit for positive steps to help compensate for grid point vs. grid center alignments
-						unsigned max_steps(i->nsteps);
-						UNROLL_3X(if (i->dir[i_] > 0) cur[i_] += 1;);
-						UNROLL_3X(if (i->dir[i_]) max_steps = min(max_steps, (unsigned)max(0, ((i->dir[i_] < 0) ? (int)cur[i_] : (int)voxel_sz[i_]-(int)cur[i_]-1))););
-						int ix(outside.get_ix(cur[0], cur[1], cur[2]));
-
-						for (unsigned s = 0; s < max_steps; ++s) { // take steps in this direction
-							ix += i->dist_per_step; // increment first to skip the current voxel
-						
-							if (outside[ix] == 0 || (outside[ix] & end_ray_flags)) {
-								cur_val = s*i->nsteps_inv; // Note: ambient obscurance - uses actual distance to occluder
-								break; // voxel known to be inside the volume or under the mesh
-							}
+				bool const cast_rays(z+1 == nz || !(outside.get(x, y, z+1) & end_ray_flags)); // above mesh
+				zvals.push_back(make_pair(zi, cast_rays));
+				if (!cast_rays) continue;
+				need[z>>6] |= (uint64_t(1) << (z&63));
+				vals[z]  = 0.0;
+				any_rays = 1;
+			} // for z
+			if (any_rays) { // step each ray direction for all voxels in the column that need it at once
+				for (vector<step_dir_t>::const_iterator i = ao_dirs.begin(); i != ao_dirs.end(); ++i) {
+					// bias to pos side by 1 unit for positive steps to help compensate for grid point vs. grid center alignments
+					int const bx(x + (i->dir[0] > 0)), by(y + (i->dir[1] > 0)), bz(i->dir[2] > 0);
+					remaining = need;
+
+					for (unsigned s = 0; s < i->nsteps; ++s) { // take steps in this direction
+						int const k(s+1); // skip the current voxel
+						uint64_t const *const col(occ.get_col(bx + k*i->dir[0], by + k*i->dir[1]));
+						if (col == NULL) break; // off the grid
+						float const cur_val(s*i->nsteps_inv); // Note: ambient obscurance - uses actual distance to occluder
+						bool any_left(0);
+
+						for (unsigned w = 0; w < num_words; ++w) {
+							if (!remaining[w]) continue;
+							uint64_t hit(occ.get_shifted(col, w, (bz + k*i->dir[2])) & remaining[w]);
+							remaining[w] &= ~hit;
+							any_left |= (remaining[w] != 0);
+							for (unsigned b = 0; hit; ++b, hit >>= 1) {if (hit & 1) {vals[(w<<6) + b] += norm*cur_val;}} // voxel known to be inside the volume or under the mesh
 						}
-						val += norm*cur_val;
-						if (val >= 1.0) break;
-					} // for i
-					val = CLIP_TO_01(pow(val, params.ao_atten_power));
-				}
+						if (!any_left) break;
+					} // for s
+					for (unsigned w = 0; w < num_words; ++w) { // unoccluded rays
+						uint64_t rem(remaining[w]);
+						for (unsigned b = 0; rem; ++b, rem >>= 1) {if (rem & 1) {vals[(w<<6) + b] += norm*1.0f;}}
+					}
+				} // for i
+			}
+			for (auto i = zvals.begin(); i != zvals.end(); ++i) {
+				unsigned const zi(i->first), z(min(nz-1, zi+zstep-1));
+				float const val(i->second ? CLIP_TO_01(pow(vals[z], params.ao_atten_power)) : 0.0f);
 				unsigned char const ao_val(255.0*val);
 
 				for (unsigned yy = yi; yy < min(y_end, yi+ystep); ++yy) {
@@ -1251,7 +1824,7 @@ void voxel_model::calc_ao_lighting_for_block(unsigned block_ix, bool increase_on
 						}
 					}
 				}
-			} // for z
+			} // for i
 		} // for x
 	} // for y
 }
@@ -1310,7 +1883,9 @@ bool voxel_model::update_voxel_sphere_region(point const &center, float radius,
 				val += val_at_center*pow(min(1.0f, (1.0f - dist/radius)), (float)falloff_exp);
 				if (params.normalize_to_1) val = CLIP_TO_pm1(val);
 				if (val == prev_val) continue; // no change
-				calc_outside_val(x, y, z, ((outside.get(x, y, z) & UNDER_MESH_BIT) != 0));
+				unsigned char const prev_outside(outside.get(x, y, z));
+				calc_outside_val(x, y, z, ((prev_outside & UNDER_MESH_BIT) != 0));
+				if ((outside.get(x, y, z) & 3) != (prev_outside & 3)) {changed_voxels.push_back(outside.get_ix(x, y, z));} // only needed for remove_unconnected
 				was_updated = 1;
 				(val_is_outside(val,      params) ? saw_outside : saw_inside) = 1;
 				(val_is_outside(prev_val, params) ? saw_outside : saw_inside) = 1;
@@ -1391,6 +1966,17 @@ void voxel_model::proc_pending_updates(bool postproc_brushes_mode) {
 	}
 	bool something_removed(0);
 	vector<unsigned> blocks_to_update(modified_blocks.begin(), modified_blocks.end());
+
+	if (!empty_dist.empty()) { // all changed voxels are within the bounds of the modified blocks
+		unsigned x1(nx), y1(ny), x2(0), y2(0);
+
+		for (unsigned i = 0; i < blocks_to_update.size(); ++i) {
+			unsigned const xbix(blocks_to_update[i]%params.num_blocks), ybix(blocks_to_update[i]/params.num_blocks);
+			x1 = min(x1, xbix*xblocks); x2 = max(x2, min(nx, (xbix+1)*xblocks));
+			y1 = min(y1, ybix*yblocks); y2 = max(y2, min(ny, (ybix+1)*yblocks));
+		}
+		update_empty_dist(x1, y1, x2, y2);
+	}
 	
 	// FIXME: can we only remove/add voxels within the modified region of each block?
 	//        or, create the block first and only remove triangles that don't exist in the new block + add triangles that don't exist in the old block?
@@ -1417,11 +2003,40 @@ void voxel_model::proc_pending_updates(bool postproc_brushes_mode) {
 		for (unsigned i = 0; i < blocks_to_update.size(); ++i) { // blocks will be sorted by y then x
 			calc_ao_lighting_for_block(blocks_to_update[i], !volume_added); // update can only remove, so lighting can only increase
 		}
+		if (!ao_lighting.empty() && !ao_dirs.empty()) { // AO rays from nearby voxels in adjacent blocks can reach into the modified blocks
+			unsigned const ray_len(get_max_ao_ray_len()), num_blocks(params.num_blocks);
+			std::set<unsigned> const modified(blocks_to_update.begin(), blocks_to_update.end());
+			map<unsigned, block_group_t> adj_ranges; // adjacent block => voxel x/y range to update
+
+			for (unsigned i = 0; i < blocks_to_update.size(); ++i) {
+				unsigned const xbix(blocks_to_update[i]%num_blocks), ybix(blocks_to_update[i]/num_blocks);
+				block_group_t range;
+				range.v[0][0] = max((int)(xbix*xblocks) - (int)ray_len, 0);
+				range.v[1][0] = max((int)(ybix*yblocks) - (int)ray_len, 0);
+				range.v[0][1] = min(nx, (xbix+1)*xblocks + ray_len);
+				range.v[1][1] = min(ny, (ybix+1)*yblocks + ray_len);
+
+				for (unsigned by = range.v[1][0]/yblocks; by <= (range.v[1][1]-1)/yblocks; ++by) {
+					for (unsigned bx = range.v[0][0]/xblocks; bx <= (range.v[0][1]-1)/xblocks; ++bx) {
+						unsigned const bix(by*num_blocks + bx);
+						if (modified.find(bix) != modified.end()) continue; // already fully updated
+						auto it(adj_ranges.find(bix));
+						if (it == adj_ranges.end()) {adj_ranges[bix] = range;} else {it->second.union_with_group(range);}
+					}
+				}
+			}
+			for (auto i = adj_ranges.begin(); i != adj_ranges.end(); ++i) {
+				calc_ao_lighting_for_range(i->first, !volume_added, i->second.v[0][0], i->second.v[1][0], i->second.v[0][1], i->second.v[1][1]);
+				blocks_to_update.push_back(i->first); // so that update_blocks_hook() includes them
+			}
+			sort(blocks_to_update.begin(), blocks_to_update.end());
+		}
 		update_blocks_hook(blocks_to_update, tot_num_added);
 		//PRINT_TIME(postproc_brushes_mode ? "  Process Voxel Updates" : "Process Voxel Updates");
 	}
 	modified_blocks = next_frame_modified_blocks;
 	next_frame_modified_blocks.clear();
+	changed_voxels.clear();
 	volume_added = 0;
 }
 
@@ -1475,29 +2090,30 @@ void voxel_model::merge_vn_t::finalize() {
 
 
 void voxel_model::update_boundary_normals_for_block(unsigned block_ix, bool calc_average) {
+	for (unsigned lod = 0; lod < tri_data.size(); ++lod) {update_boundary_normals_for_block_lod(block_ix, lod, calc_average);}
+}
 
+void voxel_model::update_boundary_normals_for_block_lod(unsigned block_ix, unsigned lod, bool calc_average) { // only touches boundary_vnmap[lod]
+
+	assert(lod < tri_data.size() && lod < boundary_vnmap.size());
+	if (!tri_data[lod][block_ix].indexing_enabled()) return;
 	unsigned const xbix(block_ix%params.num_blocks), ybix(block_ix/params.num_blocks);
 	cube_t const bbox(get_xv(xbix*xblocks), get_xv(min(nx-1, (xbix+1)*xblocks)), get_yv(ybix*yblocks), get_yv(min(ny-1, (ybix+1)*yblocks)), 0.0, 0.0);
 
-	for (unsigned lod = 0; lod < tri_data.size(); ++lod) {
-		if (!tri_data[lod][block_ix].indexing_enabled()) continue;
-
-		for (tri_data_t::value_type::iterator i = tri_data[lod][block_ix].begin(); i != tri_data[lod][block_ix].end(); ++i) {
-			if (i->v.x != bbox.d[0][0] && i->v.x != bbox.d[0][1] && i->v.y != bbox.d[1][0] && i->v.y != bbox.d[1][1]) continue; // not at a block boundary
-			// Note: should be no duplicates within the same block
-			merge_vn_t &vn(boundary_vnmap[lod][i->v]);
-			if (calc_average) {vn.add(*i);} else {vn.update(*i);}
-		}
+	for (tri_data_t::value_type::iterator i = tri_data[lod][block_ix].begin(); i != tri_data[lod][block_ix].end(); ++i) {
+		if (i->v.x != bbox.d[0][0] && i->v.x != bbox.d[0][1] && i->v.y != bbox.d[1][0] && i->v.y != bbox.d[1][1]) continue; // not at a block boundary
+		// Note: should be no duplicates within the same block
+		merge_vn_t &vn(boundary_vnmap[lod][i->v]);
+		if (calc_average) {vn.add(*i);} else {vn.update(*i);}
 	}
 }
 
 
-void voxel_model::finalize_boundary_vmap() {
+void voxel_model::finalize_boundary_vmap(unsigned lod) {
 
-	for (unsigned lod = 0; lod < boundary_vnmap.size(); ++lod) {
-		for (vert_norm_map_t::iterator i = boundary_vnmap[lod].begin(); i != boundary_vnmap[lod].end(); ++i) {
-			i->second.finalize();
-		}
+	assert(lod < boundary_vnmap.size());
+	for (vert_norm_map_t::iterator i = boundary_vnmap[lod].begin(); i != boundary_vnmap[lod].end(); ++i) {
+		i->second.finalize();
 	}
 }
 
@@ -1517,6 +2133,7 @@ void voxel_model::build(bool verbose, bool do_ao_lighting) {
 		noise_tex_gen->procedural_gen(NOISE_TSIZE, params.texture_rseed, 1.0, params.noise_freq);
 	}
 	if (verbose) {PRINT_TIME("  Procedural Texture Gen");}
+	expand_values(); // the steps below modify values in parallel, which requires dense values
 	float const atten_thresh((params.invert ? 1.0 : -1.0)*params.atten_thresh);
 
 	switch (params.atten_at_edges) {
@@ -1535,6 +2152,11 @@ void voxel_model::build(bool verbose, bool do_ao_lighting) {
 	if (params.remove_unconnected > 2) {remove_interior_holes();}
 	remove_excess_cap(temp_work);
 	if (verbose) {PRINT_TIME("  Remove Unconnected");}
+	
+	if (use_empty_dist()) {
+		update_empty_dist(0, 0, nx, ny);
+		if (verbose) {PRINT_TIME("  Empty Space Distance");}
+	}
 	unsigned const tot_blocks(params.num_blocks*params.num_blocks);
 	assert(pt_to_ix[0].empty() && tri_data[0].empty());
 	for (unsigned i = 0; i < pt_to_ix.size(); ++i) {pt_to_ix[i].resize(tot_blocks);}
@@ -1545,17 +2167,28 @@ void voxel_model::build(bool verbose, bool do_ao_lighting) {
 	pre_build_hook();
 	if (verbose) {PRINT_TIME("  Pre Build");}
 
+	unsigned const num_lods(tri_data.size()), num_jobs(tot_blocks*num_lods);
+	vector<voxel_ix_cache> vix_caches(omp_get_max_threads_3dw()); // one per thread, reused across jobs
+
+	// schedule each {block, LOD} pair as its own job so that high LOD blocks don't serialize behind LOD 0 of the same block;
+	// jobs are ordered LOD-major so that the expensive LOD 0 jobs are handed out first
 	#pragma omp parallel for schedule(dynamic,1)
-	for (int block = 0; block < (int)tot_blocks; ++block) {
-		create_block_all_lods(block, 1, 0);
+	for (int job = 0; job < (int)num_jobs; ++job) {
+		unsigned const tid(omp_get_thread_num_3dw());
+		assert(tid < vix_caches.size());
+		create_block(vix_caches[tid], (job % tot_blocks), 1, 0, (job / tot_blocks));
 	}
+	vix_caches.clear();
 	if (verbose) {PRINT_TIME("  Triangles to Model");}
 
-	if (tot_blocks > 1) { // merge triangle vertices along block seams
-		for (unsigned block_ix = 0; block_ix < tot_blocks; ++block_ix) {
-			update_boundary_normals_for_block(block_ix, 1);
+	if (tot_blocks > 1) { // merge triangle vertices along block seams; each LOD has its own map, so LODs can be merged in parallel
+		#pragma omp parallel for schedule(dynamic,1)
+		for (int lod = 0; lod < (int)num_lods; ++lod) {
+			for (unsigned block_ix = 0; block_ix < tot_blocks; ++block_ix) {
+				update_boundary_normals_for_block_lod(block_ix, lod, 1);
+			}
+			finalize_boundary_vmap(lod);
 		}
-		finalize_boundary_vmap();
 		if (verbose) {PRINT_TIME("  Block Seam Merge");}
 	}
 	if (do_ao_lighting) {
@@ -1586,12 +2219,44 @@ void voxel_model_ground::pre_build_hook() {
 }
 
 
+// for queries that only need the hit position and normal; with field_coll, these are answered from the voxel field rather than the voxel cobjs
+bool voxel_model_ground::check_coll_line_no_cobj(point const &p1, point const &p2, point &cpos, vector3d &cnorm) const {
+
+	if (!params.field_coll) {
+		int cindex(-1); // unused
+		return cobj_tree.check_coll_line(p1, p2, cpos, cnorm, cindex, -1, 1);
+	}
+	point p_int;
+	bool const ret(line_intersect_surface(p1, p2, p_int));
+
+	if (params.validate_field_coll && add_cobjs) {
+		point cpos2;
+		vector3d cnorm2;
+		int cindex2(-1);
+		bool const ret2(cobj_tree.check_coll_line(p1, p2, cpos2, cnorm2, cindex2, -1, 1));
+		// Note: the interpolated field is only equal to the polygonized surface along voxel edges, so allow some error
+		if (ret != ret2 || (ret && !dist_less_than(p_int, cpos2, 0.5*vsz.mag()))) {
+			cerr << "Voxel field line query mismatch: " << ret << " vs. cobjs " << ret2 << " for " << p1.str() << " to " << p2.str();
+			if (ret && ret2) {cerr << ", hit pos " << p_int.str() << " vs. " << cpos2.str();}
+			cerr << endl;
+		}
+	}
+	if (!ret) return 0;
+	cpos  = p_int;
+	cnorm = get_outward_normal(p_int);
+	return 1;
+}
+
+
 void voxel_model_ground::build(bool add_cobjs_, bool add_as_fixed_, bool verbose) {
 
 	add_cobjs    = add_cobjs_;
 	add_as_fixed = add_as_fixed_;
 	cobj_tree.init(params.num_blocks, params.num_blocks);
 	voxel_model::build(verbose);
+	// compress the values to reduce memory usage; bricks are expanded again as they're edited, and the full range of values is kept so that edits behave the same
+	compact_values(0); // narrow_band=0
+	if (verbose) {cout << "Voxel terrain values: " << packed_vals.get_mem_usage()/1024 << " KB compressed vs. " << size()*sizeof(float)/1024 << " KB dense" << endl;}
 }
 
 
@@ -1742,6 +2407,32 @@ void voxel_model::free_context() {
 }
 
 
+unsigned long long voxel_model::get_checksum(unsigned &num_verts) const { // for determinism checks
+	unsigned long long hash(hash_string_fnv1a("voxels"));
+
+	if (!empty()) { // hash one row at a time through get() since the values may be compacted; gives the same hash as the dense values
+		vector<float> row(nz);
+
+		for (unsigned y = 0; y < ny; ++y) {
+			for (unsigned x = 0; x < nx; ++x) {
+				for (unsigned z = 0; z < nz; ++z) {row[z] = get(x, y, z);}
+				hash = hash_bytes_fnv1a(row.data(), nz*sizeof(float), hash);
+			}
+		}
+	}
+	if (!outside.empty())     {hash = hash_bytes_fnv1a(outside.data(),     outside.size(),       hash);}
+	if (!ao_lighting.empty()) {hash = hash_bytes_fnv1a(ao_lighting.data(), ao_lighting.size(),   hash);}
+	num_verts = 0;
+
+	for (unsigned i = 0; i < tri_data.size(); ++i) { // vertex data order depends on block scheduling, so only hash the counts
+		unsigned const nv(tri_data[i].num_verts());
+		hash = hash_bytes_fnv1a(&nv, sizeof(unsigned), hash);
+		num_verts += nv;
+	}
+	return hash;
+}
+
+
 float voxel_model::eval_noise_texture_at(point const &pos) const {
 	
 	assert(noise_tex_gen);
@@ -1872,6 +2563,8 @@ void setup_voxel_landscape(voxel_params_t const &params, float default_val) {
 }
 
 
+unsigned long long get_voxel_landscape_checksum(unsigned &num_verts) {return terrain_voxel_model.get_checksum(num_verts);}
+
 void gen_voxel_landscape() {
 
 	RESET_TIME;
@@ -1980,6 +2673,12 @@ bool parse_voxel_option(FILE *fp) {
 	else if (str == "add_cobjs") {
 		if (!read_bool(fp, global_voxel_params.add_cobjs)) voxel_file_err("add_cobjs", error);
 	}
+	else if (str == "field_coll") {
+		if (!read_bool(fp, global_voxel_params.field_coll)) voxel_file_err("field_coll", error);
+	}
+	else if (str == "validate_field_coll") {
+		if (!read_bool(fp, global_voxel_params.validate_field_coll)) voxel_file_err("validate_field_coll", error);
+	}
 	else if (str == "normalize_to_1") {
 		if (!read_bool(fp, global_voxel_params.normalize_to_1)) voxel_file_err("normalize_to_1", error);
 	}
@@ -2108,6 +2807,7 @@ void free_voxel_context() {
 
 bool point_inside_voxel_terrain(point const &pos) {
 	if (world_mode != WMODE_GROUND) return 0;
+	if (terrain_voxel_model.get_params().field_coll) {return terrain_voxel_model.point_inside_surface(pos);}
 	return terrain_voxel_model.point_inside_volume(pos);
 }
 
@@ -2131,11 +2831,23 @@ bool check_voxel_coll_line(point const &p1, point const &p2, point &cpos, vector
 	return terrain_voxel_model.check_coll_line(p1, p2, cpos, cnorm, cindex, ignore_cobj, exact);
 }
 
+bool check_voxel_coll_line_no_cobj(point const &p1, point const &p2, point &cpos, vector3d &cnorm) {
+	if (terrain_voxel_model.empty()) return 0;
+	return terrain_voxel_model.check_coll_line_no_cobj(p1, p2, cpos, cnorm);
+}
+
 void get_voxel_coll_sphere_cobjs(point const &center, float radius, int ignore_cobj, vert_coll_detector &vcd) {
-	if (terrain_voxel_model.empty()) return;
+	if (terrain_voxel_model.empty() || terrain_voxel_model.get_params().field_coll) return; // field_coll uses check_voxel_sphere_coll_field() instead
 	terrain_voxel_model.get_coll_sphere_cobjs(center, radius, ignore_cobj, vcd);
 }
 
+// object collisions with the voxel field when field_coll is enabled; moves pos out of the surface and returns the surface normal and elasticity
+bool check_voxel_sphere_coll_field(point &pos, float radius, vector3d &cnorm, float &elastic) {
+	if (world_mode != WMODE_GROUND || terrain_voxel_model.empty() || !terrain_voxel_model.get_params().field_coll) return 0;
+	elastic = terrain_voxel_model.get_params().elasticity;
+	return terrain_voxel_model.sphere_intersect_surface(pos, radius, cnorm);
+}
+
 
 // ************ Voxel Editing ************
 
@@ -2262,28 +2974,26 @@ void change_voxel_editing_mode(int val) {
 void apply_brush(voxel_brush_t const &brush) {brush_manager.apply_brush(brush);}
 void undo_voxel_brush() {brush_manager.undo_last_brush();}
 
-bool get_voxel_edit_pos(point &coll_pos, int &cindex) {
+bool get_voxel_edit_pos(point &coll_pos) {
 
-	if (!coll_objects.has_voxel_cobjs) return 0; // no voxels to modify
+	if (terrain_voxel_model.empty()) return 0; // no voxels to modify
 	point const pos(get_camera_pos());
 	vector3d coll_norm; // unused
 	float range(FAR_CLIP);
 	if (get_range_to_mesh(pos, cview_dir, coll_pos) == 1) {range = p2p_dist(pos, coll_pos);} // mesh (not ice) intersection
-	return check_voxel_coll_line(pos, (pos + cview_dir*range), coll_pos, coll_norm, cindex, -1, 1); // hit voxel cobjs
+	return check_voxel_coll_line_no_cobj(pos, (pos + cview_dir*range), coll_pos, coll_norm); // hit voxels
 }
 
 void modify_voxels() {
 
 	// add a marker for where voxels will be modified before a fire/key press?
-	if (!coll_objects.has_voxel_cobjs) return; // no voxels to modify
+	if (terrain_voxel_model.empty()) return; // no voxels to modify
 	static double last_tfticks(0.0);
 	if ((tfticks - last_tfticks) <= voxel_brush_params.delay) return; // limit firing rate
 	last_tfticks = tfticks;
-	int cindex(-1);
 	point coll_pos;
 
-	if (get_voxel_edit_pos(coll_pos, cindex)) { // hit voxel cobjs
-		assert(coll_objects.get_cobj(cindex).cp.cobj_type == COBJ_TYPE_VOX_TERRAIN);
+	if (get_voxel_edit_pos(coll_pos)) { // hit voxels
 		voxel_brush_params.weight_scale = ((voxel_editing == 2) ? -0.1 : 0.1);
 		brush_manager.apply_and_add_brush(voxel_brush_t(voxel_brush_params, coll_pos));
 	}
@@ -2300,9 +3010,8 @@ void voxel_brush_params_t::draw(point const &pos) const {
 void draw_voxel_edit_volume() {
 
 	if (voxel_editing == 0) return; // not editing
-	int cindex(-1); // unused
 	point coll_pos;
-	if (!get_voxel_edit_pos(coll_pos, cindex)) return;
+	if (!get_voxel_edit_pos(coll_pos)) return;
 	shader_t shader;
 	shader.begin_color_only_shader(colorRGBA(((voxel_editing == 2) ? RED : GREEN), 0.2)); // alpha = 20%
 	enable_blend();
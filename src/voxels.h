@@ -18,6 +18,8 @@ struct voxel_params_t {
 	float isolevel, elasticity, mag, freq, atten_thresh, tex_scale, noise_scale, noise_freq, tex_mix_saturate, z_gradient, height_eval_freq, radius_val;
 	float ao_radius, ao_weight_scale, ao_atten_power, spec_mag, spec_exp;
 	bool make_closed_surface, invert, remove_under_mesh, add_cobjs, normalize_to_1, top_tex_used, detail_normal_map;
+	bool field_coll; // answer terrain sphere collisions, point containment, and line queries that don't need a cobj (voxel edit picking) from the voxel field
+	bool validate_field_coll; // compare field_coll line queries against voxel cobjs and report mismatches (requires add_cobjs)
 	unsigned remove_unconnected; // 0=never, 1=init only, 2=always, 3=always, including interior holes
 	unsigned atten_at_edges; // 0=no atten, 1=top only, 2=all 5 edges (excludes the bottom), 3=sphere (outer), 4=sphere (inner and outer), 5=sphere (inner and outer, excludes the bottom)
 	unsigned keep_at_scene_edge; // 0=don't keep, 1=always keep, 2=only when scrolling
@@ -34,7 +36,7 @@ struct voxel_params_t {
 	voxel_params_t() : xsize(0), ysize(0), zsize(0), num_blocks(12), isolevel(0.0), elasticity(0.5), mag(1.0), freq(1.0), atten_thresh(1.0), tex_scale(1.0), noise_scale(0.1),
 		noise_freq(1.0), tex_mix_saturate(5.0), z_gradient(0.0), height_eval_freq(1.0), radius_val(0.5), ao_radius(1.0), ao_weight_scale(2.0), ao_atten_power(1.0),
 		spec_mag(0.0), spec_exp(1.0), make_closed_surface(1), invert(0), remove_under_mesh(0), add_cobjs(1), normalize_to_1(1), top_tex_used(0), detail_normal_map(1),
-		remove_unconnected(1), atten_at_edges(0), keep_at_scene_edge(0), atten_top_mode(0), enable_falling(1), geom_rseed(123), texture_rseed(321), base_color(WHITE)
+		field_coll(0), validate_field_coll(0), remove_unconnected(1), atten_at_edges(0), keep_at_scene_edge(0), atten_top_mode(0), enable_falling(1), geom_rseed(123), texture_rseed(321), base_color(WHITE)
 	{
 			tids[0] = tids[1] = tids[2] = 0; colors[0] = colors[1] = WHITE;
 	}
@@ -161,6 +163,7 @@ public:
 	V &get_ref     (unsigned x, unsigned y, unsigned z)        {return operator[](get_ix(x, y, z));}
 	void set       (unsigned x, unsigned y, unsigned z, V const &val) {operator[](get_ix(x, y, z)) = val;}
 	cube_t get_raw_bbox() const {return cube_t(lo_pos, center + (center - lo_pos));}
+	template<typename T> void copy_dims_from(voxel_grid<T> const &g) {nx = g.nx; ny = g.ny; nz = g.nz; xblocks = g.xblocks; yblocks = g.yblocks; vsz = g.vsz; center = g.center; lo_pos = g.lo_pos;}
 	bool read(FILE *fp);
 	bool write(FILE *fp) const;
 };
@@ -168,12 +171,48 @@ public:
 typedef voxel_grid<float> float_voxel_grid;
 
 
+// brick-compressed copy of a float voxel grid: values are quantized to 16 bits, and bricks whose values all quantize to the same value
+// are stored as a single value; with narrow_band, values are first clamped to a band around the isolevel that covers every edge
+// crossing the isosurface (so the polygonized surface is unchanged), which makes most bricks away from the surface uniform;
+// bricks that are modified through get_ref() are expanded to floats and stay that way
+class voxel_brick_store_t {
+
+	unsigned nx, ny, nz, bnx, bny, bnz;
+	float isolevel, qscale; // qscale is quantized steps per unit value
+	vector<unsigned> brick_data; // per brick: index of the first value in qvals, index into dense_vals | DENSE_BIT, or NO_DATA if the brick is uniform
+	vector<unsigned short> uniform_qvals, qvals; // uniform_qvals is per brick
+	vector<float> dense_vals; // modified bricks
+
+	unsigned get_brick_ix(unsigned x, unsigned y, unsigned z) const;
+	unsigned get_val_ix  (unsigned x, unsigned y, unsigned z) const;
+	unsigned short quantize(float val) const;
+	float dequantize(unsigned short q) const {return (isolevel + (float(q) - 32768.0f)/qscale);}
+	void expand_brick(unsigned bix);
+public:
+	voxel_brick_store_t() : nx(0), ny(0), nz(0), bnx(0), bny(0), bnz(0), isolevel(0.0), qscale(1.0) {}
+	bool empty() const {return brick_data.empty();}
+	bool has_dense_bricks() const {return !dense_vals.empty();}
+	void clear();
+	void compress(float_voxel_grid const &grid, float isolevel_, bool narrow_band);
+	void expand(float_voxel_grid &grid) const;
+	float get(unsigned x, unsigned y, unsigned z) const;
+	float &get_ref(unsigned x, unsigned y, unsigned z);
+	size_t get_mem_usage() const {
+		return (brick_data.capacity()*sizeof(unsigned) + (uniform_qvals.capacity() + qvals.capacity())*sizeof(unsigned short) + dense_vals.capacity()*sizeof(float));
+	}
+	bool read(FILE *fp);
+	bool write(FILE *fp) const;
+};
+
+
 class voxel_manager : public float_voxel_grid {
 
 protected:
 	bool use_mesh;
 	voxel_params_t params;
 	voxel_grid<unsigned char> outside;
+	voxel_grid<unsigned char> empty_dist; // conservative Chebyshev distance in voxels to the nearest non-outside voxel, used to skip empty space
+	voxel_brick_store_t packed_vals; // replaces the dense values when compacted
 	vector<unsigned> temp_work; // used in remove_unconnected_outside_range()/flood_fill()
 	typedef vert_norm vertex_type_t;
 	typedef vntc_vect_block_t<vertex_type_t> tri_data_t;
@@ -202,6 +241,8 @@ protected:
 	void add_cobj_voxels(coll_obj &cobj, float filled_val);
 	void make_voxel_outside(unsigned ix);
 	void make_voxel_inside(unsigned ix);
+	void update_empty_dist(unsigned x1, unsigned y1, unsigned x2, unsigned y2);
+	float get_empty_space_dist(point const &pos) const;
 
 public:
 	voxel_manager(bool use_mesh_=0) : use_mesh(use_mesh_) {}
@@ -217,11 +258,45 @@ public:
 	void remove_interior_holes();
 	bool is_outside(unsigned ix) const {assert(ix < outside.size()); return((outside[ix]&3) != 0);}
 	bool point_inside_volume(point const &pos) const;
+	bool point_inside_surface(point const &pos) const;
 	bool point_intersect(point const &center, point *int_pt) const;
 	bool sphere_intersect(point const &center, float radius, point *int_pt) const;
 	bool line_intersect(point const &p1, point const &p2, point *int_pt) const;
+	float get_interpolated_val(point const &pos) const;
+	bool line_intersect_surface(point const &p1, point const &p2, point &int_pt) const;
+	bool sphere_intersect_surface(point &center, float radius, vector3d &cnorm) const;
+	vector3d get_outward_normal(point const &pos) const;
 	unsigned upload_to_3d_texture(int wrap) const;
 	voxel_params_t const &get_params() const {return params;}
+	void compact_values(bool narrow_band=1);
+	void expand_values();
+	bool values_compacted() const {return !packed_vals.empty();}
+
+	// value accessors, which hide the float_voxel_grid versions so that they work on compacted values; writes expand the containing brick;
+	// the dense-only accessors below assert that the values aren't compacted; outside and empty_dist are always dense
+	bool empty() const {return (float_voxel_grid::empty() && !values_compacted());}
+	size_t size() const {return (values_compacted() ? (size_t)nx*ny*nz : float_voxel_grid::size());}
+	float get(unsigned x, unsigned y, unsigned z) const {return (values_compacted() ? packed_vals.get(x, y, z) : float_voxel_grid::get(x, y, z));}
+	float &get_ref(unsigned x, unsigned y, unsigned z) {return (values_compacted() ? packed_vals.get_ref(x, y, z) : float_voxel_grid::get_ref(x, y, z));}
+	void set(unsigned x, unsigned y, unsigned z, float val) {get_ref(x, y, z) = val;}
+	float operator[](unsigned ix) const {
+		if (!values_compacted()) {return float_voxel_grid::operator[](ix);}
+		return packed_vals.get(((ix/nz)%nx), ((ix/nz)/nx), (ix%nz));
+	}
+	float &operator[](unsigned ix) {
+		if (!values_compacted()) {return float_voxel_grid::operator[](ix);}
+		return packed_vals.get_ref(((ix/nz)%nx), ((ix/nz)/nx), (ix%nz));
+	}
+	float const *data() const {assert(!values_compacted()); return float_voxel_grid::data();}
+	float       *data()       {assert(!values_compacted()); return float_voxel_grid::data();}
+	const_iterator begin() const {assert(!values_compacted()); return float_voxel_grid::begin();}
+	const_iterator end  () const {assert(!values_compacted()); return float_voxel_grid::end  ();}
+	iterator       begin()       {assert(!values_compacted()); return float_voxel_grid::begin();}
+	iterator       end  ()       {assert(!values_compacted()); return float_voxel_grid::end  ();}
+	float const &front() const {assert(!values_compacted()); return float_voxel_grid::front();}
+	float const &at(size_t ix) const {assert(!values_compacted()); return float_voxel_grid::at(ix);}
+	float       &at(size_t ix)       {assert(!values_compacted()); return float_voxel_grid::at(ix);}
+	void resize(size_t sz) {assert(!values_compacted()); float_voxel_grid::resize(sz);}
 };
 
 
@@ -248,6 +323,7 @@ protected:
 	vector<tri_data_t> tri_data; // one per LOD level
 	noise_texture_manager_t *noise_tex_gen;
 	std::set<unsigned> modified_blocks, next_frame_modified_blocks;
+	vector<unsigned> changed_voxels; // voxels that changed between inside and outside since the last call to proc_pending_updates()
 	voxel_grid<unsigned char> ao_lighting;
 
 	struct step_dir_t {
@@ -281,20 +357,25 @@ protected:
 	};
 
 	void remove_unconnected_outside_modified_blocks(bool postproc_brushes_mode);
+	void remove_unconnected_near_changed(vector<unsigned> &xy_updated, vector<pt_ix_t> &updated_pts);
 	unsigned get_block_ix(unsigned voxel_ix) const;
 	virtual bool clear_block(unsigned block_ix);
 	unsigned create_block(voxel_ix_cache &vix_cache, unsigned block_ix, bool first_create, bool count_only, unsigned lod_level);
 	unsigned create_block_all_lods(unsigned block_ix, bool first_create, bool count_only);
 	void update_boundary_normals_for_block(unsigned block_ix, bool calc_average);
-	void finalize_boundary_vmap();
+	void update_boundary_normals_for_block_lod(unsigned block_ix, unsigned lod, bool calc_average);
+	void finalize_boundary_vmap(unsigned lod);
 	void calc_ao_dirs();
 	virtual void calc_ao_lighting_for_block(unsigned block_ix, bool increase_only);
+	unsigned get_max_ao_ray_len() const;
+	void calc_ao_lighting_for_range(unsigned block_ix, bool increase_only, unsigned x1, unsigned y1, unsigned x2, unsigned y2);
 	void calc_ao_lighting();
 
 	virtual void maybe_create_fragments(point const &center, float radius, int shooter, unsigned num_fragments, bool directly_from_update) const {} // do nothing
 	virtual void create_block_hook(unsigned block_ix) {}
 	virtual void update_blocks_hook(vector<unsigned> const &blocks_to_update, unsigned num_added) {}
 	virtual void pre_build_hook() {}
+	virtual bool use_empty_dist() const {return params.field_coll;}
 	virtual void pre_render(bool is_shadow_pass) {}
 
 public:
@@ -313,6 +394,7 @@ public:
 	float eval_noise_texture_at(point const &pos) const;
 	float get_ao_lighting_val(point const &pos) const;
 	cube_t get_bcube() const {return ((tri_data[0].empty()) ? cube_t(center, center) : tri_data[0].get_bcube());}
+	unsigned long long get_checksum(unsigned &num_verts) const;
 	sphere_t get_bsphere() const;
 	bool has_triangles() const;
 	bool has_filled_at_edges() const;
@@ -348,6 +430,7 @@ public:
 	bool check_coll_line(point const &p1, point const &p2, point &cpos, vector3d &cnorm, int &cindex, int ignore_cobj, bool exact) const {
 		return cobj_tree.check_coll_line(p1, p2, cpos, cnorm, cindex, ignore_cobj, exact);
 	}
+	bool check_coll_line_no_cobj(point const &p1, point const &p2, point &cpos, vector3d &cnorm) const;
 	void get_coll_sphere_cobjs(point const &center, float radius, int ignore_cobj, vert_coll_detector &vcd) const {
 		cobj_tree.get_coll_sphere_cobjs(center, radius, ignore_cobj, vcd);
 	}
@@ -374,6 +457,7 @@ class voxel_model_space : public voxel_model {
 	virtual void calc_ao_lighting_for_block(unsigned block_ix, bool increase_only);
 	void calc_shadows(voxel_grid<unsigned char> &shadow_data) const;
 	void extract_shadow_edges(voxel_grid<unsigned char> const &shadow_data);
+	virtual bool use_empty_dist() const {return 1;} // for asteroid collision queries
 
 public:
 	voxel_model_space(noise_texture_manager_t *ntg, unsigned num_lod_levels) : voxel_model(ntg, 0, num_lod_levels), ao_tid(0), shadow_tid(0) {}